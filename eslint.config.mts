@@ -10,5 +10,9 @@ export default defineConfig([
     extends: ["js/recommended"],
     languageOptions: { globals: globals.browser },
   },
+  {
+    files: ["packages/*/bench/**/*.mjs"],
+    languageOptions: { globals: globals.node },
+  },
   tseslint.configs.recommended,
 ]);
@@ -0,0 +1,131 @@
+// Drive a non-blocking libssh2 session over a Node TCP socket. The session
+// uses the callback transport: send writes straight to the socket, recv
+// copies from the bytes queued by the socket's "data" events or reports
+// EAGAIN, and every libssh2 call is retried once more data has arrived.
+
+import { connect } from "node:net";
+
+export const LIBSSH2_ERROR_EAGAIN = -37;
+const EAGAIN = 6; // Emscripten errno
+
+export class Connection {
+  constructor(SSH2) {
+    this.SSH2 = SSH2;
+    this.queue = [];
+    this.closed = false;
+    this.waiters = [];
+    this.bytesIn = 0;
+    this.bytesOut = 0;
+  }
+
+  async open(port) {
+    const { SSH2 } = this;
+    this.socket = connect(port, "127.0.0.1");
+    this.socket.setNoDelay(true);
+    await new Promise((resolve, reject) => {
+      this.socket.once("connect", resolve);
+      this.socket.once("error", reject);
+    });
+
+    this.socket.on("data", (chunk) => { this.queue.push(chunk); this.wake(); });
+    this.socket.on("close", () => { this.closed = true; this.wake(); });
+    this.socket.on("error", () => {});
+
+    this.handle = SSH2.registerTransport({
+      send: (buffer, length) => {
+        this.socket.write(SSH2.HEAPU8.slice(buffer, buffer + length));
+        this.bytesOut += length;
+        return length;
+      },
+      recv: (buffer, length) => this.recv(buffer, length),
+    });
+    this.session = SSH2.ccall("ssh2_session_create", "number",
+      ["number", "number", "number", "number"], [this.handle, 0, 0, 0]);
+    SSH2.ccall("ssh2_session_set_blocking", null, ["number", "number"], [this.session, 0]);
+  }
+
+  recv(buffer, length) {
+    let copied = 0;
+    while (copied < length && this.queue.length) {
+      const chunk = this.queue[0];
+      const n = Math.min(chunk.length, length - copied);
+      this.SSH2.HEAPU8.set(chunk.subarray(0, n), buffer + copied);
+      copied += n;
+      if (n === chunk.length) {
+        this.queue.shift();
+      } else {
+        this.queue[0] = chunk.subarray(n);
+      }
+    }
+    this.bytesIn += copied;
+    if (copied) return copied;
+    return this.closed ? 0 : -EAGAIN;
+  }
+
+  wake() {
+    const waiters = this.waiters;
+    this.waiters = [];
+    waiters.forEach((resolve) => resolve());
+  }
+
+  readable() {
+    if (this.queue.length || this.closed) return Promise.resolve();
+    return new Promise((resolve) => this.waiters.push(resolve));
+  }
+
+  // Repeat call() while it reports EAGAIN, returning its final result
+  async retry(call) {
+    for (;;) {
+      const rc = call();
+      if (rc !== LIBSSH2_ERROR_EAGAIN) return rc;
+      await this.readable();
+    }
+  }
+
+  // Same for calls returning a pointer (NULL plus EAGAIN as last error)
+  async retryPointer(call) {
+    for (;;) {
+      const ptr = call();
+      if (ptr) return ptr;
+      const errno = this.call("ssh2_session_last_errno", "number", ["number"], [this.session]);
+      if (errno !== LIBSSH2_ERROR_EAGAIN) {
+        throw new Error(`libssh2 error ${errno}: ${this.lastError()}`);
+      }
+      await this.readable();
+    }
+  }
+
+  call(ident, ret, argTypes, args) {
+    return this.SSH2.ccall(ident, ret, argTypes, args);
+  }
+
+  lastError() {
+    return this.call("ssh2_session_last_error", "string", ["number"], [this.session]);
+  }
+
+  async check(promise, what) {
+    const rc = await promise;
+    if (rc < 0) throw new Error(`${what} failed (${rc}): ${this.lastError()}`);
+    return rc;
+  }
+
+  async handshake() {
+    await this.check(this.retry(() =>
+      this.call("ssh2_session_handshake_custom", "number", ["number"], [this.session])), "handshake");
+  }
+
+  async authenticate(user, privateKey) {
+    const length = Buffer.byteLength(privateKey);
+    await this.check(this.retry(() =>
+      this.call("ssh2_userauth_publickey_frommemory", "number",
+        ["number", "string", "string", "number", "string", "number", "string"],
+        [this.session, user, null, 0, privateKey, length, ""])), "authentication");
+  }
+
+  async close() {
+    await this.retry(() =>
+      this.call("ssh2_session_disconnect", "number", ["number", "string"], [this.session, "bench"]));
+    this.call("ssh2_session_free", null, ["number"], [this.session]);
+    this.socket.destroy();
+  }
+}
@@ -0,0 +1,264 @@
+#!/usr/bin/env node
+// Benchmark a libssh2.js build against a local OpenSSH server.
+//
+//   pnpm bench [--module dist/libssh2-node.js] [--out results.json]
+//              [--iterations 20] [--bytes 67108864] [--kex a,b,c]
+//
+// Needs sshd (override with SSHD=/path/to/sshd) and ssh-keygen. Results are
+// written as JSON so runs of different builds can be diffed or plotted.
+
+import { writeFileSync } from "node:fs";
+import { join, resolve } from "node:path";
+import { parseArgs } from "node:util";
+import { pathToFileURL } from "node:url";
+
+import { Connection, LIBSSH2_ERROR_EAGAIN } from "./client.mjs";
+import { createFixture, sshdVersion, startSshd } from "./sshd.mjs";
+
+const DEFAULT_KEX = [
+  "curve25519-sha256",
+  "ecdh-sha2-nistp256",
+  "ecdh-sha2-nistp384",
+  "diffie-hellman-group14-sha256",
+  "diffie-hellman-group16-sha512",
+  "diffie-hellman-group-exchange-sha256",
+];
+
+const LIBSSH2_FXF_READ = 0x01;
+const LIBSSH2_FXF_WRITE = 0x02;
+const LIBSSH2_FXF_CREAT = 0x08;
+const LIBSSH2_FXF_TRUNC = 0x10;
+
+const { values: options } = parseArgs({
+  options: {
+    module: { type: "string", default: "dist/libssh2-node.js" },
+    out: { type: "string" },
+    iterations: { type: "string", default: "20" },
+    bytes: { type: "string", default: String(64 * 1024 * 1024) },
+    kex: { type: "string", default: DEFAULT_KEX.join(",") },
+  },
+});
+
+const iterations = Number(options.iterations);
+const totalBytes = Number(options.bytes);
+
+let jsHeapPeak = 0;
+function sampleHeap() {
+  jsHeapPeak = Math.max(jsHeapPeak, process.memoryUsage().heapUsed);
+}
+
+function summarize(samples) {
+  const sorted = [...samples].sort((a, b) => a - b);
+  const at = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+  return {
+    samples: sorted.length,
+    min_ms: sorted[0],
+    median_ms: at(0.5),
+    p95_ms: at(0.95),
+    max_ms: sorted[sorted.length - 1],
+  };
+}
+
+function throughput(bytes, ms) {
+  return { bytes, ms, mb_per_s: bytes / 1e6 / (ms / 1000) };
+}
+
+async function connectSession(SSH2, fixture, port) {
+  const conn = new Connection(SSH2);
+  await conn.open(port);
+  await conn.handshake();
+  await conn.authenticate(fixture.user, fixture.privateKey);
+  return conn;
+}
+
+async function openChannel(conn) {
+  return conn.retryPointer(() =>
+    conn.call("ssh2_channel_open_session", "number", ["number"], [conn.session]));
+}
+
+// Read a channel to EOF into buf, returning the number of bytes read
+async function drainChannel(conn, channel, buf, buflen) {
+  let total = 0;
+  for (;;) {
+    const rc = conn.call("ssh2_channel_read", "number", ["number", "number", "number"], [channel, buf, buflen]);
+    if (rc > 0) {
+      total += rc;
+      continue;
+    }
+    if (rc === 0 || conn.call("ssh2_channel_eof", "number", ["number"], [channel]) === 1) break;
+    if (rc !== LIBSSH2_ERROR_EAGAIN) throw new Error(`channel read failed (${rc})`);
+    await conn.readable();
+  }
+  return total;
+}
+
+async function closeChannel(conn, channel) {
+  await conn.retry(() => conn.call("ssh2_channel_close", "number", ["number"], [channel]));
+  await conn.retry(() => conn.call("ssh2_channel_wait_closed", "number", ["number"], [channel]));
+  conn.call("ssh2_channel_free", null, ["number"], [channel]);
+}
+
+async function exec(conn, command, buf, buflen) {
+  const channel = await openChannel(conn);
+  await conn.check(conn.retry(() =>
+    conn.call("ssh2_channel_exec", "number", ["number", "string"], [channel, command])), "exec");
+  const bytes = await drainChannel(conn, channel, buf, buflen);
+  await closeChannel(conn, channel);
+  return bytes;
+}
+
+// Connect + handshake time for each key exchange the server is limited to
+async function benchHandshake(SSH2, fixture) {
+  const results = {};
+  for (const kex of options.kex.split(",")) {
+    const sshd = await startSshd(fixture, { kex });
+    const samples = [];
+    try {
+      for (let i = 0; i < iterations; i++) {
+        const conn = new Connection(SSH2);
+        const start = performance.now();
+        await conn.open(sshd.port);
+        await conn.handshake();
+        samples.push(performance.now() - start);
+        await conn.close();
+        sampleHeap();
+      }
+      results[kex] = summarize(samples);
+    } catch (error) {
+      results[kex] = { error: error.message };
+    } finally {
+      await sshd.stop();
+    }
+  }
+  return results;
+}
+
+async function benchExec(conn, buf, buflen) {
+  const samples = [];
+  for (let i = 0; i < iterations; i++) {
+    const start = performance.now();
+    await exec(conn, "true", buf, buflen);
+    samples.push(performance.now() - start);
+  }
+  sampleHeap();
+  return summarize(samples);
+}
+
+async function benchChannel(conn, buf, buflen) {
+  const start = performance.now();
+  const bytes = await exec(conn, `head -c ${totalBytes} /dev/zero`, buf, buflen);
+  sampleHeap();
+  return throughput(bytes, performance.now() - start);
+}
+
+async function runTransfer(conn, handle, direction, callbacks) {
+  const { SSH2 } = conn;
+  const id = SSH2.registerSftpTransfer(callbacks);
+  // libssh2_uint64_t arguments are BigInts (WASM_BIGINT)
+  const transfer = direction === "get"
+    ? conn.call("ssh2_sftp_get_file", "number",
+      ["number", "number", "number", "number", "number"],
+      [handle, id, 0n, 0n, 2 * 1024 * 1024])
+    : conn.call("ssh2_sftp_put_file", "number",
+      ["number", "number", "number", "number"],
+      [handle, id, 0n, 2 * 1024 * 1024]);
+  try {
+    await conn.check(conn.retry(() =>
+      conn.call("ssh2_sftp_transfer_step", "number", ["number"], [transfer])), `sftp ${direction}`);
+  } finally {
+    conn.call("ssh2_sftp_transfer_free", null, ["number"], [transfer]);
+    SSH2.unregisterSftpTransfer(id);
+  }
+}
+
+async function benchSftp(conn, fixture) {
+  const sftp = await conn.retryPointer(() =>
+    conn.call("ssh2_sftp_init", "number", ["number"], [conn.session]));
+  const path = join(fixture.dir, "sftp.bin");
+  const openFile = (flags) => conn.retryPointer(() =>
+    conn.call("ssh2_sftp_open", "number", ["number", "string", "number", "number"], [sftp, path, flags, 0o644]));
+  const closeFile = (handle) => conn.retry(() =>
+    conn.call("ssh2_sftp_close_handle", "number", ["number"], [handle]));
+
+  let handle = await openFile(LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | LIBSSH2_FXF_TRUNC);
+  let start = performance.now();
+  await runTransfer(conn, handle, "put", {
+    source: (ptr, maxLength, offset) => {
+      const n = Math.min(maxLength, totalBytes - offset);
+      conn.SSH2.HEAPU8.fill(0x5a, ptr, ptr + n);
+      return n;
+    },
+  });
+  await closeFile(handle);
+  const put = throughput(totalBytes, performance.now() - start);
+  sampleHeap();
+
+  let received = 0;
+  handle = await openFile(LIBSSH2_FXF_READ);
+  start = performance.now();
+  await runTransfer(conn, handle, "get", { sink: (ptr, length) => { received += length; } });
+  await closeFile(handle);
+  const get = throughput(received, performance.now() - start);
+  sampleHeap();
+
+  await conn.retry(() => conn.call("ssh2_sftp_shutdown", "number", ["number"], [sftp]));
+  return { get, put };
+}
+
+async function main() {
+  const modulePath = resolve(options.module);
+  const { default: createModule } = await import(pathToFileURL(modulePath).href);
+  const SSH2 = await createModule();
+  SSH2.ccall("ssh2_init", "number", [], []);
+
+  const fixture = createFixture();
+  const results = {
+    meta: {
+      module: options.module,
+      libssh2: SSH2.ccall("ssh2_version", "string", [], []),
+      sshd: sshdVersion(),
+      node: process.version,
+      platform: `${process.platform}-${process.arch}`,
+      date: new Date().toISOString(),
+      iterations,
+      bytes: totalBytes,
+    },
+  };
+
+  try {
+    results.handshake = await benchHandshake(SSH2, fixture);
+
+    const sshd = await startSshd(fixture);
+    const buflen = 256 * 1024;
+    const buf = SSH2._malloc(buflen);
+    try {
+      const conn = await connectSession(SSH2, fixture, sshd.port);
+      results.exec = await benchExec(conn, buf, buflen);
+      results.channel = await benchChannel(conn, buf, buflen);
+      results.sftp = await benchSftp(conn, fixture);
+      await conn.close();
+    } finally {
+      SSH2._free(buf);
+      await sshd.stop();
+    }
+
+    results.memory = {
+      wasm_peak_bytes: SSH2.HEAPU8.length, // Linear memory only grows
+      js_heap_peak_bytes: jsHeapPeak,
+    };
+  } finally {
+    fixture.cleanup();
+  }
+
+  const json = JSON.stringify(results, null, 2);
+  if (options.out) {
+    writeFileSync(options.out, json + "\n");
+  } else {
+    console.log(json);
+  }
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
@@ -0,0 +1,102 @@
+// Throwaway OpenSSH server on loopback for the benchmarks. Keys, config and
+// SFTP scratch files live in a temporary directory removed by stop().
+
+import { spawn, execFileSync } from "node:child_process";
+import { mkdtempSync, readFileSync, rmSync, writeFileSync } from "node:fs";
+import { createServer, connect } from "node:net";
+import { tmpdir, userInfo } from "node:os";
+import { join } from "node:path";
+
+const SSHD = process.env.SSHD || "/usr/sbin/sshd";
+
+function freePort() {
+  return new Promise((resolve, reject) => {
+    const server = createServer();
+    server.once("error", reject);
+    server.listen(0, "127.0.0.1", () => {
+      const { port } = server.address();
+      server.close(() => resolve(port));
+    });
+  });
+}
+
+async function waitForPort(port, child) {
+  for (let attempt = 0; attempt < 100; attempt++) {
+    if (child.exitCode !== null) {
+      throw new Error(`sshd exited with status ${child.exitCode}`);
+    }
+    const open = await new Promise((resolve) => {
+      const socket = connect(port, "127.0.0.1");
+      socket.once("connect", () => { socket.destroy(); resolve(true); });
+      socket.once("error", () => resolve(false));
+    });
+    if (open) return;
+    await new Promise((resolve) => setTimeout(resolve, 50));
+  }
+  throw new Error(`sshd did not listen on port ${port}`);
+}
+
+export function sshdVersion() {
+  try {
+    execFileSync(SSHD, ["-V"], { stdio: "pipe" });
+  } catch (error) {
+    // sshd -V prints the version to stderr and exits non-zero on older releases
+    return String(error.stderr || "").trim().split("\n")[0];
+  }
+  return "";
+}
+
+// Create keys shared by every sshd started with the returned directory
+export function createFixture() {
+  const dir = mkdtempSync(join(tmpdir(), "libssh2-bench-"));
+  execFileSync("ssh-keygen", ["-q", "-t", "ed25519", "-N", "", "-f", join(dir, "host_key")]);
+  execFileSync("ssh-keygen", ["-q", "-t", "ed25519", "-N", "", "-f", join(dir, "user_key")]);
+  writeFileSync(join(dir, "authorized_keys"), readFileSync(join(dir, "user_key.pub")));
+
+  return {
+    dir,
+    user: userInfo().username,
+    privateKey: readFileSync(join(dir, "user_key"), "utf8"),
+    cleanup: () => rmSync(dir, { recursive: true, force: true }),
+  };
+}
+
+// Start sshd, optionally restricted to one key exchange method
+export async function startSshd(fixture, { kex } = {}) {
+  const port = await freePort();
+  const config = join(fixture.dir, "sshd_config");
+  writeFileSync(config, [
+    `ListenAddress 127.0.0.1:${port}`,
+    `HostKey ${join(fixture.dir, "host_key")}`,
+    `AuthorizedKeysFile ${join(fixture.dir, "authorized_keys")}`,
+    `PidFile none`,
+    `StrictModes no`,
+    `UsePAM no`,
+    `PasswordAuthentication no`,
+    `PubkeyAuthentication yes`,
+    `MaxSessions 64`,
+    `Subsystem sftp internal-sftp`,
+    kex ? `KexAlgorithms ${kex}` : "",
+    "",
+  ].join("\n"));
+
+  const child = spawn(SSHD, ["-D", "-e", "-f", config], { stdio: ["ignore", "ignore", "pipe"] });
+  let stderr = "";
+  child.stderr.on("data", (chunk) => { stderr += chunk; });
+
+  try {
+    await waitForPort(port, child);
+  } catch (error) {
+    child.kill();
+    throw new Error(`${error.message}\n${stderr}`);
+  }
+
+  return {
+    port,
+    stop: () => new Promise((resolve) => {
+      if (child.exitCode !== null) return resolve();
+      child.once("exit", () => resolve());
+      child.kill();
+    }),
+  };
+}
@@ -0,0 +1,119 @@
+#!/usr/bin/env node
+// Cold-start report for the build variants produced by build.sh --matrix.
+//
+//   pnpm bench:startup [--variants libssh2,libssh2-node,...] [--runs 10] [--out startup.json]
+//
+// For each dist/<variant>.wasm: size (raw and gzip), WebAssembly.compile
+// time, time until the module factory resolves, and time to first
+// completed handshake against a local sshd (module load included). Each
+// run imports a fresh copy of the glue so nothing is shared between runs.
+
+import { readFileSync, statSync, writeFileSync } from "node:fs";
+import { resolve } from "node:path";
+import { pathToFileURL } from "node:url";
+import { parseArgs } from "node:util";
+import { gzipSync } from "node:zlib";
+
+import { Connection } from "./client.mjs";
+import { createFixture, startSshd } from "./sshd.mjs";
+
+const { values: options } = parseArgs({
+  options: {
+    variants: { type: "string", default: "libssh2,libssh2-debug,libssh2-node,libssh2-worker" },
+    runs: { type: "string", default: "10" },
+    out: { type: "string" },
+  },
+});
+
+const runs = Number(options.runs);
+
+function median(samples) {
+  const sorted = [...samples].sort((a, b) => a - b);
+  return sorted[Math.floor(sorted.length / 2)];
+}
+
+// Worker glue reads self.location; give it one when running on the main thread
+function ensureWorkerGlobals(url) {
+  if (typeof globalThis.self === "undefined") {
+    globalThis.self = globalThis;
+  }
+  if (typeof globalThis.self.location === "undefined") {
+    globalThis.self.location = { href: url };
+  }
+}
+
+async function loadFactory(variant, run) {
+  const url = pathToFileURL(resolve("dist", `${variant}.js`)).href;
+  if (variant.endsWith("-worker")) ensureWorkerGlobals(url);
+  // A distinct query string defeats the ESM cache, so every run is cold
+  const { default: factory } = await import(`${url}?run=${run}`);
+  return factory;
+}
+
+async function measureVariant(variant, fixture, port) {
+  const wasmPath = resolve("dist", `${variant}.wasm`);
+  const wasmBinary = readFileSync(wasmPath);
+  const result = {
+    wasm_bytes: statSync(wasmPath).size,
+    wasm_gzip_bytes: gzipSync(wasmBinary, { level: 9 }).length,
+    js_bytes: statSync(resolve("dist", `${variant}.js`)).size,
+  };
+
+  const compile = [];
+  const instantiate = [];
+  const firstHandshake = [];
+
+  for (let run = 0; run < runs; run++) {
+    let start = performance.now();
+    await WebAssembly.compile(wasmBinary);
+    compile.push(performance.now() - start);
+
+    start = performance.now();
+    const factory = await loadFactory(variant, run);
+    const SSH2 = await factory({ wasmBinary });
+    instantiate.push(performance.now() - start);
+
+    SSH2.ccall("ssh2_init", "number", [], []);
+    const conn = new Connection(SSH2);
+    await conn.open(port);
+    await conn.handshake();
+    firstHandshake.push(performance.now() - start);
+    await conn.close();
+  }
+
+  result.compile_ms = median(compile);
+  result.instantiate_ms = median(instantiate);
+  result.first_handshake_ms = median(firstHandshake);
+  return result;
+}
+
+async function main() {
+  const fixture = createFixture();
+  const sshd = await startSshd(fixture);
+  const results = { meta: { node: process.version, runs, date: new Date().toISOString() }, variants: {} };
+
+  try {
+    for (const variant of options.variants.split(",")) {
+      try {
+        results.variants[variant] = await measureVariant(variant, fixture, sshd.port);
+      } catch (error) {
+        results.variants[variant] = { error: error.message };
+      }
+    }
+  } finally {
+    await sshd.stop();
+    fixture.cleanup();
+  }
+
+  const json = JSON.stringify(results, null, 2);
+  if (options.out) {
+    writeFileSync(options.out, json + "\n");
+  } else {
+    console.log(json);
+  }
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exit(1);
+});
@@ -5,6 +5,141 @@ set -euo pipefail
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 EMPORTS="$SCRIPT_DIR/vendors/.tmp/emscripten"
 
+# C translation units linked into libssh2.wasm
+SOURCES=(
+    src/libssh2-bindings.c
+    src/ssh2-transport.c
+    src/ssh2-channels.c
+    src/ssh2-exec-pool.c
+    src/ssh2-knownhosts.c
+    src/ssh2-keys.c
+    src/ssh2-heap.c
+    src/ssh2-sftp-transfer.c
+    src/ssh2-sftp-dir.c
+    src/ssh2-sftp-walk.c
+    src/ssh2-sftp-cache.c
+    src/ssh2-sftp-batch.c
+    src/ssh2-scp.c
+    src/ssh2-forward.c
+    src/ssh2-stats.c
+    src/ssh2-trace.c
+    src/ssh2-bench.c
+)
+
+# libssh2 internals routed through src/ssh2-stats.c (-Wl,--wrap)
+WRAPPED_SYMBOLS=(
+    _libssh2_transport_read
+    _libssh2_transport_send
+    _libssh2_kex_exchange
+)
+
+# JS appended to the generated glue (runs inside the module closure)
+POST_JS=(
+    src/js/transport.js
+    src/js/channels.js
+    src/js/sftp.js
+    src/js/stats.js
+    src/js/trace.js
+    src/js/knownhosts.js
+    src/js/keys.js
+    src/js/methods.js
+    src/js/scp.js
+    src/js/forward.js
+)
+
+# Release builds optimize for size: emcc runs wasm-opt -Oz over the linked
+# module. Crypto hot paths come precompiled at -O3 from the vendor build.
+RELEASE_FLAGS=(
+    -Oz
+    -s ASSERTIONS=0
+    -s SAFE_HEAP=0
+)
+
+# Appended after RELEASE_FLAGS for dist/libssh2-debug.js (last flag wins)
+DEBUG_FLAGS=(
+    -O0
+    -g
+    -s ASSERTIONS=2
+    -s SAFE_HEAP=1
+    -s STACK_OVERFLOW_CHECK=2
+)
+
+# Exports that may suspend on the transport in async builds (--async/--jspi),
+# including teardown that closes channels or SFTP handles in blocking mode
+ASYNC_EXPORTS=(
+    ssh2_session_handshake
+    ssh2_session_handshake_custom
+    ssh2_session_disconnect
+    ssh2_session_free
+    ssh2_userauth_list
+    ssh2_userauth_password
+    ssh2_userauth_publickey_fromfile
+    ssh2_userauth_publickey_frommemory
+    ssh2_userauth_publickey_key
+    ssh2_channel_open_session
+    ssh2_channel_direct_tcpip
+    ssh2_channel_open_ex
+    ssh2_channel_receive_window_adjust
+    ssh2_channel_close
+    ssh2_channel_wait_closed
+    ssh2_channel_free
+    ssh2_channel_send_eof
+    ssh2_channel_request_pty
+    ssh2_channel_request_pty_ex
+    ssh2_channel_request_pty_size
+    ssh2_channel_shell
+    ssh2_channel_exec
+    ssh2_channel_subsystem
+    ssh2_channel_setenv
+    ssh2_channel_read
+    ssh2_channel_read_stderr
+    ssh2_channel_write
+    ssh2_channel_write_stderr
+    ssh2_channel_flush
+    ssh2_sftp_init
+    ssh2_sftp_shutdown
+    ssh2_sftp_open
+    ssh2_sftp_opendir
+    ssh2_sftp_close_handle
+    ssh2_sftp_read
+    ssh2_sftp_write
+    ssh2_sftp_readdir
+    ssh2_sftp_stat
+    ssh2_sftp_lstat
+    ssh2_sftp_stat_packed
+    ssh2_sftp_setstat
+    ssh2_sftp_mkdir
+    ssh2_sftp_rmdir
+    ssh2_sftp_unlink
+    ssh2_sftp_rename
+    ssh2_sftp_symlink
+    ssh2_sftp_readlink
+    ssh2_sftp_realpath
+    ssh2_scp_recv2
+    ssh2_scp_send64
+    ssh2_scp_transfer_step
+    ssh2_scp_transfer_free
+    ssh2_channel_forward_listen
+    ssh2_channel_forward_accept
+    ssh2_channel_forward_cancel
+    ssh2_channel_forward_listen_ex
+    ssh2_forward_listen
+    ssh2_forward_step
+    ssh2_forward_free
+    ssh2_channel_read_nowait
+    ssh2_channel_write_nowait
+    ssh2_channel_send_eof_nowait
+    ssh2_session_pump
+    ssh2_channel_read_batch
+    ssh2_exec_pool_step
+    ssh2_sftp_transfer_step
+    ssh2_sftp_readdir_batch
+    ssh2_sftp_walk_step
+    ssh2_sftp_walk_free
+    ssh2_sftp_batch_stat
+    ssh2_sftp_batch_free
+)
+
 # Colors for output
 RED='\033[0;31m'
 GREEN='\033[0;32m'
@@ -79,13 +214,27 @@ clean() {
     mkdir -p dist
 }
 
+# Build dist/<name>.js and dist/<name>.wasm; extra arguments go to emcc
 build_libssh2_wasm() {
-    log_info "Building libssh2.js WebAssembly wrapper..."
+    local name="${1:-libssh2}"
+    shift || true
+
+    log_info "Building $name.js WebAssembly wrapper..."
 
     mkdir -p dist
 
-    if ! emcc src/libssh2-bindings.c \
-      -o dist/libssh2.js \
+    local post_js_args=()
+    for file in "${POST_JS[@]}"; do
+        post_js_args+=(--post-js "$file")
+    done
+
+    local wrap_args=()
+    for symbol in "${WRAPPED_SYMBOLS[@]}"; do
+        wrap_args+=("-Wl,--wrap=$symbol")
+    done
+
+    if ! emcc "${SOURCES[@]}" \
+      -o "dist/$name.js" \
       -I$EMPORTS/include \
       -L$EMPORTS/lib \
       -lssh2 -lssl -lcrypto -lz \
@@ -93,32 +242,91 @@ build_libssh2_wasm() {
       -s EXPORT_ES6=1 \
       -s ENVIRONMENT=web \
       -s EXPORTED_FUNCTIONS='["_malloc","_free"]' \
-      -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap","getValue","setValue","FS","HEAPU8"]' \
+      -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap","getValue","setValue","FS","HEAPU8","HEAPU16","HEAP32","HEAPU32","HEAPF64"]' \
       -s ALLOW_MEMORY_GROWTH=1 \
       -s INITIAL_MEMORY=32MB \
       -s STACK_SIZE=2MB \
       -s NO_EXIT_RUNTIME=1 \
-      -s ASSERTIONS=1 \
-      -s SAFE_HEAP=0 \
-      -s DISABLE_EXCEPTION_CATCHING=0 \
-      -O3 \
-      --bind; then
-        log_error "Failed to build libssh2.js WebAssembly wrapper"
+      "${RELEASE_FLAGS[@]}" \
+      "${post_js_args[@]}" \
+      "${wrap_args[@]}" \
+      "$@"; then
+        log_error "Failed to build $name.js WebAssembly wrapper"
         exit 1
     fi
 
-    log_success "libssh2.js WebAssembly wrapper built successfully"
+    log_success "$name.js WebAssembly wrapper built successfully"
+}
+
+# Build a variant whose transport recv can suspend until data arrives.
+# "asyncify" rewrites the wasm to unwind/rewind the stack; "jspi" uses
+# JavaScript Promise Integration and needs a runtime that supports it.
+build_libssh2_async() {
+    local mode="$1"
+    local exports
+    exports=$(printf "'%s'," "${ASYNC_EXPORTS[@]}")
+    exports="[${exports%,}]"
+
+    if [ "$mode" = "jspi" ]; then
+        build_libssh2_wasm libssh2-jspi \
+          -DSSH2_ASYNC \
+          -s JSPI=1 \
+          -s "JSPI_EXPORTS=$exports" \
+          --post-js src/js/async.js
+    else
+        build_libssh2_wasm libssh2-async \
+          -DSSH2_ASYNC \
+          -s ASYNCIFY=1 \
+          -s ASYNCIFY_STACK_SIZE=65536 \
+          --post-js src/js/async.js
+    fi
+}
+
+# Build dist/libssh2-simd.js against the vendors/build.sh --simd libraries.
+# src/libssh2-loader.js picks it when the runtime validates SIMD opcodes.
+build_libssh2_simd() {
+    EMPORTS="$SCRIPT_DIR/vendors/.tmp/emscripten-simd"
+    if [ ! -f "$EMPORTS/lib/libssh2.a" ]; then
+        log_error "SIMD vendor libraries not found. Run ./vendors/build.sh --simd first."
+        exit 1
+    fi
+
+    build_libssh2_wasm libssh2-simd -msimd128
+}
+
+# Build every variant shipped in the package and report their sizes.
+# bench/startup.mjs measures compile time and time to first handshake.
+build_libssh2_matrix() {
+    build_libssh2_wasm libssh2
+    build_libssh2_wasm libssh2-debug "${DEBUG_FLAGS[@]}"
+    build_libssh2_wasm libssh2-node -s ENVIRONMENT=node
+    build_libssh2_wasm libssh2-worker -s ENVIRONMENT=worker
+
+    echo "========================================="
+    log_info "Variant sizes:"
+    for name in libssh2 libssh2-debug libssh2-node libssh2-worker; do
+        local wasm_size js_size gzip_size
+        wasm_size=$(wc -c < "dist/$name.wasm")
+        gzip_size=$(gzip -9 -c "dist/$name.wasm" | wc -c)
+        js_size=$(wc -c < "dist/$name.js")
+        printf "  %-16s wasm %10d  wasm.gz %10d  js %8d\n" "$name" "$wasm_size" "$gzip_size" "$js_size"
+    done
 }
 
 # Handle script arguments
 case "${1:-}" in
     --help|-h)
-        echo "Usage: $0 [--with-types] [--help]"
+        echo "Usage: $0 [--with-types] [--async] [--jspi] [--node] [--simd] [--matrix] [--help]"
         echo ""
         echo "Builds libssh2.js WebAssembly library"
         echo ""
         echo "Options:"
         echo "  --with-types    Generate TypeScript declarations after build"
+        echo "  --async         Build dist/libssh2-async.js (Asyncify, Promise-returning calls)"
+        echo "  --jspi          Build dist/libssh2-jspi.js (JS Promise Integration)"
+        echo "  --node          Build dist/libssh2-node.js (Node.js environment, used by pnpm bench)"
+        echo "  --simd          Build dist/libssh2-simd.js (WebAssembly SIMD, needs vendors/build.sh --simd)"
+        echo "  --matrix        Build release, debug, node and worker variants and report sizes"
         echo "  --help          Show this help message"
         exit 0
         ;;
@@ -126,6 +334,26 @@ case "${1:-}" in
         check_emscripten
         build_libssh2_wasm
         ;;
+    --async)
+        check_emscripten
+        build_libssh2_async asyncify
+        ;;
+    --jspi)
+        check_emscripten
+        build_libssh2_async jspi
+        ;;
+    --node)
+        check_emscripten
+        build_libssh2_wasm libssh2-node -s ENVIRONMENT=node
+        ;;
+    --simd)
+        check_emscripten
+        build_libssh2_simd
+        ;;
+    --matrix)
+        check_emscripten
+        build_libssh2_matrix
+        ;;
     "")
         check_emscripten
         build_libssh2_wasm
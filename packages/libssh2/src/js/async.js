@@ -0,0 +1,53 @@
+// Async builds (build.sh --async / --jspi). libssh2 calls may suspend in the
+// transport recv callback until the WebSocket delivers data, so they must be
+// made through ssh2Async(), which always returns a Promise.
+//
+// libssh2 must never be re-entered for a session while one of its calls is
+// suspended mid-packet, so calls are queued. Pass the session the call
+// belongs to (for channel, SFTP and other handles too) as `session`.
+
+function asyncSettled(promise) {
+  return promise.catch(function () {});
+}
+
+#if ASYNCIFY == 1
+// Asyncify can only have one suspended call stack at a time, so calls are
+// queued and run one after another whatever their session.
+var asyncQueue = Promise.resolve();
+
+Module.ssh2Async = function (ident, returnType, argTypes, args, session) {
+  var result = asyncQueue.then(function () {
+    return ccall(ident, returnType, argTypes, args, { async: true });
+  });
+  asyncQueue = asyncSettled(result);
+  return result;
+};
+#else
+// JSPI can keep many calls suspended, so calls are chained per session and
+// different sessions overlap. A call without a session runs on its own:
+// after everything already queued and before anything queued after it.
+var sessionQueues = new Map();
+var asyncBarrier = Promise.resolve();
+
+Module.ssh2Async = function (ident, returnType, argTypes, args, session) {
+  function run() {
+    return ccall(ident, returnType, argTypes, args, { async: true });
+  }
+
+  var result;
+  if (session) {
+    result = Promise.all([sessionQueues.get(session), asyncBarrier]).then(run);
+    var tail = asyncSettled(result);
+    sessionQueues.set(session, tail);
+    tail.then(function () {
+      if (sessionQueues.get(session) === tail) sessionQueues.delete(session);
+    });
+  } else {
+    var queued = Array.from(sessionQueues.values());
+    queued.push(asyncBarrier);
+    result = Promise.all(queued).then(run);
+    asyncBarrier = asyncSettled(result);
+  }
+  return result;
+};
+#endif
@@ -0,0 +1,216 @@
+// Decoder for ssh2_channel_read_batch arenas (see ssh2_read_record in
+// src/ssh2-internal.h): u32 id, u32 stream, u32 length, payload, 4-byte padding.
+
+var READ_RECORD_HEADER = 12;
+
+var READ_ERROR_STREAM = 0xffffffff;
+
+// Call visit(id, stream, view) for each record in the first `used` bytes.
+// Views alias the arena and are only valid until it is reused. A channel
+// whose read failed is reported to onError(id, code) instead.
+Module.decodeReadBatch = function (arena, used, visit, onError) {
+  var offset = 0;
+  while (offset + READ_RECORD_HEADER <= used) {
+    var base = (arena + offset) >> 2;
+    var id = HEAPU32[base];
+    var stream = HEAPU32[base + 1];
+    var length = HEAPU32[base + 2];
+    var start = arena + offset + READ_RECORD_HEADER;
+    if (stream === READ_ERROR_STREAM) {
+      if (onError) onError(id, HEAP32[start >> 2]);
+    } else {
+      visit(id, stream, HEAPU8.subarray(start, start + length));
+    }
+    offset += (READ_RECORD_HEADER + length + 3) & ~3;
+  }
+};
+
+// Decoder for the ssh2_exec_result that ssh2_exec_pool_next fills in:
+// i32 job, error, exit_status, u32 flags, then stdout and stderr as
+// (pointer, length) pairs owned by the pool.
+var SSH2_EXEC_TRUNCATED = 0x1;
+var SSH2_EXEC_SIGNALED = 0x2;
+
+// stdout/stderr are HEAPU8 views, valid until ssh2_exec_pool_release
+Module.decodeExecResult = function (ptr) {
+  var base = ptr >> 2;
+  var flags = HEAPU32[base + 3];
+  return {
+    job: HEAP32[base],
+    error: HEAP32[base + 1],
+    exitStatus: HEAP32[base + 2],
+    truncated: (flags & SSH2_EXEC_TRUNCATED) !== 0,
+    signaled: (flags & SSH2_EXEC_SIGNALED) !== 0,
+    stdout: HEAPU8.subarray(HEAPU32[base + 4], HEAPU32[base + 4] + HEAPU32[base + 5]),
+    stderr: HEAPU8.subarray(HEAPU32[base + 6], HEAPU32[base + 6] + HEAPU32[base + 7]),
+  };
+};
+
+// libssh2_channel_handle_extended_data2 modes for channelStream's stderr option
+var CHANNEL_EAGAIN = -37;
+var EXTENDED_DATA_MODES = { separate: 0, ignore: 1, merge: 2 };
+
+// Channel streams: { readable, writable, stderr } WHATWG streams over one
+// open channel. Reads happen only when the consumer pulls (highWaterMark 0),
+// and libssh2 reopens the receive window only as it reads, so a slow
+// consumer leaves data in the window instead of in JS. Writes wait until
+// ssh2_channel_write_budget reports room in the remote window and TX ring.
+// All I/O goes through the ssh2_channel_*_nowait exports, which return
+// EAGAIN rather than waiting on the transport, and the stream waits on
+// options.wait between attempts. Async builds run one libssh2 call per
+// session at a time, so a read that waited for data would hold back every
+// write behind it, and an interactive shell would never send its input.
+// Each direction has its own chunkSize heap buffer, freed when that
+// direction finishes; the channel itself stays with the caller.
+// options: { wait, chunkSize (default 32 KiB), stderr: 'separate' | 'merge' | 'ignore' }
+
+// Async builds queue channel calls behind other calls on the session with
+// ssh2Async; either way the caller gets a Promise of the return code.
+// args[0] is always the session.
+function channelCall(ident, argTypes, args) {
+#if ASYNCIFY
+  return Module.ssh2Async(ident, 'number', argTypes, args, args[0]);
+#else
+  return Promise.resolve(ccall(ident, 'number', argTypes, args));
+#endif
+}
+
+Module.channelStream = function (session, channel, options) {
+  options = options || {};
+  var chunkSize = options.chunkSize || 32768;
+  var stderrMode = options.stderr || 'separate';
+
+  // options.wait resolves when the transport has new data or the TX ring drained
+  function wait() {
+    return options.wait ? options.wait() : new Promise(function (resolve) { setTimeout(resolve, 0); });
+  }
+
+  function fail(rc) {
+    var error = new Error('Channel stream failed (' + rc + ')');
+    error.code = rc;
+    return error;
+  }
+
+  if (EXTENDED_DATA_MODES[stderrMode]) {
+    ccall('ssh2_channel_handle_extended_data', 'number', ['number', 'number'],
+      [channel, EXTENDED_DATA_MODES[stderrMode]]);
+  }
+
+  function readable(stream) {
+    var buffer = _malloc(chunkSize);
+    var done = false;
+    var reading = null; // Read in flight, cancel waits for it before freeing
+
+    function finish() {
+      if (!done) {
+        done = true;
+        _free(buffer);
+        buffer = 0;
+      }
+    }
+
+    function pull(controller) {
+      var request = controller.byobRequest;
+      var view = request && request.view;
+      var want = view ? Math.min(view.byteLength, chunkSize) : chunkSize;
+
+      reading = channelCall('ssh2_channel_read_nowait', ['number', 'number', 'number', 'number', 'number'],
+        [session, channel, stream, buffer, want]);
+      return reading.then(function (rc) {
+        reading = null;
+        if (done) return;
+        if (rc === CHANNEL_EAGAIN) {
+          return wait().then(function () { return pull(controller); });
+        }
+        if (rc < 0) {
+          finish();
+          throw fail(rc);
+        }
+        if (rc === 0) {
+          finish();
+          controller.close();
+          if (controller.byobRequest) controller.byobRequest.respond(0);
+          return;
+        }
+
+        if (view) {
+          new Uint8Array(view.buffer, view.byteOffset, rc).set(HEAPU8.subarray(buffer, buffer + rc));
+          request.respond(rc);
+        } else {
+          controller.enqueue(HEAPU8.slice(buffer, buffer + rc));
+        }
+      });
+    }
+
+    return new ReadableStream({
+      type: 'bytes',
+      pull: pull,
+      cancel: function () {
+        return reading ? reading.then(finish, finish) : finish();
+      },
+    }, { highWaterMark: 0 });
+  }
+
+  var buffer = _malloc(chunkSize);
+  var done = false;
+
+  // A rejected sink write errors the WritableStream without calling abort,
+  // so every failure path frees the buffer itself
+  function finish() {
+    if (!done) {
+      done = true;
+      _free(buffer);
+      buffer = 0;
+    }
+  }
+
+  function write(bytes, offset) {
+    if (offset >= bytes.length) return Promise.resolve();
+
+    var budget = ccall('ssh2_channel_write_budget', 'number', ['number', 'number'], [session, channel]);
+    if (!budget) {
+      return wait().then(function () { return write(bytes, offset); });
+    }
+
+    var n = Math.min(budget, chunkSize, bytes.length - offset);
+    HEAPU8.set(bytes.subarray(offset, offset + n), buffer);
+    return channelCall('ssh2_channel_write_nowait', ['number', 'number', 'number', 'number'],
+      [session, channel, buffer, n])
+      .then(function (rc) {
+        if (rc === CHANNEL_EAGAIN) {
+          return wait().then(function () { return write(bytes, offset); });
+        }
+        if (rc < 0) {
+          finish();
+          throw fail(rc);
+        }
+        return write(bytes, offset + rc);
+      });
+  }
+
+  function sendEof() {
+    return channelCall('ssh2_channel_send_eof_nowait', ['number', 'number'], [session, channel]).then(function (rc) {
+      if (rc === CHANNEL_EAGAIN) return wait().then(sendEof);
+      finish();
+      if (rc < 0) throw fail(rc);
+    });
+  }
+
+  var writable = new WritableStream({
+    write: function (chunk) {
+      var bytes = ArrayBuffer.isView(chunk)
+        ? new Uint8Array(chunk.buffer, chunk.byteOffset, chunk.byteLength)
+        : new Uint8Array(chunk);
+      return write(bytes, 0);
+    },
+    close: sendEof,
+    abort: finish,
+  }, { highWaterMark: 1 });
+
+  return {
+    readable: readable(0),
+    writable: writable,
+    // SSH_EXTENDED_DATA_STDERR
+    stderr: stderrMode === 'separate' ? readable(1) : null,
+  };
+};
@@ -0,0 +1,18 @@
+// Port forwarding event targets (src/ssh2-forward.c).
+
+// Indexed by the id passed to ssh2_forward_new
+Module.forwarders = [null];
+
+// Register { event(conn, kind, a, b) } and return its id. kind is one of
+// SSH2_FORWARD_OPEN (a = in ring, b = out ring), SSH2_FORWARD_DATA (drain
+// the out ring, a), SSH2_FORWARD_CLOSE (drain the out ring one last time,
+// then drop the socket) or SSH2_FORWARD_ERROR (a = libssh2 error).
+Module.registerForwarder = function (forwarder) {
+  return tableInsert(Module.forwarders, forwarder);
+};
+
+Module.unregisterForwarder = function (id) {
+  if (id > 0) {
+    Module.forwarders[id] = null;
+  }
+};
@@ -0,0 +1,44 @@
+// Private key handles (src/ssh2-keys.c).
+
+// Loaded keys by PEM text and passphrase, so reconnecting sessions share one
+// handle and a wrong passphrase cannot hit a handle loaded with the right one
+var privateKeys = new Map();
+
+function privateKeyId(pem, passphrase) {
+  return passphrase == null ? pem : pem + '\0' + passphrase;
+}
+
+// Parse and decrypt a private key once and return its handle for
+// ssh2_userauth_publickey_key. Loading the same text again returns the
+// cached handle without parsing. Throws when the key cannot be read; failures
+// are not cached.
+Module.loadPrivateKey = function (pem, passphrase) {
+  var id = privateKeyId(pem, passphrase);
+  var key = privateKeys.get(id);
+  if (key) return key;
+
+  var bytes = new TextEncoder().encode(pem);
+  var ptr = _malloc(bytes.length + 1);
+  HEAPU8.set(bytes, ptr);
+  HEAPU8[ptr + bytes.length] = 0;
+  try {
+    key = ccall('ssh2_key_load', 'number', ['number', 'number', 'string'],
+      [ptr, bytes.length, passphrase === undefined ? null : passphrase]);
+  } finally {
+    HEAPU8.fill(0, ptr, ptr + bytes.length);
+    _free(ptr);
+  }
+  if (!key) {
+    throw new Error('Could not load private key (wrong passphrase or unsupported format)');
+  }
+  privateKeys.set(id, key);
+  return key;
+};
+
+// Drop a handle from the cache and free it
+Module.freePrivateKey = function (key) {
+  privateKeys.forEach(function (cached, id) {
+    if (cached === key) privateKeys.delete(id);
+  });
+  ccall('ssh2_key_free', null, ['number'], [key]);
+};
@@ -0,0 +1,43 @@
+// Host key helpers for the ssh2_knownhost_* store (src/ssh2-knownhosts.c).
+
+var hostkeyBuffer = 0;
+
+// The server's host key after the handshake: { key, type } with key a copy
+// of the blob (pass it to ssh2_knownhost_check/add) and type one of
+// LIBSSH2_HOSTKEY_TYPE_*. Returns null before the handshake.
+Module.sessionHostkey = function (session) {
+  if (!hostkeyBuffer) {
+    hostkeyBuffer = _malloc(8);
+  }
+  var key = ccall('ssh2_session_hostkey', 'number', ['number', 'number'], [session, hostkeyBuffer]);
+  if (!key) return null;
+  var length = HEAP32[hostkeyBuffer >> 2];
+  return { key: HEAPU8.slice(key, key + length), type: HEAP32[(hostkeyBuffer >> 2) + 1] };
+};
+
+// Copy bytes into a temporary heap buffer for the duration of fn(ptr, length)
+function withHeapBytes(bytes, fn) {
+  var ptr = _malloc(bytes.length || 1);
+  HEAPU8.set(bytes, ptr);
+  try {
+    return fn(ptr, bytes.length);
+  } finally {
+    _free(ptr);
+  }
+}
+
+// Load known_hosts text (string or UTF-8 bytes) without going through FS
+Module.loadKnownHosts = function (hosts, text) {
+  var bytes = typeof text === 'string' ? new TextEncoder().encode(text) : text;
+  return withHeapBytes(bytes, function (ptr, length) {
+    return ccall('ssh2_knownhost_load', 'number', ['number', 'number', 'number'], [hosts, ptr, length]);
+  });
+};
+
+// Check a host key blob; returns LIBSSH2_KNOWNHOST_CHECK_*
+Module.checkKnownHost = function (hosts, host, port, key) {
+  return withHeapBytes(key, function (ptr, length) {
+    return ccall('ssh2_knownhost_check', 'number', ['number', 'string', 'number', 'number', 'number'],
+      [hosts, host, port, ptr, length]);
+  });
+};
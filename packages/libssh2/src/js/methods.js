@@ -0,0 +1,47 @@
+// Algorithm preference helpers (src/libssh2-bindings.c, src/ssh2-bench.c).
+
+// Algorithms this build supports for a LIBSSH2_METHOD_* type, as an array
+Module.supportedAlgorithms = function (session, methodType) {
+  var list = ccall('ssh2_session_supported_algs', 'number', ['number', 'number'], [session, methodType]);
+  if (!list) return [];
+  try {
+    var text = new TextDecoder().decode(HEAPU8.subarray(list, HEAPU8.indexOf(0, list)));
+    return text ? text.split(',') : [];
+  } finally {
+    _free(list);
+  }
+};
+
+// Startup benchmark: time every cipher and MAC the build supports (results
+// are cached per module), order the session's preferences fastest first and
+// return the ciphers, then the MACs, as [{ name, mbPerSec }] in that order.
+// Cipher rates are per suite: AES-CTR includes the fastest MAC, AEAD ciphers
+// need none. Algorithms that are not benchmarked report mbPerSec null and
+// keep libssh2's order after the rest.
+var SUITE_ARGS = ['number', 'string', 'number'];
+
+Module.preferFastestAlgorithms = function (session, bytes) {
+  var rc = ccall('ssh2_session_prefer_fastest', 'number', ['number', 'number'], [session, bytes || 0]);
+  if (rc < 0) return null;
+
+  function ranked(methodType, rate) {
+    var results = Module.supportedAlgorithms(session, methodType).map(function (name, order) {
+      var mbPerSec = rate(name);
+      return { name: name, mbPerSec: mbPerSec > 0 ? mbPerSec : null, order: order };
+    });
+    results.sort(function (a, b) {
+      if (a.mbPerSec !== b.mbPerSec) return (b.mbPerSec || -1) - (a.mbPerSec || -1);
+      return a.order - b.order;
+    });
+    return results.map(function (result) {
+      return { name: result.name, mbPerSec: result.mbPerSec };
+    });
+  }
+
+  // LIBSSH2_METHOD_CRYPT_CS and LIBSSH2_METHOD_MAC_CS
+  return ranked(2, function (name) {
+    return ccall('ssh2_bench_suite', 'number', SUITE_ARGS, [session, name, bytes || 0]);
+  }).concat(ranked(4, function (name) {
+    return ccall('ssh2_bench_algorithm', 'number', ['string', 'number'], [name, bytes || 0]);
+  }));
+};
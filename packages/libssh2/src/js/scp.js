@@ -0,0 +1,292 @@
+// SCP transfer callbacks and stream adapters (src/ssh2-scp.c).
+
+// Indexed by the id passed to ssh2_scp_get / ssh2_scp_put
+Module.scpTransfers = [null];
+
+// Register { open(size, mode, mtime), sink(ptr, length, offset) } for
+// downloads or { source(ptr, maxLength, offset) } for uploads and return its
+// id. A sink owns each chunk until it calls ssh2_chunk_release.
+Module.registerScpTransfer = function (transfer) {
+  return tableInsert(Module.scpTransfers, transfer);
+};
+
+Module.unregisterScpTransfer = function (id) {
+  if (id > 0) {
+    Module.scpTransfers[id] = null;
+  }
+};
+
+var SCP_EAGAIN = -37;
+
+// Streams created without options.pool get their own pool of 8 chunks of
+// 64 KiB, so a slow consumer only stalls its own transfer instead of holding
+// the chunks every other stream needs
+function scpChunkPool(options) {
+  if (options.pool) return options.pool;
+  var pool = ccall('ssh2_chunk_pool_new', 'number', ['number', 'number'], [8, 65536]);
+  if (!pool) throw new Error('ssh2_chunk_pool_new failed');
+  return pool;
+}
+
+// Free a stream's own pool once freeing its transfer (which releases the
+// chunk it holds) has settled; caller-supplied pools are left alone
+function scpPoolFree(options, pool, freed) {
+  if (options.pool || !pool) return freed;
+  function free() {
+    ccall('ssh2_chunk_pool_free', null, ['number'], [pool]);
+  }
+  if (freed && freed.then) {
+    return freed.then(free, function (error) {
+      free();
+      throw error;
+    });
+  }
+  free();
+  return freed;
+}
+
+// Resolves when the transport may have new data. Callers should pass
+// options.wait (e.g. resolved from ws.onmessage); the fallback polls.
+function scpWait(options) {
+  return options.wait ? options.wait() : new Promise(function (resolve) { setTimeout(resolve, 0); });
+}
+
+#if ASYNCIFY
+// ssh2_scp_transfer_step suspends on the transport in async builds, so it
+// is made through ssh2Async there and resolves to the same return codes
+function scpStep(session, transfer) {
+  return Module.ssh2Async('ssh2_scp_transfer_step', 'number', ['number'], [transfer], session);
+}
+#endif
+
+// Freeing an unfinished transfer closes its channel, which suspends on the
+// transport in async builds; there the Promise settles once it is closed
+function scpFree(session, transfer) {
+#if ASYNCIFY
+  return Module.ssh2Async('ssh2_scp_transfer_free', null, ['number'], [transfer], session);
+#else
+  ccall('ssh2_scp_transfer_free', null, ['number'], [transfer]);
+#endif
+}
+
+function scpError(session, rc) {
+  var message = ccall('ssh2_session_last_error', 'string', ['number'], [session]);
+  var error = new Error('SCP transfer failed (' + rc + ')' + (message ? ': ' + message : ''));
+  error.code = rc;
+  return error;
+}
+
+// Download path as a byte ReadableStream. Each pull copies from a pool chunk
+// straight into the reader's buffer when it is a BYOB reader, and chunks
+// are only released once read, so a slow consumer stops the transfer at the
+// pool's size instead of buffering the file in JS.
+// options: { pool, wait, onOpen({ size, mode, mtime }) }
+Module.scpReadableStream = function (session, path, options) {
+  options = options || {};
+  var pool = scpChunkPool(options);
+  var chunks = [];
+  var finished = false;
+  var transfer = 0;
+  var stepping = null; // Step in flight (async builds), cancel waits for it
+
+  var id = Module.registerScpTransfer({
+    open: function (size, mode, mtime) {
+      if (options.onOpen) options.onOpen({ size: size, mode: mode, mtime: mtime });
+    },
+    sink: function (ptr, length) {
+      chunks.push({ ptr: ptr, length: length, used: 0 });
+    },
+  });
+
+  function release() {
+    if (!pool) return;
+    chunks.forEach(function (chunk) {
+      ccall('ssh2_chunk_release', null, ['number', 'number'], [pool, chunk.ptr]);
+    });
+    chunks = [];
+    var freed = transfer ? scpFree(session, transfer) : undefined;
+    transfer = 0;
+    Module.unregisterScpTransfer(id);
+    freed = scpPoolFree(options, pool, freed);
+    pool = 0;
+    return freed;
+  }
+
+  function deliver(controller) {
+    var chunk = chunks[0];
+    var start = chunk.ptr + chunk.used;
+    var remaining = chunk.length - chunk.used;
+    var request = controller.byobRequest;
+
+    if (request && request.view) {
+      var view = request.view;
+      var n = Math.min(view.byteLength, remaining);
+      new Uint8Array(view.buffer, view.byteOffset, n).set(HEAPU8.subarray(start, start + n));
+      chunk.used += n;
+      request.respond(n);
+    } else {
+      controller.enqueue(HEAPU8.slice(start, start + remaining));
+      chunk.used = chunk.length;
+    }
+
+    if (chunk.used === chunk.length) {
+      chunks.shift();
+      ccall('ssh2_chunk_release', null, ['number', 'number'], [pool, chunk.ptr]);
+    }
+  }
+
+  // Handle one step result; returns a Promise when pull has to wait
+  function stepped(rc, controller) {
+    if (rc === 1) {
+      finished = true;
+    } else if (rc === SCP_EAGAIN) {
+      if (!chunks.length) {
+        return scpWait(options).then(function () { return pull(controller); });
+      }
+    } else if (rc < 0) {
+      var error = scpError(session, rc);
+      release();
+      throw error;
+    }
+  }
+
+  function pull(controller) {
+    for (;;) {
+      if (chunks.length) {
+        deliver(controller);
+        return;
+      }
+      if (finished) {
+        release();
+        controller.close();
+        if (controller.byobRequest) controller.byobRequest.respond(0);
+        return;
+      }
+
+#if ASYNCIFY
+      stepping = scpStep(session, transfer);
+      return stepping.then(function (rc) {
+        stepping = null;
+        return stepped(rc, controller) || pull(controller);
+      });
+#else
+      var wait = stepped(ccall('ssh2_scp_transfer_step', 'number', ['number'], [transfer]), controller);
+      if (wait) return wait;
+#endif
+    }
+  }
+
+  transfer = ccall('ssh2_scp_get', 'number', ['number', 'string', 'number', 'number'], [session, path, pool, id]);
+  if (!transfer) {
+    release();
+    throw new Error('ssh2_scp_get failed');
+  }
+
+  return new ReadableStream({
+    type: 'bytes',
+    pull: pull,
+    cancel: function () {
+      return stepping ? stepping.then(release, release) : release();
+    },
+  }, { highWaterMark: 0 });
+};
+
+// Upload `size` bytes to path through a WritableStream of Uint8Array (or
+// other ArrayBufferView) chunks. Each write resolves once its bytes are in
+// a pool chunk, so the producer runs no further ahead than one chunk.
+// options: { pool, wait, mode (default 0644), mtime, atime }
+Module.scpWritableStream = function (session, path, size, options) {
+  options = options || {};
+  var pool = scpChunkPool(options);
+  var pending = null;
+  var ended = false;
+  var transfer = 0;
+  var stepping = null; // Step in flight (async builds), abort waits for it
+
+  var id = Module.registerScpTransfer({
+    source: function (ptr, maxLength) {
+      if (!pending) return ended ? 0 : -1;
+      var n = Math.min(maxLength, pending.length - pending.used);
+      HEAPU8.set(pending.subarray(pending.used, pending.used + n), ptr);
+      pending.used += n;
+      if (pending.used === pending.length) pending = null;
+      return n;
+    },
+  });
+
+  function release() {
+    if (!pool) return;
+    var freed = transfer ? scpFree(session, transfer) : undefined;
+    transfer = 0;
+    Module.unregisterScpTransfer(id);
+    freed = scpPoolFree(options, pool, freed);
+    pool = 0;
+    return freed;
+  }
+
+  // Step until the pending write has been taken (or, when closing, until
+  // the transfer completes)
+  function drive() {
+#if ASYNCIFY
+    stepping = scpStep(session, transfer);
+    return stepping.then(function (rc) {
+      stepping = null;
+      return driven(rc);
+    });
+#else
+    return driven(ccall('ssh2_scp_transfer_step', 'number', ['number'], [transfer]));
+#endif
+  }
+
+  function driven(rc) {
+    if (rc === 1) {
+      release();
+      return Promise.resolve();
+    }
+    if (rc !== SCP_EAGAIN) {
+      var error = scpError(session, rc);
+      release();
+      return Promise.reject(error);
+    }
+    if (!pending && !ended) return Promise.resolve();
+    return scpWait(options).then(drive);
+  }
+
+  transfer = ccall('ssh2_scp_put', 'number',
+    ['number', 'string', 'number', 'number', 'number', 'number', 'number', 'number'],
+    [session, path, pool, id, options.mode === undefined ? 420 : options.mode, size,
+     options.mtime || 0, options.atime || 0]);
+  if (!transfer) {
+    release();
+    throw new Error('ssh2_scp_put failed');
+  }
+
+  return new WritableStream({
+    write: function (chunk) {
+      pending = ArrayBuffer.isView(chunk)
+        ? new Uint8Array(chunk.buffer, chunk.byteOffset, chunk.byteLength)
+        : new Uint8Array(chunk);
+      pending.used = 0;
+      if (!pending.length) pending = null;
+      return drive();
+    },
+    close: function () {
+      ended = true;
+      return drive();
+    },
+    abort: function () {
+      return stepping ? stepping.then(release, release) : release();
+    },
+  }, { highWaterMark: 1 });
+};
+
+#if ENVIRONMENT_MAY_BE_NODE
+// Node streams over the same engine (node builds only)
+Module.scpNodeReadable = function (session, path, options) {
+  return require('node:stream').Readable.fromWeb(Module.scpReadableStream(session, path, options));
+};
+
+Module.scpNodeWritable = function (session, path, size, options) {
+  return require('node:stream').Writable.fromWeb(Module.scpWritableStream(session, path, size, options));
+};
+#endif
@@ -0,0 +1,206 @@
+// SFTP transfer sinks and sources, indexed by the id passed to
+// ssh2_sftp_get_file / ssh2_sftp_put_file.
+Module.sftpTransfers = [null];
+
+// Register { sink(ptr, length, offset, tag) } for downloads or
+// { source(ptr, maxLength, offset) } for uploads and return its id.
+// Sink views of HEAPU8 are only valid for the duration of the call. Tree
+// walk downloads also call the optional done(tag, status) per file.
+Module.registerSftpTransfer = function (transfer) {
+  return tableInsert(Module.sftpTransfers, transfer);
+};
+
+Module.unregisterSftpTransfer = function (id) {
+  if (id > 0) {
+    Module.sftpTransfers[id] = null;
+  }
+};
+
+// Packed SFTP attributes (ssh2_packed_attrs, 32 bytes): u32 flags,
+// u32 permissions, u64 filesize, u32 uid, gid, atime, mtime.
+var utf8Decoder = new TextDecoder();
+
+function decodePackedAttrs(ptr) {
+  var base = ptr >> 2;
+  return {
+    flags: HEAPU32[base],
+    permissions: HEAPU32[base + 1],
+    filesize: HEAPU32[base + 2] + HEAPU32[base + 3] * 4294967296,
+    uid: HEAPU32[base + 4],
+    gid: HEAPU32[base + 5],
+    atime: HEAPU32[base + 6],
+    mtime: HEAPU32[base + 7],
+  };
+}
+
+// Decode `count` entries written by ssh2_sftp_readdir_batch. Each record is
+// an ssh2_dirent: u32 length, u16 name length, u16 longentry length, packed
+// attributes, then the name and longentry bytes.
+Module.decodeDirEntries = function (buf, count) {
+  var entries = new Array(count);
+  var offset = buf;
+  for (var i = 0; i < count; i++) {
+    var length = HEAPU32[offset >> 2];
+    var nameLength = HEAPU16[(offset + 4) >> 1];
+    var longentryLength = HEAPU16[(offset + 6) >> 1];
+    var entry = decodePackedAttrs(offset + 8);
+    var strings = offset + 40;
+    entry.name = utf8Decoder.decode(HEAPU8.subarray(strings, strings + nameLength));
+    entry.longentry = longentryLength
+      ? utf8Decoder.decode(HEAPU8.subarray(strings + nameLength, strings + nameLength + longentryLength))
+      : '';
+    entries[i] = entry;
+    offset += length;
+  }
+  return entries;
+};
+
+// Pack manifest entries { path, filesize, mtime } for ssh2_sftp_walk_manifest:
+// u64 filesize, u32 mtime, u32 path length, then the UTF-8 path, padded to
+// 8 bytes. Returns { ptr, length }; free ptr once the walk has loaded it.
+var utf8Encoder = new TextEncoder();
+
+Module.packWalkManifest = function (entries) {
+  var paths = entries.map(function (entry) { return utf8Encoder.encode(entry.path); });
+  var length = 0;
+  paths.forEach(function (path) { length += (16 + path.length + 7) & ~7; });
+
+  var ptr = _malloc(length || 8);
+  HEAPU8.fill(0, ptr, ptr + length);
+  var offset = ptr;
+  entries.forEach(function (entry, i) {
+    var base = offset >> 2;
+    HEAPU32[base] = entry.filesize >>> 0;
+    HEAPU32[base + 1] = Math.floor(entry.filesize / 4294967296);
+    HEAPU32[base + 2] = entry.mtime;
+    HEAPU32[base + 3] = paths[i].length;
+    HEAPU8.set(paths[i], offset + 16);
+    offset += (16 + paths[i].length + 7) & ~7;
+  });
+  return { ptr: ptr, length: length };
+};
+
+// Decode `count` records from ssh2_sftp_walk_deltas. Each record is an ssh2_walk_delta:
+// u32 length, u8 kind, u8 is_dir, u16 path length, u32 permissions,
+// u32 mtime, u64 filesize, then the path bytes.
+Module.decodeWalkDeltas = function (buf, count) {
+  var offset = buf;
+  var deltas = new Array(count);
+  for (var i = 0; i < count; i++) {
+    var base = offset >> 2;
+    var pathLength = HEAPU16[(offset + 6) >> 1];
+    deltas[i] = {
+      kind: HEAPU8[offset + 4],
+      isDir: HEAPU8[offset + 5] !== 0,
+      path: utf8Decoder.decode(HEAPU8.subarray(offset + 24, offset + 24 + pathLength)),
+      permissions: HEAPU32[base + 2],
+      mtime: HEAPU32[base + 3],
+      filesize: HEAPU32[base + 4] + HEAPU32[base + 5] * 4294967296,
+    };
+    offset += HEAPU32[base];
+  }
+  return deltas;
+};
+
+// Cached stat/lstat (ssh2_sftp_stat_packed). Returns the attributes, or the
+// libssh2 error code (LIBSSH2_ERROR_EAGAIN: call again). Async builds return
+// a Promise of the same and queue the call behind `session`'s other calls.
+var STAT_ARGS = ['number', 'string', 'number', 'number'];
+var statBuffer = 0;
+
+function statResult(rc, buf) {
+  return rc === 0 ? decodePackedAttrs(buf) : rc;
+}
+
+Module.sftpStat = function (sftp, path, lstat, session) {
+#if ASYNCIFY
+  // Calls may overlap under JSPI, so each gets its own buffer
+  var buf = _malloc(32);
+  return Module.ssh2Async('ssh2_sftp_stat_packed', 'number', STAT_ARGS, [sftp, path, lstat ? 1 : 0, buf], session)
+    .then(function (rc) {
+      return statResult(rc, buf);
+    })
+    .finally(function () {
+      _free(buf);
+    });
+#else
+  if (!statBuffer) statBuffer = _malloc(32);
+  var rc = ccall('ssh2_sftp_stat_packed', 'number', STAT_ARGS, [sftp, path, lstat ? 1 : 0, statBuffer]);
+  return statResult(rc, statBuffer);
+#endif
+};
+
+// { entries, hits, misses } of the SFTP instance's metadata cache, null while off
+var cacheInfoBuffer = 0;
+
+Module.sftpCacheInfo = function (sftp) {
+  if (!cacheInfoBuffer) cacheInfoBuffer = _malloc(24);
+  if (ccall('ssh2_sftp_cache_info', 'number', ['number', 'number'], [sftp, cacheInfoBuffer]) !== 0) {
+    return null;
+  }
+  var base = cacheInfoBuffer >> 3;
+  return { entries: HEAPF64[base], hits: HEAPF64[base + 1], misses: HEAPF64[base + 2] };
+};
+
+// stat (or lstat with options.lstat) every path over a batch from
+// ssh2_sftp_batch_new, all requests in flight at once. Resolves to one
+// { status, ...attributes } per path in order; status is 0 or the server's
+// SSH_FX_* code. Waits on options.wait between EAGAINs; the fallback polls.
+// Async builds queue each attempt behind options.session's other calls.
+var BATCH_EAGAIN = -37;
+var STAT_RESULT = 40;
+var BATCH_ARGS = ['number', 'number', 'number', 'number', 'number'];
+
+Module.sftpStatBatch = function (batch, paths, options) {
+  options = options || {};
+  var encoded = paths.map(function (path) { return utf8Encoder.encode(path); });
+  var length = 0;
+  encoded.forEach(function (path) { length += path.length + 1; });
+
+  var names = _malloc(length || 1);
+  var results = _malloc(paths.length * STAT_RESULT || 8);
+  var offset = names;
+  encoded.forEach(function (path) {
+    HEAPU8.set(path, offset);
+    HEAPU8[offset + path.length] = 0;
+    offset += path.length + 1;
+  });
+  var args = [batch, names, paths.length, options.lstat ? 1 : 0, results];
+
+  function step(rc) {
+    if (rc === BATCH_EAGAIN) {
+      var wait = options.wait ? options.wait() : new Promise(function (resolve) { setTimeout(resolve, 0); });
+      return wait.then(call).then(step);
+    }
+    if (rc < 0) {
+      var error = new Error('SFTP batch stat failed (' + rc + ')');
+      error.code = rc;
+      throw error;
+    }
+
+    var out = new Array(paths.length);
+    for (var i = 0; i < paths.length; i++) {
+      var result = results + i * STAT_RESULT;
+      var status = HEAP32[result >> 2];
+      out[i] = status === 0 ? decodePackedAttrs(result + 8) : {};
+      out[i].status = status;
+    }
+    return out;
+  }
+
+  function call() {
+#if ASYNCIFY
+    return Module.ssh2Async('ssh2_sftp_batch_stat', 'number', BATCH_ARGS, args, options.session);
+#else
+    return ccall('ssh2_sftp_batch_stat', 'number', BATCH_ARGS, args);
+#endif
+  }
+
+  return Promise.resolve()
+    .then(call)
+    .then(step)
+    .finally(function () {
+      _free(names);
+      _free(results);
+    });
+};
@@ -0,0 +1,56 @@
+// Session counters (ssh2_stats in src/ssh2-internal.h): 16 doubles, in this
+// order. Times are milliseconds and stay 0 unless ssh2_session_stats_timing
+// is enabled.
+Module.SESSION_STATS_FIELDS = [
+  'bytesIn', 'bytesOut', 'packetsIn', 'packetsOut',
+  'recvCalls', 'sendCalls', 'recvEagain', 'sendEagain',
+  'kexCount', 'kexMs', 'codecMs', 'callbackMs', 'windowStalls',
+  'coalescedWrites', 'flushes', 'flushBytes',
+];
+
+var statsBuffer = 0;
+
+// Snapshot a session's counters into a Float64Array (indexed as
+// SESSION_STATS_FIELDS), reusing `into` when given.
+Module.readSessionStats = function (session, into) {
+  var count = Module.SESSION_STATS_FIELDS.length;
+  if (!statsBuffer) {
+    statsBuffer = _malloc(count * 8);
+  }
+  if (ccall('ssh2_session_stats', 'number', ['number', 'number'], [session, statsBuffer]) < 0) {
+    return null;
+  }
+  var view = into || new Float64Array(count);
+  view.set(HEAPF64.subarray(statsBuffer >> 3, (statsBuffer >> 3) + count));
+  return view;
+};
+
+// Same counters as a plain object keyed by SESSION_STATS_FIELDS
+Module.sessionStats = function (session) {
+  var view = Module.readSessionStats(session);
+  if (!view) return null;
+  var stats = {};
+  Module.SESSION_STATS_FIELDS.forEach(function (name, i) { stats[name] = view[i]; });
+  return stats;
+};
+
+// Memory counters (ssh2_heap_stats): 5 u32, for sessions created with
+// ssh2_session_create_ex. Returns null for sessions using the default malloc.
+var memoryBuffer = 0;
+
+Module.sessionMemory = function (session) {
+  if (!memoryBuffer) {
+    memoryBuffer = _malloc(20);
+  }
+  if (ccall('ssh2_session_memory', 'number', ['number', 'number'], [session, memoryBuffer]) < 0) {
+    return null;
+  }
+  var base = memoryBuffer >> 2;
+  return {
+    live: HEAPU32[base],
+    highWater: HEAPU32[base + 1],
+    reserved: HEAPU32[base + 2],
+    cap: HEAPU32[base + 3],
+    capFailures: HEAPU32[base + 4],
+  };
+};
@@ -0,0 +1,63 @@
+// Binary trace ring (src/ssh2-trace.c). Enabled per session with
+// ssh2_session_trace_ring; nothing is read from WASM memory until a dump.
+
+// Event types, indexed by ssh2_trace_event.type (SSH2_TRACE_* in
+// src/ssh2-internal.h)
+Module.TRACE_EVENTS = [
+  null, 'packetIn', 'packetOut', 'kexBegin', 'kexEnd',
+  'windowAdjust', 'windowStall', 'recvEagain', 'sendEagain', 'error',
+];
+
+var TRACE_HEADER = 24;
+var TRACE_EVENT = 24;
+
+// Copy the session's events out of the ring, oldest first. Returns
+// { recorded, dropped, events: Uint8Array } (24 bytes per event) for
+// decodeSessionTrace or for shipping elsewhere, or null while tracing is off.
+Module.dumpSessionTrace = function (session) {
+  var trace = ccall('ssh2_session_trace_buffer', 'number', ['number'], [session]);
+  if (!trace) return null;
+
+  var capacity = HEAPU32[trace >> 2];
+  var next = HEAPU32[(trace >> 2) + 1];
+  var recorded = HEAPF64[(trace >> 3) + 2];
+  var count = Math.min(recorded, capacity);
+  var base = trace + TRACE_HEADER;
+  var events = new Uint8Array(count * TRACE_EVENT);
+
+  // Once the ring has wrapped the oldest event sits at `next`
+  var first = recorded > capacity ? next : 0;
+  var head = Math.min(count, capacity - first);
+  events.set(HEAPU8.subarray(base + first * TRACE_EVENT, base + (first + head) * TRACE_EVENT));
+  if (head < count) {
+    events.set(HEAPU8.subarray(base, base + (count - head) * TRACE_EVENT), head * TRACE_EVENT);
+  }
+
+  return { recorded: recorded, dropped: recorded - count, events: events };
+};
+
+// Decode a dump into { time, type, detail, channel, bytes, code } objects.
+// time is performance.now() milliseconds; detail is the SSH message type for
+// packet events; channel is -1 when the event has none.
+Module.decodeSessionTrace = function (dump) {
+  var view = new DataView(dump.events.buffer, dump.events.byteOffset, dump.events.byteLength);
+  var out = [];
+  for (var offset = 0; offset < view.byteLength; offset += TRACE_EVENT) {
+    var type = view.getUint16(offset + 8, true);
+    out.push({
+      time: view.getFloat64(offset, true),
+      type: Module.TRACE_EVENTS[type] || type,
+      detail: view.getUint16(offset + 10, true),
+      channel: view.getInt32(offset + 12, true),
+      bytes: view.getUint32(offset + 16, true),
+      code: view.getInt32(offset + 20, true),
+    });
+  }
+  return out;
+};
+
+// Dump and decode in one step
+Module.sessionTrace = function (session) {
+  var dump = Module.dumpSessionTrace(session);
+  return dump ? Module.decodeSessionTrace(dump) : null;
+};
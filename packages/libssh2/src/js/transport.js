@@ -0,0 +1,147 @@
+// Ring transport helpers (see ssh2_ring in src/ssh2-internal.h).
+// Fields are u32: [0] data, [1] capacity, [2] head, [3] tail, [4] flags.
+// head/tail are free-running counters, so all arithmetic is done with >>> 0.
+
+var RING_DATA = 0;
+var RING_CAPACITY = 1;
+var RING_HEAD = 2;
+var RING_TAIL = 3;
+var RING_FLAGS = 4;
+var RING_CLOSED = 0x1;
+
+// Pending Module.ringWait() resolvers, keyed by ring pointer
+var ringWaiters = {};
+
+function ringWake(ring) {
+  var waiters = ringWaiters[ring];
+  if (waiters) {
+    delete ringWaiters[ring];
+    waiters.forEach(function (resolve) { resolve(); });
+  }
+}
+
+// Copy as much of `bytes` as fits into the ring, returns the number written.
+Module.ringWrite = function (ring, bytes) {
+  var base = ring >> 2;
+  var data = HEAPU32[base + RING_DATA];
+  var capacity = HEAPU32[base + RING_CAPACITY];
+  var head = HEAPU32[base + RING_HEAD];
+  var tail = HEAPU32[base + RING_TAIL];
+
+  var space = capacity - ((head - tail) >>> 0);
+  var len = Math.min(bytes.length, space);
+  if (len === 0) return 0;
+
+  var offset = head & (capacity - 1);
+  var first = Math.min(len, capacity - offset);
+  HEAPU8.set(bytes.subarray(0, first), data + offset);
+  if (len > first) {
+    HEAPU8.set(bytes.subarray(first, len), data);
+  }
+  HEAPU32[base + RING_HEAD] = (head + len) >>> 0;
+  ringWake(ring);
+  return len;
+};
+
+// Hand every readable region to `consume` as a HEAPU8 view, then release it.
+// The views are only valid for the duration of the call.
+Module.ringDrain = function (ring, consume) {
+  var base = ring >> 2;
+  var data = HEAPU32[base + RING_DATA];
+  var capacity = HEAPU32[base + RING_CAPACITY];
+  var head = HEAPU32[base + RING_HEAD];
+  var tail = HEAPU32[base + RING_TAIL];
+
+  var used = (head - tail) >>> 0;
+  if (used === 0) return 0;
+
+  var offset = tail & (capacity - 1);
+  var first = Math.min(used, capacity - offset);
+  consume(HEAPU8.subarray(data + offset, data + offset + first));
+  if (used > first) {
+    consume(HEAPU8.subarray(data, data + used - first));
+  }
+  HEAPU32[base + RING_TAIL] = head;
+  ringWake(ring);
+  return used;
+};
+
+// Bytes currently queued in the ring.
+Module.ringUsed = function (ring) {
+  var base = ring >> 2;
+  return (HEAPU32[base + RING_HEAD] - HEAPU32[base + RING_TAIL]) >>> 0;
+};
+
+// Mark the ring closed: readers see EOF once it is drained, writers fail.
+Module.ringClose = function (ring) {
+  HEAPU32[(ring >> 2) + RING_FLAGS] |= RING_CLOSED;
+  ringWake(ring);
+};
+
+// Resolve the next time the ring is written, drained or closed. Async
+// builds suspend libssh2 on this instead of returning EAGAIN.
+Module.ringWait = function (ring) {
+  return new Promise(function (resolve) {
+    (ringWaiters[ring] = ringWaiters[ring] || []).push(resolve);
+  });
+};
+
+// Store value in the first free slot after 0 and return its index.
+function tableInsert(table, value) {
+  for (var index = 1; index < table.length; index++) {
+    if (!table[index]) break;
+  }
+  table[index] = value;
+  return index;
+}
+
+// Per-session transports, indexed by the handle passed to ssh2_session_create.
+// Slot 0 is reserved for the module-wide customSend/customRecv/onTransmit.
+Module.transports = [null];
+
+// Register { send(buf, len), recv(buf, len), transmit(session, txRing) } and
+// return its handle. Callback sessions use send/recv, ring sessions transmit.
+Module.registerTransport = function (transport) {
+  return tableInsert(Module.transports, transport);
+};
+
+// Release a handle. ssh2_session_free does this for the session's handle.
+Module.unregisterTransport = function (handle) {
+  if (handle > 0) {
+    Module.transports[handle] = null;
+  }
+};
+
+// Sessions whose coalesced transmit bytes await their end-of-task flush
+// (ssh2_session_coalesce), and those waiting out transport backpressure
+var pendingFlushes = new Set();
+var retryFlushes = new Set();
+var FLUSH_EAGAIN = -37;
+
+function flushPending() {
+  var sessions = Array.from(pendingFlushes);
+  pendingFlushes.clear();
+  sessions.forEach(function (session) {
+    var rc = ccall('ssh2_session_flush', 'number', ['number'], [session]);
+    if (rc === FLUSH_EAGAIN && !retryFlushes.has(session)) {
+      // Retry on a later task rather than spin in microtasks
+      retryFlushes.add(session);
+      setTimeout(function () {
+        if (retryFlushes.delete(session)) Module.scheduleFlush(session);
+      }, 0);
+    }
+  });
+}
+
+// Called from C when a coalescing session buffers its first bytes: flush
+// once the libssh2 calls of the current task have returned
+Module.scheduleFlush = function (session) {
+  if (!pendingFlushes.size) queueMicrotask(flushPending);
+  pendingFlushes.add(session);
+};
+
+// Called from C when the session is freed
+Module.cancelFlush = function (session) {
+  pendingFlushes.delete(session);
+  retryFlushes.delete(session);
+};
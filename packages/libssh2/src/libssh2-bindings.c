@@ -1,10 +1,13 @@
 #include <libssh2.h>
 #include <libssh2_sftp.h>
 #include <emscripten.h>
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ssh2-internal.h"
+
 // =====================================
 // Core Library Functions
 // =====================================
@@ -33,36 +36,65 @@ const char* ssh2_version() {
 
 EMSCRIPTEN_KEEPALIVE
 int custom_send(libssh2_socket_t socket, const void *buffer, size_t length, int flags, void **abstract) {
-    // Since we only support one session per WebSocket, we don't need socket/flags/abstract
-    return EM_ASM_INT({
+    // Module.customSend path for sessions with no registered transport: handle 0
+    // from ssh2_session_create, or ssh2_session_callback_set_custom
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    if (ctx && ctx->coalesce) return (int)ssh2_coalesce_write(ctx, buffer, length);
+    double start = ctx && ctx->timing ? emscripten_get_now() : 0;
+    int rc = EM_ASM_INT({
       return Module.customSend($0, $1);
     }, (int)buffer, (int)length);
+    if (ctx) ssh2_stats_send(ctx, rc, start);
+    return rc;
 }
 
 EMSCRIPTEN_KEEPALIVE
 int custom_recv(libssh2_socket_t socket, void *buffer, size_t length, int flags, void **abstract) {
-    // Since we only support one session per WebSocket, we don't need socket/flags/abstract
-    return EM_ASM_INT({
+    // Module.customRecv path for sessions with no registered transport: handle 0
+    // from ssh2_session_create, or ssh2_session_callback_set_custom
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    if (ctx && ctx->coalesce) {
+        int flushed = ssh2_coalesce_flush(ctx);
+        if (flushed < 0 && flushed != -EAGAIN) return flushed;
+    }
+    double start = ctx && ctx->timing ? emscripten_get_now() : 0;
+#ifdef SSH2_ASYNC
+    int rc = (int)ssh2_async_recv(ctx, 0, buffer, length);
+#else
+    int rc = EM_ASM_INT({
       return Module.customRecv($0, $1);
     }, (int)buffer, (int)length);
+#endif
+    if (ctx) ssh2_stats_recv(ctx, rc, start);
+    return rc;
 }
 
 // =====================================
 // Session Management
 // =====================================
 
-// Create new session
+// Create new session (transport callbacks are set with ssh2_session_callback_set_custom)
 EMSCRIPTEN_KEEPALIVE
 LIBSSH2_SESSION* ssh2_session_init() {
-    return libssh2_session_init();
+    ssh2_session_ctx* ctx = ssh2_session_ctx_new(0, SSH2_TRANSPORT_CALLBACK, 0, 0);
+    if (!ctx) return NULL;
+
+    ctx->session = libssh2_session_init_ex(NULL, NULL, NULL, ctx);
+    if (!ctx->session) {
+        ssh2_session_ctx_free(ctx);
+        return NULL;
+    }
+    return ctx->session;
 }
 
 // Free session
 EMSCRIPTEN_KEEPALIVE
 void ssh2_session_free(LIBSSH2_SESSION* session) {
     if (session) {
+        ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
         libssh2_session_disconnect(session, "Normal shutdown");
         libssh2_session_free(session);
+        ssh2_session_ctx_free(ctx);
     }
 }
 
@@ -121,6 +153,65 @@ char* ssh2_session_last_error(LIBSSH2_SESSION* session) {
     return errmsg;
 }
 
+// Server host key blob (owned by the session), with its length and
+// LIBSSH2_HOSTKEY_TYPE_* written to out[0] and out[1]
+EMSCRIPTEN_KEEPALIVE
+const char* ssh2_session_hostkey(LIBSSH2_SESSION* session, int* out) {
+    size_t length = 0;
+    int type = LIBSSH2_HOSTKEY_TYPE_UNKNOWN;
+    const char* key = libssh2_session_hostkey(session, &length, &type);
+    if (out) {
+        out[0] = key ? (int)length : 0;
+        out[1] = type;
+    }
+    return key;
+}
+
+// Set the comma-separated preference list for one LIBSSH2_METHOD_* type
+// (KEX, host key, ciphers, MACs, compression). Call before the handshake.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_method_pref(LIBSSH2_SESSION* session, int method_type, const char* prefs) {
+    return libssh2_session_method_pref(session, method_type, prefs);
+}
+
+// Algorithm negotiated for a LIBSSH2_METHOD_* type, NULL before the handshake
+EMSCRIPTEN_KEEPALIVE
+const char* ssh2_session_methods(LIBSSH2_SESSION* session, int method_type) {
+    return libssh2_session_methods(session, method_type);
+}
+
+// Comma-separated algorithms this build supports for a LIBSSH2_METHOD_* type.
+// The caller frees the string with _free; NULL on error.
+EMSCRIPTEN_KEEPALIVE
+char* ssh2_session_supported_algs(LIBSSH2_SESSION* session, int method_type) {
+    const char** algs = NULL;
+    int count = libssh2_session_supported_algs(session, method_type, &algs);
+    if (count < 0) return NULL;
+
+    size_t length = 1;
+    for (int i = 0; i < count; i++) {
+        length += strlen(algs[i]) + 1;
+    }
+
+    char* list = malloc(length);
+    if (list) {
+        list[0] = '\0';
+        for (int i = 0; i < count; i++) {
+            if (i) strcat(list, ",");
+            strcat(list, algs[i]);
+        }
+    }
+    if (algs) libssh2_free(session, algs);
+    return list;
+}
+
+// Set a LIBSSH2_FLAG_* option, e.g. LIBSSH2_FLAG_COMPRESS to offer zlib
+// compression (before the handshake)
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_flag(LIBSSH2_SESSION* session, int flag, int value) {
+    return libssh2_session_flag(session, flag, value);
+}
+
 // Set session timeout
 EMSCRIPTEN_KEEPALIVE
 void ssh2_session_set_timeout(LIBSSH2_SESSION* session, long timeout) {
@@ -193,8 +284,44 @@ LIBSSH2_CHANNEL* ssh2_channel_open_session(LIBSSH2_SESSION* session) {
 
 // Open direct TCP/IP channel
 EMSCRIPTEN_KEEPALIVE
-LIBSSH2_CHANNEL* ssh2_channel_direct_tcpip(LIBSSH2_SESSION* session, const char* host, int port) {
-    return libssh2_channel_direct_tcpip(session, host, port);
+LIBSSH2_CHANNEL* ssh2_channel_direct_tcpip(LIBSSH2_SESSION* session, const char* host, int port,
+                                           const char* shost, int sport) {
+    // Same defaults as libssh2_channel_direct_tcpip when no origin is given
+    return libssh2_channel_direct_tcpip_ex(session, host, port,
+                                           shost && *shost ? shost : "127.0.0.1", sport ? sport : 22);
+}
+
+// Open a channel of any type ("session", ...) with an explicit receive window
+// and maximum packet size; 0 selects libssh2's default (2 MiB / 32 KiB). The
+// window caps throughput at window / RTT.
+EMSCRIPTEN_KEEPALIVE
+LIBSSH2_CHANNEL* ssh2_channel_open_ex(LIBSSH2_SESSION* session, const char* type,
+                                      unsigned int window_size, unsigned int packet_size) {
+    return libssh2_channel_open_ex(session, type, (unsigned int)strlen(type),
+                                   window_size ? window_size : LIBSSH2_CHANNEL_WINDOW_DEFAULT,
+                                   packet_size ? packet_size : LIBSSH2_CHANNEL_PACKET_DEFAULT,
+                                   NULL, 0);
+}
+
+// Grant the server `adjustment` more bytes of receive window. Without force,
+// adjustments below 1 KiB are queued until they add up. Returns 0 or a
+// libssh2 error.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_receive_window_adjust(LIBSSH2_CHANNEL* channel, unsigned int adjustment, int force) {
+    unsigned int window = 0;
+    return libssh2_channel_receive_window_adjust2(channel, adjustment, (unsigned char)(force != 0), &window);
+}
+
+// Bytes the server may still send before waiting for a window adjust
+EMSCRIPTEN_KEEPALIVE
+unsigned int ssh2_channel_window_read(LIBSSH2_CHANNEL* channel) {
+    return (unsigned int)libssh2_channel_window_read_ex(channel, NULL, NULL);
+}
+
+// Bytes we may still send before the server adjusts its window
+EMSCRIPTEN_KEEPALIVE
+unsigned int ssh2_channel_window_write(LIBSSH2_CHANNEL* channel) {
+    return (unsigned int)libssh2_channel_window_write_ex(channel, NULL);
 }
 
 // Free channel
@@ -229,12 +356,28 @@ int ssh2_channel_send_eof(LIBSSH2_CHANNEL* channel) {
     return libssh2_channel_send_eof(channel);
 }
 
+// How stderr is delivered: LIBSSH2_CHANNEL_EXTENDED_DATA_NORMAL (0, separate
+// stream), _IGNORE (1, discarded so it never holds the window) or _MERGE (2,
+// read as stdout)
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_handle_extended_data(LIBSSH2_CHANNEL* channel, int mode) {
+    return libssh2_channel_handle_extended_data2(channel, mode);
+}
+
 // Request PTY
 EMSCRIPTEN_KEEPALIVE
 int ssh2_channel_request_pty(LIBSSH2_CHANNEL* channel, const char* term) {
     return libssh2_channel_request_pty(channel, term);
 }
 
+// Request PTY with an initial size in characters (pty-req); later resizes
+// go through ssh2_channel_request_pty_size (window-change)
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_request_pty_ex(LIBSSH2_CHANNEL* channel, const char* term, int width, int height) {
+    return libssh2_channel_request_pty_ex(channel, term, (unsigned int)strlen(term), NULL, 0,
+                                          width, height, 0, 0);
+}
+
 // Request PTY with size (using the actual API call)
 EMSCRIPTEN_KEEPALIVE
 int ssh2_channel_request_pty_size(LIBSSH2_CHANNEL* channel, int width, int height,
@@ -331,7 +474,9 @@ LIBSSH2_SFTP* ssh2_sftp_init(LIBSSH2_SESSION* session) {
 // Shutdown SFTP
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_shutdown(LIBSSH2_SFTP* sftp) {
-    return libssh2_sftp_shutdown(sftp);
+    int rc = libssh2_sftp_shutdown(sftp);
+    if (rc != LIBSSH2_ERROR_EAGAIN) ssh2_sftp_cache_drop(sftp);
+    return rc;
 }
 
 // Get SFTP last error
@@ -356,6 +501,7 @@ LIBSSH2_SFTP_HANDLE* ssh2_sftp_opendir(LIBSSH2_SFTP* sftp, const char* path) {
 // Close handle
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_close_handle(LIBSSH2_SFTP_HANDLE* handle) {
+    ssh2_sftp_dir_forget(handle);
     return libssh2_sftp_close_handle(handle);
 }
 
@@ -391,61 +537,86 @@ libssh2_uint64_t ssh2_sftp_tell64(LIBSSH2_SFTP_HANDLE* handle) {
     return libssh2_sftp_tell64(handle);
 }
 
-// Get file attributes
+// Get file attributes (served from the metadata cache when enabled)
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_stat(LIBSSH2_SFTP* sftp, const char* path, LIBSSH2_SFTP_ATTRIBUTES* attrs) {
-    return libssh2_sftp_stat(sftp, path, attrs);
+    return ssh2_sftp_cached_stat(sftp, path, LIBSSH2_SFTP_STAT, attrs);
+}
+
+// Get file attributes without following a final symlink
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_lstat(LIBSSH2_SFTP* sftp, const char* path, LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    return ssh2_sftp_cached_stat(sftp, path, LIBSSH2_SFTP_LSTAT, attrs);
 }
 
+// Mutations below drop the affected metadata cache entries once the
+// request has completed, successfully or not
+
 // Set file attributes
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_setstat(LIBSSH2_SFTP* sftp, const char* path, LIBSSH2_SFTP_ATTRIBUTES* attrs) {
-    return libssh2_sftp_setstat(sftp, path, attrs);
+    int rc = libssh2_sftp_setstat(sftp, path, attrs);
+    if (rc != LIBSSH2_ERROR_EAGAIN) ssh2_sftp_cache_invalidate(sftp, path);
+    return rc;
 }
 
 // Create directory
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_mkdir(LIBSSH2_SFTP* sftp, const char* path, long mode) {
-    return libssh2_sftp_mkdir(sftp, path, mode);
+    int rc = libssh2_sftp_mkdir(sftp, path, mode);
+    if (rc != LIBSSH2_ERROR_EAGAIN) ssh2_sftp_cache_invalidate(sftp, path);
+    return rc;
 }
 
 // Remove directory
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_rmdir(LIBSSH2_SFTP* sftp, const char* path) {
-    return libssh2_sftp_rmdir(sftp, path);
+    int rc = libssh2_sftp_rmdir(sftp, path);
+    if (rc != LIBSSH2_ERROR_EAGAIN) ssh2_sftp_cache_invalidate(sftp, path);
+    return rc;
 }
 
 // Remove file
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_unlink(LIBSSH2_SFTP* sftp, const char* filename) {
-    return libssh2_sftp_unlink(sftp, filename);
+    int rc = libssh2_sftp_unlink(sftp, filename);
+    if (rc != LIBSSH2_ERROR_EAGAIN) ssh2_sftp_cache_invalidate(sftp, filename);
+    return rc;
 }
 
 // Rename file
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_rename(LIBSSH2_SFTP* sftp, const char* source_filename,
                     const char* dest_filename) {
-    return libssh2_sftp_rename(sftp, source_filename, dest_filename);
+    int rc = libssh2_sftp_rename(sftp, source_filename, dest_filename);
+    if (rc != LIBSSH2_ERROR_EAGAIN) {
+        ssh2_sftp_cache_invalidate(sftp, source_filename);
+        ssh2_sftp_cache_invalidate(sftp, dest_filename);
+    }
+    return rc;
 }
 
 // Create symlink
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_symlink(LIBSSH2_SFTP* sftp, const char* path, char* target) {
-    return libssh2_sftp_symlink(sftp, path, target);
+    // libssh2 sends `path` as the link target and `target` as the new link
+    int rc = libssh2_sftp_symlink(sftp, path, target);
+    if (rc != LIBSSH2_ERROR_EAGAIN) ssh2_sftp_cache_invalidate(sftp, target);
+    return rc;
 }
 
 // Read symlink
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_readlink(LIBSSH2_SFTP* sftp, const char* path, char* target,
                       unsigned int maxlen) {
-    return libssh2_sftp_readlink(sftp, path, target, maxlen);
+    return ssh2_sftp_cached_link(sftp, path, target, maxlen, LIBSSH2_SFTP_READLINK);
 }
 
 // Get real path
 EMSCRIPTEN_KEEPALIVE
 int ssh2_sftp_realpath(LIBSSH2_SFTP* sftp, const char* path, char* target,
                       unsigned int maxlen) {
-    return libssh2_sftp_realpath(sftp, path, target, maxlen);
+    return ssh2_sftp_cached_link(sftp, path, target, maxlen, LIBSSH2_SFTP_REALPATH);
 }
 
 // =====================================
@@ -477,6 +648,15 @@ LIBSSH2_LISTENER* ssh2_channel_forward_listen(LIBSSH2_SESSION* session, int port
     return libssh2_channel_forward_listen_ex(session, NULL, port, &bound_port, 16);
 }
 
+// Listen on host:port (NULL host for all interfaces, port 0 lets the server
+// pick) with a backlog of queue_maxsize; the port actually bound is
+// written to bound_port
+EMSCRIPTEN_KEEPALIVE
+LIBSSH2_LISTENER* ssh2_channel_forward_listen_ex(LIBSSH2_SESSION* session, const char* host, int port,
+                                                 int* bound_port, int queue_maxsize) {
+    return libssh2_channel_forward_listen_ex(session, host, port, bound_port, queue_maxsize);
+}
+
 // Accept forwarded connection
 EMSCRIPTEN_KEEPALIVE
 LIBSSH2_CHANNEL* ssh2_channel_forward_accept(LIBSSH2_LISTENER* listener) {
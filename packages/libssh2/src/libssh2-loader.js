@@ -0,0 +1,61 @@
+// Load the fastest libssh2 build the runtime supports.
+//
+// dist/libssh2-simd.wasm needs WebAssembly SIMD (Chrome 91, Firefox 89,
+// Safari 16.4, Node 16.4). Runtimes without it fail to compile that module,
+// so detection validates a tiny module using one SIMD opcode first. The SIMD
+// build is linked for browsers only; Node and workers get their own glue.
+
+// (func (result v128) i32.const 0 i8x16.splat i8x16.popcnt)
+const SIMD_PROBE = new Uint8Array([
+  0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253,
+  98, 11,
+]);
+
+let simdSupported;
+
+export function hasSimd() {
+  if (simdSupported === undefined) {
+    try {
+      simdSupported = typeof WebAssembly === "object" && WebAssembly.validate(SIMD_PROBE);
+    } catch {
+      simdSupported = false;
+    }
+  }
+  return simdSupported;
+}
+
+// Which Emscripten glue the runtime needs ("web", "worker" or "node")
+export function detectEnvironment() {
+  if (typeof process === "object" && process.versions?.node) return "node";
+  if (typeof WorkerGlobalScope === "function" && self instanceof WorkerGlobalScope) return "worker";
+  return "web";
+}
+
+// Resolve to the module factory for this runtime. Pass { simd: false } to
+// force the baseline build, or { environment } to override detection.
+export async function loadFactory(options = {}) {
+  const environment = options.environment ?? detectEnvironment();
+  const simd = options.simd ?? hasSimd();
+
+  if (simd && environment === "web") {
+    try {
+      return (await import("./libssh2-simd.js")).default;
+    } catch {
+      // Installed without the SIMD build; the baseline one is always there
+    }
+  }
+
+  const module =
+    environment === "node"
+      ? await import("./libssh2-node.js")
+      : environment === "worker"
+        ? await import("./libssh2-worker.js")
+        : await import("./libssh2.js");
+  return module.default;
+}
+
+// Instantiate the selected build with the usual module options.
+export default async function createLibSSH2Module(options) {
+  const factory = await loadFactory();
+  return factory(options);
+}
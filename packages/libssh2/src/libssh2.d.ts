@@ -6,6 +6,17 @@ declare module '@verdigris/libssh2.js' {
   export type LIBSSH2_SFTP_HANDLE = number;
   export type LIBSSH2_LISTENER = number;
   export type LIBSSH2_KNOWNHOSTS = number;
+  export type SSH2_SFTP_TRANSFER = number;
+  export type SSH2_SFTP_WALK = number;
+  export type SSH2_SFTP_BATCH = number;
+  export type SSH2_EXEC_POOL = number;
+  export type SSH2_CHUNK_POOL = number;
+  export type SSH2_SCP_TRANSFER = number;
+  export type SSH2_FORWARDER = number;
+  export type SSH2_KEY = number;
+
+  // Pointer to an ssh2_ring (u32 fields: data, capacity, head, tail, flags)
+  export type SSH2_RING = number;
 
   // libssh2 error codes
   export enum LIBSSH2_ERROR {
@@ -64,6 +75,85 @@ declare module '@verdigris/libssh2.js' {
   export type SendCallback = (bufPtr: number, length: number) => number;
   export type RecvCallback = (bufPtr: number, length: number) => number;
 
+  // In async builds recv may instead resolve once data has been copied in.
+  // wait is false for non-blocking sessions (and the pump or batch reads):
+  // then return synchronously, the bytes already buffered or -EAGAIN (-6).
+  export type AsyncRecvCallback = (bufPtr: number, length: number, wait: boolean) => number | Promise<number>;
+
+  // Called when a ring session's TX ring goes from empty to non-empty.
+  // Drain it (ideally from a microtask, so writes made in the same call
+  // are coalesced) with ringDrain().
+  export type TransmitCallback = (session: LIBSSH2_SESSION, txRing: SSH2_RING) => void;
+
+  // Transport modes for ssh2_session_create
+  export const SSH2_TRANSPORT_CALLBACK = 0;
+  export const SSH2_TRANSPORT_RING = 1;
+
+  // Per-session transport registered with registerTransport(). Callback
+  // sessions use send/recv; ring sessions use transmit.
+  export interface SessionTransport {
+    send?: SendCallback;
+    recv?: RecvCallback | AsyncRecvCallback;
+    transmit?: TransmitCallback;
+  }
+
+  // ssh2_session_pump event flags
+  export const SSH2_EVENT_READABLE = 0x01;
+  export const SSH2_EVENT_STDERR = 0x02;
+  export const SSH2_EVENT_WRITABLE = 0x04;
+  export const SSH2_EVENT_EOF = 0x08;
+  export const SSH2_EVENT_CLOSED = 0x10;
+  export const SSH2_EVENT_EXIT_STATUS = 0x20;
+
+  // Forwarder event kinds (see registerForwarder)
+  export const SSH2_FORWARD_OPEN = 1;
+  export const SSH2_FORWARD_DATA = 2;
+  export const SSH2_FORWARD_CLOSE = 3;
+  export const SSH2_FORWARD_ERROR = 4;
+
+  // Size of one ssh2_session_pump record: i32 id, flags, exit_status, write_window
+  export const SSH2_EVENT_SIZE = 16;
+
+  // ssh2_knownhost_check results
+  export const LIBSSH2_KNOWNHOST_CHECK_MATCH = 0;
+  export const LIBSSH2_KNOWNHOST_CHECK_MISMATCH = 1;
+  export const LIBSSH2_KNOWNHOST_CHECK_NOTFOUND = 2;
+  export const LIBSSH2_KNOWNHOST_CHECK_FAILURE = 3;
+
+  // ssh2_session_method_pref / ssh2_session_methods method types
+  export const LIBSSH2_METHOD_KEX = 0;
+  export const LIBSSH2_METHOD_HOSTKEY = 1;
+  export const LIBSSH2_METHOD_CRYPT_CS = 2;
+  export const LIBSSH2_METHOD_CRYPT_SC = 3;
+  export const LIBSSH2_METHOD_MAC_CS = 4;
+  export const LIBSSH2_METHOD_MAC_SC = 5;
+  export const LIBSSH2_METHOD_COMP_CS = 6;
+  export const LIBSSH2_METHOD_COMP_SC = 7;
+  export const LIBSSH2_METHOD_LANG_CS = 8;
+  export const LIBSSH2_METHOD_LANG_SC = 9;
+  export const LIBSSH2_METHOD_SIGN_ALGO = 10;
+
+  // ssh2_session_flag flags
+  export const LIBSSH2_FLAG_SIGPIPE = 1;
+  export const LIBSSH2_FLAG_COMPRESS = 2;
+  export const LIBSSH2_FLAG_QUOTE_PATHS = 3;
+
+  // Size of the ssh2_exec_result filled in by ssh2_exec_pool_next
+  export const SSH2_EXEC_RESULT_SIZE = 32;
+
+  // One completed command from an exec pool; stdout/stderr alias HEAPU8
+  // until ssh2_exec_pool_release
+  export interface ExecResult {
+    job: number;
+    // libssh2 error that ended the command, 0 if it ran to completion
+    error: number;
+    exitStatus: number;
+    truncated: boolean;
+    signaled: boolean;
+    stdout: Uint8Array;
+    stderr: Uint8Array;
+  }
+
   // Callback type constants for ssh2_session_callback_set_custom
   export const LIBSSH2_CALLBACK_SEND = 5;
   export const LIBSSH2_CALLBACK_RECV = 6;
@@ -83,7 +173,8 @@ declare module '@verdigris/libssh2.js' {
 
     // Custom transport functions
     customSend?: SendCallback;
-    customRecv?: RecvCallback;
+    customRecv?: RecvCallback | AsyncRecvCallback;
+    onTransmit?: TransmitCallback;
 
     // File system
     preRun?: Array<(module: LibSSH2Module) => void>;
@@ -144,6 +235,150 @@ declare module '@verdigris/libssh2.js' {
     mtime: number;
   }
 
+  // Entry decoded from an ssh2_sftp_readdir_batch buffer
+  export interface SftpDirEntry extends SftpAttributes {
+    name: string;
+    longentry: string;
+  }
+
+  // One sftpStatBatch result: status is 0 or the server's SSH_FX_* code,
+  // attributes are only present for 0
+  export interface SftpStatResult extends Partial<SftpAttributes> {
+    status: number;
+  }
+
+  // Session counters decoded by sessionStats (times in ms, 0 unless timing is enabled)
+  export interface SessionStats {
+    bytesIn: number;
+    bytesOut: number;
+    packetsIn: number;
+    packetsOut: number;
+    recvCalls: number;
+    sendCalls: number;
+    recvEagain: number;
+    sendEagain: number;
+    kexCount: number;
+    kexMs: number;
+    codecMs: number;
+    callbackMs: number;
+    windowStalls: number;
+    // Transmit coalescing (ssh2_session_coalesce); sendCalls counts the frames
+    coalescedWrites: number;
+    flushes: number;
+    flushBytes: number;
+  }
+
+  // Raw events copied out of a session's trace ring, 24 bytes each, oldest first
+  export interface SessionTraceDump {
+    recorded: number;
+    dropped: number;
+    events: Uint8Array;
+  }
+
+  // One decoded trace event (time in performance.now() ms, channel -1 when none)
+  export interface SessionTraceEvent {
+    time: number;
+    type: 'packetIn' | 'packetOut' | 'kexBegin' | 'kexEnd' | 'windowAdjust' |
+      'windowStall' | 'recvEagain' | 'sendEagain' | 'error' | number;
+    detail: number;
+    channel: number;
+    bytes: number;
+    code: number;
+  }
+
+  // Pooled session heap counters (bytes) decoded by sessionMemory
+  export interface SessionMemory {
+    live: number;
+    highWater: number;
+    reserved: number;
+    // 0 when uncapped
+    cap: number;
+    capFailures: number;
+  }
+
+  // Tree walk delta kinds
+  export const SSH2_DELTA_NEW = 1;
+  export const SSH2_DELTA_CHANGED = 2;
+  export const SSH2_DELTA_DELETED = 3;
+  // Manifest entry below a directory the walk could not list (keep it)
+  export const SSH2_DELTA_UNKNOWN = 4;
+  // ssh2_sftp_walk_delta_status of a delta that was not downloaded
+  export const SSH2_WALK_NOT_DOWNLOADED = 1;
+
+  // Entry decoded from an ssh2_sftp_walk delta list (path relative to the root)
+  export interface SftpWalkDelta {
+    kind: number;
+    isDir: boolean;
+    path: string;
+    permissions: number;
+    mtime: number;
+    filesize: number;
+  }
+
+  // What the caller already has locally, compared against the remote tree
+  export interface SftpManifestEntry {
+    path: string;
+    filesize: number;
+    mtime: number;
+  }
+
+  // SFTP transfer callbacks (see registerSftpTransfer)
+  export interface SftpTransferSink {
+    // tag is the delta index for downloads started by a tree walk, -1 otherwise
+    sink(bufPtr: number, length: number, offset: number, tag: number): void;
+    // Tree walk downloads: delta finished (status 0) or failed (libssh2 error)
+    done?(tag: number, status: number): void;
+  }
+
+  export interface SftpTransferSource {
+    // Bytes written to bufPtr, 0 at end of input, -1 if nothing is ready yet
+    source(bufPtr: number, maxLength: number, offset: number): number;
+  }
+
+  // SCP transfer callbacks (see registerScpTransfer). The sink owns each
+  // chunk until it passes it to ssh2_chunk_release.
+  export interface ScpTransferSink {
+    open?(size: number, mode: number, mtime: number): void;
+    sink(chunkPtr: number, length: number, offset: number): void;
+  }
+
+  export interface ScpTransferSource {
+    // Bytes written to bufPtr, 0 at end of input, -1 if nothing is ready yet
+    source(bufPtr: number, maxLength: number, offset: number): number;
+  }
+
+  export interface ScpStreamOptions {
+    // Chunk pool from ssh2_chunk_pool_new (default: the stream's own 8 x 64 KiB pool)
+    pool?: SSH2_CHUNK_POOL;
+    // Resolves when the transport may have new data (default: polls with setTimeout)
+    wait?: () => Promise<void>;
+  }
+
+  export interface ScpReadOptions extends ScpStreamOptions {
+    onOpen?(info: { size: number; mode: number; mtime: number }): void;
+  }
+
+  export interface ScpWriteOptions extends ScpStreamOptions {
+    // Permission bits, default 0o644
+    mode?: number;
+    mtime?: number;
+    atime?: number;
+  }
+
+  export interface ChannelStreamOptions {
+    // Resolves when the transport has new data or the TX ring drained (default: polls with setTimeout)
+    wait?: () => Promise<void>;
+    // Heap buffer size of each direction, default 32 KiB
+    chunkSize?: number;
+    // stderr as its own stream (default), merged into readable, or discarded
+    stderr?: 'separate' | 'merge' | 'ignore';
+  }
+
+  // Receives forwarder events for every connection of one forwarder
+  export interface ForwarderTarget {
+    event(conn: number, kind: number, a: number, b: number): void;
+  }
+
   // Main module interface
   export interface LibSSH2Module {
     // Memory management
@@ -178,6 +413,130 @@ declare module '@verdigris/libssh2.js' {
     // Custom transport functions (set by user)
     customSend?: SendCallback;
     customRecv?: RecvCallback;
+    onTransmit?: TransmitCallback;
+
+    // Per-session transports (slot 0 is the module-wide hooks above)
+    transports: Array<SessionTransport | null>;
+    registerTransport(transport: SessionTransport): number;
+    unregisterTransport(handle: number): void;
+
+    // Ring transport helpers
+    ringWrite(ring: SSH2_RING, bytes: Uint8Array): number;
+    ringDrain(ring: SSH2_RING, consume: (view: Uint8Array) => void): number;
+    ringUsed(ring: SSH2_RING): number;
+    ringClose(ring: SSH2_RING): void;
+    ringWait(ring: SSH2_RING): Promise<void>;
+
+    // SFTP transfer sinks/sources, indexed by the id given to ssh2_sftp_get_file/put_file
+    sftpTransfers: Array<SftpTransferSink | SftpTransferSource | null>;
+    registerSftpTransfer(transfer: SftpTransferSink | SftpTransferSource): number;
+    unregisterSftpTransfer(id: number): void;
+
+    // SCP transfer callbacks, indexed by the id given to ssh2_scp_get/put
+    scpTransfers: Array<ScpTransferSink | ScpTransferSource | null>;
+    registerScpTransfer(transfer: ScpTransferSink | ScpTransferSource): number;
+    unregisterScpTransfer(id: number): void;
+
+    // Forwarder event targets, indexed by the id given to ssh2_forward_new
+    forwarders: Array<ForwarderTarget | null>;
+    registerForwarder(forwarder: ForwarderTarget): number;
+    unregisterForwarder(id: number): void;
+
+    // Streaming SCP over pooled heap chunks; the read side supports BYOB readers
+    scpReadableStream(session: LIBSSH2_SESSION, path: string, options?: ScpReadOptions): ReadableStream<Uint8Array>;
+    scpWritableStream(
+      session: LIBSSH2_SESSION,
+      path: string,
+      size: number,
+      options?: ScpWriteOptions
+    ): WritableStream<ArrayBufferView | ArrayBuffer>;
+    // Node builds only: stream.Readable / stream.Writable via fromWeb
+    scpNodeReadable?(session: LIBSSH2_SESSION, path: string, options?: ScpReadOptions): any;
+    scpNodeWritable?(
+      session: LIBSSH2_SESSION,
+      path: string,
+      size: number,
+      options?: ScpWriteOptions
+    ): any;
+
+    // Decode the entries written by ssh2_sftp_readdir_batch
+    decodeDirEntries(buf: number, count: number): SftpDirEntry[];
+
+    // Tree walk manifest (free ptr with _free once loaded) and delta list
+    packWalkManifest(entries: SftpManifestEntry[]): { ptr: number; length: number };
+    decodeWalkDeltas(buf: number, count: number): SftpWalkDelta[];
+
+    // Cached stat/lstat (ssh2_sftp_stat_packed): attributes or the libssh2 error
+    // code; a Promise in async builds. Cache counters are null while it is off.
+    sftpStat(sftp: LIBSSH2_SFTP, path: string, lstat?: boolean,
+      session?: LIBSSH2_SESSION): SftpAttributes | number | Promise<SftpAttributes | number>;
+    sftpCacheInfo(sftp: LIBSSH2_SFTP): { entries: number; hits: number; misses: number } | null;
+    // Pipelined stat of many paths over an ssh2_sftp_batch_new batch
+    sftpStatBatch(
+      batch: SSH2_SFTP_BATCH,
+      paths: string[],
+      options?: { lstat?: boolean; wait?: () => Promise<void>; session?: LIBSSH2_SESSION }
+    ): Promise<SftpStatResult[]>;
+
+    // Session counters: field names in ssh2_stats order, Float64Array snapshot or object
+    SESSION_STATS_FIELDS: Array<keyof SessionStats>;
+    readSessionStats(session: LIBSSH2_SESSION, into?: Float64Array): Float64Array | null;
+    sessionStats(session: LIBSSH2_SESSION): SessionStats | null;
+
+    // Binary trace ring (ssh2_session_trace_ring), null while tracing is off
+    TRACE_EVENTS: Array<string | null>;
+    dumpSessionTrace(session: LIBSSH2_SESSION): SessionTraceDump | null;
+    decodeSessionTrace(dump: SessionTraceDump): SessionTraceEvent[];
+    sessionTrace(session: LIBSSH2_SESSION): SessionTraceEvent[] | null;
+
+    // Heap counters of a ssh2_session_create_ex session, null for other sessions
+    sessionMemory(session: LIBSSH2_SESSION): SessionMemory | null;
+
+    // Walk the records written by ssh2_channel_read_batch; views alias the arena
+    decodeReadBatch(
+      arena: number,
+      used: number,
+      visit: (id: number, stream: number, data: Uint8Array) => void,
+      onError?: (id: number, code: number) => void
+    ): void;
+
+    // Host key of a connected session and known-hosts helpers (see ssh2_knownhost_*)
+    sessionHostkey(session: LIBSSH2_SESSION): { key: Uint8Array; type: number } | null;
+    loadKnownHosts(hosts: LIBSSH2_KNOWNHOSTS, text: string | Uint8Array): number;
+    checkKnownHost(hosts: LIBSSH2_KNOWNHOSTS, host: string, port: number, key: Uint8Array): number;
+
+    // Private key handles for ssh2_userauth_publickey_key, cached by PEM text and passphrase
+    loadPrivateKey(pem: string, passphrase?: string | null): SSH2_KEY;
+    freePrivateKey(key: SSH2_KEY): void;
+
+    // Algorithm preferences: supported names for a LIBSSH2_METHOD_* type, and the
+    // startup benchmark that orders ciphers and MACs fastest first (null on error).
+    // Ciphers come first, rated as suites (AES-CTR plus the fastest MAC), then MACs
+    supportedAlgorithms(session: LIBSSH2_SESSION, methodType: number): string[];
+    preferFastestAlgorithms(
+      session: LIBSSH2_SESSION,
+      bytes?: number
+    ): Array<{ name: string; mbPerSec: number | null }> | null;
+
+    // Flow-controlled streams over an open channel; the channel stays with the caller
+    channelStream(
+      session: LIBSSH2_SESSION,
+      channel: LIBSSH2_CHANNEL,
+      options?: ChannelStreamOptions
+    ): {
+      readable: ReadableStream<Uint8Array>;
+      writable: WritableStream<ArrayBufferView | ArrayBuffer>;
+      stderr: ReadableStream<Uint8Array> | null;
+    };
+
+    // Decode the ssh2_exec_result at ptr
+    decodeExecResult(ptr: number): ExecResult;
+
+    // Async builds only (libssh2-async.js / libssh2-jspi.js)
+    // session queues the call behind that session's other calls (JSPI runs
+    // different sessions concurrently); calls without one run on their own
+    ssh2Async?(ident: string, returnType: string | null, argTypes: string[], args: any[],
+      session?: LIBSSH2_SESSION): Promise<any>;
 
     // File system
     FS: any;
@@ -192,16 +551,45 @@ declare module '@verdigris/libssh2.js' {
 
     // Session management
     ssh2_session_init(): LIBSSH2_SESSION;
+    ssh2_session_create(handle: number, transport: number, rxSize: number, txSize: number): LIBSSH2_SESSION;
+    // Same, with a pooled per-session heap capped at memoryCap live bytes (0 for no cap)
+    ssh2_session_create_ex(
+      handle: number,
+      transport: number,
+      rxSize: number,
+      txSize: number,
+      memoryCap: number
+    ): LIBSSH2_SESSION;
+    ssh2_session_init_ring(rxSize: number, txSize: number): LIBSSH2_SESSION;
+    ssh2_session_handle(session: LIBSSH2_SESSION): number;
+    ssh2_session_rx_ring(session: LIBSSH2_SESSION): SSH2_RING;
+    ssh2_session_tx_ring(session: LIBSSH2_SESSION): SSH2_RING;
     ssh2_session_handshake(session: LIBSSH2_SESSION, socket: number): number;
     ssh2_session_handshake_custom(session: LIBSSH2_SESSION): number;
     ssh2_session_set_blocking(session: LIBSSH2_SESSION, blocking: number): void;
     ssh2_session_callback_set_custom(session: LIBSSH2_SESSION, cbtype: number): void;
+
+    // Transmit coalescing for callback transports (maxBytes 0 turns it off)
+    ssh2_session_coalesce(session: LIBSSH2_SESSION, maxBytes: number, maxDelayMs: number): number;
+    ssh2_session_flush(session: LIBSSH2_SESSION): number;
     ssh2_session_last_errno(session: LIBSSH2_SESSION): number;
     ssh2_session_last_error(session: LIBSSH2_SESSION): string;
     ssh2_session_disconnect(session: LIBSSH2_SESSION, reason: string): number;
     ssh2_session_free(session: LIBSSH2_SESSION): void;
     ssh2_session_banner_get(session: LIBSSH2_SESSION): string;
-    ssh2_session_hostkey(session: LIBSSH2_SESSION): { key: Uint8Array; type: number };
+    // Returns the key blob pointer; out receives i32 length and LIBSSH2_HOSTKEY_TYPE_*
+    ssh2_session_hostkey(session: LIBSSH2_SESSION, out: number): number;
+
+    // Algorithm negotiation (LIBSSH2_METHOD_*, LIBSSH2_FLAG_*); set before the handshake.
+    // supported_algs returns a comma-separated string the caller frees with _free.
+    ssh2_session_method_pref(session: LIBSSH2_SESSION, methodType: number, prefs: string): number;
+    ssh2_session_methods(session: LIBSSH2_SESSION, methodType: number): string | null;
+    ssh2_session_supported_algs(session: LIBSSH2_SESSION, methodType: number): number;
+    ssh2_session_flag(session: LIBSSH2_SESSION, flag: number, value: number): number;
+    // Throughput in MiB/s (cached per module), or LIBSSH2_ERROR.METHOD_NOT_SUPPORTED
+    ssh2_bench_algorithm(name: string, bytes: number): number;
+    ssh2_bench_suite(session: LIBSSH2_SESSION, name: string, bytes: number): number;
+    ssh2_session_prefer_fastest(session: LIBSSH2_SESSION, bytes: number): number;
 
     // Authentication
     ssh2_userauth_list(session: LIBSSH2_SESSION, username: string): string;
@@ -221,6 +609,13 @@ declare module '@verdigris/libssh2.js' {
       privatekeydata: string,
       passphrase: string
     ): number;
+    // Loaded key handles: parse once, sign from any number of sessions.
+    // Encrypted OpenSSH keys are decrypted by libssh2 at each authentication.
+    ssh2_key_load(data: number, length: number, passphrase: string | null): SSH2_KEY;
+    ssh2_key_algorithm(key: SSH2_KEY): string;
+    ssh2_key_public(key: SSH2_KEY, lengthOut: number): number;
+    ssh2_key_free(key: SSH2_KEY): void;
+    ssh2_userauth_publickey_key(session: LIBSSH2_SESSION, username: string, key: SSH2_KEY): number;
     ssh2_userauth_keyboard_interactive(
       session: LIBSSH2_SESSION,
       username: string,
@@ -237,12 +632,44 @@ declare module '@verdigris/libssh2.js' {
       sport: number
     ): LIBSSH2_CHANNEL;
     ssh2_channel_request_pty(channel: LIBSSH2_CHANNEL, term: string): number;
+    ssh2_channel_request_pty_ex(channel: LIBSSH2_CHANNEL, term: string, width: number, height: number): number;
     ssh2_channel_request_pty_size(channel: LIBSSH2_CHANNEL, width: number, height: number): number;
     ssh2_channel_shell(channel: LIBSSH2_CHANNEL): number;
     ssh2_channel_exec(channel: LIBSSH2_CHANNEL, command: string): number;
     ssh2_channel_subsystem(channel: LIBSSH2_CHANNEL, subsystem: string): number;
     ssh2_channel_process_startup(channel: LIBSSH2_CHANNEL, request: string, message: string): number;
 
+    // Channel windows: 0 selects libssh2's default window (2 MiB) / packet size (32 KiB)
+    ssh2_channel_open_ex(
+      session: LIBSSH2_SESSION,
+      type: string,
+      windowSize: number,
+      packetSize: number
+    ): LIBSSH2_CHANNEL;
+    ssh2_channel_receive_window_adjust(channel: LIBSSH2_CHANNEL, adjustment: number, force: number): number;
+    ssh2_channel_window_read(channel: LIBSSH2_CHANNEL): number;
+    ssh2_channel_window_write(channel: LIBSSH2_CHANNEL): number;
+
+    // Channel registry and event pump (events: SSH2_EVENT_SIZE-byte records)
+    ssh2_channel_register(session: LIBSSH2_SESSION, channel: LIBSSH2_CHANNEL): number;
+    ssh2_channel_unregister(session: LIBSSH2_SESSION, id: number): void;
+    ssh2_session_pump(session: LIBSSH2_SESSION, events: number, maxEvents: number): number;
+    ssh2_channel_read_batch(session: LIBSSH2_SESSION, arena: number, arenaLen: number): number;
+    // Window auto-tuning for registered channels (maxWindow 0 turns it off);
+    // info writes target bytes, RTT ms and receive rate bytes/s as three doubles
+    ssh2_channel_autotune(session: LIBSSH2_SESSION, id: number, maxWindow: number): number;
+    ssh2_channel_autotune_info(session: LIBSSH2_SESSION, id: number, out: number): number;
+
+    // Exec pool: step returns 1 when every command is done, LIBSSH2_ERROR.EAGAIN to call again later;
+    // next returns a job id (result written to out) or -1
+    ssh2_exec_pool_new(session: LIBSSH2_SESSION, channels: number, maxOutput: number): SSH2_EXEC_POOL;
+    ssh2_exec_pool_submit(pool: SSH2_EXEC_POOL, command: string): number;
+    ssh2_exec_pool_step(pool: SSH2_EXEC_POOL): number;
+    ssh2_exec_pool_next(pool: SSH2_EXEC_POOL, out: number): number;
+    ssh2_exec_pool_release(pool: SSH2_EXEC_POOL, job: number): void;
+    ssh2_exec_pool_pending(pool: SSH2_EXEC_POOL): number;
+    ssh2_exec_pool_free(pool: SSH2_EXEC_POOL): void;
+
     // Channel I/O
     ssh2_channel_read(channel: LIBSSH2_CHANNEL, buf: number, buflen: number): number;
     ssh2_channel_read_stderr(channel: LIBSSH2_CHANNEL, buf: number, buflen: number): number;
@@ -250,6 +677,15 @@ declare module '@verdigris/libssh2.js' {
     ssh2_channel_write_stderr(channel: LIBSSH2_CHANNEL, buf: number, buflen: number): number;
     ssh2_channel_flush(channel: LIBSSH2_CHANNEL): number;
     ssh2_channel_flush_stderr(channel: LIBSSH2_CHANNEL): number;
+    // Bytes writable now (remote window, capped by TX ring space for ring sessions)
+    ssh2_channel_write_budget(session: LIBSSH2_SESSION, channel: LIBSSH2_CHANNEL): number;
+    // One call with the session non-blocking: LIBSSH2_ERROR_EAGAIN instead of waiting
+    ssh2_channel_read_nowait(session: LIBSSH2_SESSION, channel: LIBSSH2_CHANNEL, stream: number,
+      buffer: number, length: number): number;
+    ssh2_channel_write_nowait(session: LIBSSH2_SESSION, channel: LIBSSH2_CHANNEL, buffer: number, length: number): number;
+    ssh2_channel_send_eof_nowait(session: LIBSSH2_SESSION, channel: LIBSSH2_CHANNEL): number;
+    // 0 = separate stderr, 1 = ignore, 2 = merge into stdout
+    ssh2_channel_handle_extended_data(channel: LIBSSH2_CHANNEL, mode: number): number;
 
     // Channel status
     ssh2_channel_eof(channel: LIBSSH2_CHANNEL): number;
@@ -264,10 +700,34 @@ declare module '@verdigris/libssh2.js' {
     ssh2_channel_free(channel: LIBSSH2_CHANNEL): void;
 
     // Port forwarding
-    ssh2_channel_forward_listen(session: LIBSSH2_SESSION, host: string, port: number): LIBSSH2_LISTENER;
+    ssh2_channel_forward_listen(session: LIBSSH2_SESSION, port: number): LIBSSH2_LISTENER;
+    // boundPort: pointer to an i32 that receives the port the server bound
+    ssh2_channel_forward_listen_ex(
+      session: LIBSSH2_SESSION,
+      host: string | null,
+      port: number,
+      boundPort: number,
+      queueMaxsize: number
+    ): LIBSSH2_LISTENER;
     ssh2_channel_forward_accept(listener: LIBSSH2_LISTENER): LIBSSH2_CHANNEL;
     ssh2_channel_forward_cancel(listener: LIBSSH2_LISTENER): number;
 
+    // Forwarder: connections pumped in C between channels and per-connection ring pairs.
+    // listen returns the bound port; step returns the number of live connections.
+    ssh2_forward_new(session: LIBSSH2_SESSION, id: number, ringSize: number): SSH2_FORWARDER;
+    ssh2_forward_listen(forwarder: SSH2_FORWARDER, host: string | null, port: number, backlog: number): number;
+    ssh2_forward_connect(
+      forwarder: SSH2_FORWARDER,
+      host: string,
+      port: number,
+      shost: string,
+      sport: number
+    ): number;
+    ssh2_forward_close(forwarder: SSH2_FORWARDER, conn: number): void;
+    ssh2_forward_step(forwarder: SSH2_FORWARDER): number;
+    ssh2_forward_bound_port(forwarder: SSH2_FORWARDER): number;
+    ssh2_forward_free(forwarder: SSH2_FORWARDER): void;
+
     // SFTP
     ssh2_sftp_init(session: LIBSSH2_SESSION): LIBSSH2_SFTP;
     ssh2_sftp_shutdown(sftp: LIBSSH2_SFTP): number;
@@ -275,6 +735,8 @@ declare module '@verdigris/libssh2.js' {
     ssh2_sftp_close(handle: LIBSSH2_SFTP_HANDLE): number;
     ssh2_sftp_read(handle: LIBSSH2_SFTP_HANDLE, buffer: number, buffer_maxlen: number): number;
     ssh2_sftp_write(handle: LIBSSH2_SFTP_HANDLE, buffer: number, count: number): number;
+    // buflen >= 1064 (2088 withLongentry), else LIBSSH2_ERROR.BUFFER_TOO_SMALL; 0 = end of directory
+    ssh2_sftp_readdir_batch(handle: LIBSSH2_SFTP_HANDLE, buf: number, buflen: number, withLongentry: number): number;
     ssh2_sftp_seek64(handle: LIBSSH2_SFTP_HANDLE, offset: number): void;
     ssh2_sftp_tell64(handle: LIBSSH2_SFTP_HANDLE): number;
     ssh2_sftp_stat(sftp: LIBSSH2_SFTP, path: string): SftpAttributes;
@@ -286,17 +748,109 @@ declare module '@verdigris/libssh2.js' {
     ssh2_sftp_unlink(sftp: LIBSSH2_SFTP, filename: string): number;
     ssh2_sftp_rename(sftp: LIBSSH2_SFTP, source: string, dest: string): number;
 
-    // Known hosts
+    // Metadata cache (ttlMs 0 turns it off) and pipelined batch stat: batch_stat
+    // returns count when done, LIBSSH2_ERROR.EAGAIN to call again with the same arguments
+    ssh2_sftp_cache_enable(sftp: LIBSSH2_SFTP, ttlMs: number, maxEntries: number): number;
+    ssh2_sftp_cache_clear(sftp: LIBSSH2_SFTP): void;
+    ssh2_sftp_cache_info(sftp: LIBSSH2_SFTP, out: number): number;
+    ssh2_sftp_stat_packed(sftp: LIBSSH2_SFTP, path: string, type: number, out: number): number;
+    ssh2_sftp_batch_new(session: LIBSSH2_SESSION, cacheSftp: LIBSSH2_SFTP | 0): SSH2_SFTP_BATCH;
+    ssh2_sftp_batch_stat(batch: SSH2_SFTP_BATCH, paths: number, count: number, type: number, results: number): number;
+    ssh2_sftp_batch_free(batch: SSH2_SFTP_BATCH): void;
+
+    // Streaming transfers: step returns 1 when done, LIBSSH2_ERROR.EAGAIN to call again later.
+    // bufferSize only sizes the buffer passed to each libssh2 read/write; request
+    // size (<= 30000 bytes) and the number in flight are chosen by libssh2.
+    ssh2_sftp_get_file(
+      handle: LIBSSH2_SFTP_HANDLE,
+      id: number,
+      offset: number,
+      length: number,
+      bufferSize: number
+    ): SSH2_SFTP_TRANSFER;
+    ssh2_sftp_put_file(
+      handle: LIBSSH2_SFTP_HANDLE,
+      id: number,
+      offset: number,
+      bufferSize: number
+    ): SSH2_SFTP_TRANSFER;
+    ssh2_sftp_transfer_step(transfer: SSH2_SFTP_TRANSFER): number;
+    ssh2_sftp_transfer_offset(transfer: SSH2_SFTP_TRANSFER): number;
+    ssh2_sftp_transfer_free(transfer: SSH2_SFTP_TRANSFER): void;
+
+    // Streaming SCP: step returns 1 when done, LIBSSH2_ERROR.EAGAIN to call again later
+    ssh2_scp_recv2(session: LIBSSH2_SESSION, path: string, sb: number): LIBSSH2_CHANNEL;
+    ssh2_scp_send64(
+      session: LIBSSH2_SESSION,
+      path: string,
+      mode: number,
+      size: number,
+      mtime: number,
+      atime: number
+    ): LIBSSH2_CHANNEL;
+    ssh2_chunk_pool_new(count: number, chunkSize: number): SSH2_CHUNK_POOL;
+    ssh2_chunk_pool_free(pool: SSH2_CHUNK_POOL): void;
+    ssh2_chunk_pool_available(pool: SSH2_CHUNK_POOL): number;
+    ssh2_chunk_release(pool: SSH2_CHUNK_POOL, chunk: number): void;
+    ssh2_scp_get(session: LIBSSH2_SESSION, path: string, pool: SSH2_CHUNK_POOL, id: number): SSH2_SCP_TRANSFER;
+    ssh2_scp_put(
+      session: LIBSSH2_SESSION,
+      path: string,
+      pool: SSH2_CHUNK_POOL,
+      id: number,
+      mode: number,
+      size: number,
+      mtime: number,
+      atime: number
+    ): SSH2_SCP_TRANSFER;
+    ssh2_scp_transfer_step(transfer: SSH2_SCP_TRANSFER): number;
+    ssh2_scp_transfer_offset(transfer: SSH2_SCP_TRANSFER): number;
+    ssh2_scp_transfer_size(transfer: SSH2_SCP_TRANSFER): number;
+    ssh2_scp_transfer_free(transfer: SSH2_SCP_TRANSFER): void;
+
+    // Parallel tree walk: step returns 1 when done, LIBSSH2_ERROR.EAGAIN to call again later
+    ssh2_sftp_walk_new(session: LIBSSH2_SESSION, root: string, lanes: number): SSH2_SFTP_WALK;
+    ssh2_sftp_walk_manifest(walk: SSH2_SFTP_WALK, buf: number, buflen: number): number;
+    ssh2_sftp_walk_transfer(walk: SSH2_SFTP_WALK, id: number, bufferSize: number): number;
+    ssh2_sftp_walk_step(walk: SSH2_SFTP_WALK): number;
+    ssh2_sftp_walk_deltas(walk: SSH2_SFTP_WALK): number;
+    ssh2_sftp_walk_delta_count(walk: SSH2_SFTP_WALK): number;
+    ssh2_sftp_walk_delta_status(walk: SSH2_SFTP_WALK, index: number): number;
+    ssh2_sftp_walk_errors(walk: SSH2_SFTP_WALK): number;
+    ssh2_sftp_walk_free(walk: SSH2_SFTP_WALK): void;
+
+    // Known hosts (in-memory, indexed by host and key type; key is a host key blob pointer)
     ssh2_knownhost_init(session: LIBSSH2_SESSION): LIBSSH2_KNOWNHOSTS;
     ssh2_knownhost_free(hosts: LIBSSH2_KNOWNHOSTS): void;
+    ssh2_knownhost_load(hosts: LIBSSH2_KNOWNHOSTS, data: number, length: number): number;
     ssh2_knownhost_readfile(hosts: LIBSSH2_KNOWNHOSTS, filename: string): number;
     ssh2_knownhost_writefile(hosts: LIBSSH2_KNOWNHOSTS, filename: string, type: number): number;
-    ssh2_knownhost_check(
+    ssh2_knownhost_add(
       hosts: LIBSSH2_KNOWNHOSTS,
       host: string,
-      key: Uint8Array,
-      typemask: number
-    ): { result: number; knownhost: any };
+      port: number,
+      key: number,
+      keyLength: number,
+      hashed: number
+    ): number;
+    ssh2_knownhost_check(hosts: LIBSSH2_KNOWNHOSTS, host: string, port: number, key: number, keyLength: number): number;
+    ssh2_knownhost_count(hosts: LIBSSH2_KNOWNHOSTS): number;
+
+    // Performance counters (out points at 16 doubles, see SESSION_STATS_FIELDS)
+    ssh2_session_stats(session: LIBSSH2_SESSION, out: number): number;
+    ssh2_session_stats_reset(session: LIBSSH2_SESSION): void;
+    ssh2_session_stats_timing(session: LIBSSH2_SESSION, enable: number): void;
+    ssh2_channel_window_stalls(session: LIBSSH2_SESSION, id: number): number;
+
+    // Binary trace ring: capacity in events (0 turns it off), returns the rounded capacity
+    ssh2_session_trace_ring(session: LIBSSH2_SESSION, capacity: number): number;
+    ssh2_session_trace_buffer(session: LIBSSH2_SESSION): number;
+    ssh2_session_trace_clear(session: LIBSSH2_SESSION): void;
+
+    // Pooled session heap (ssh2_session_create_ex only; out points at 5 u32)
+    ssh2_session_memory(session: LIBSSH2_SESSION, out: number): number;
+    ssh2_session_memory_cap(session: LIBSSH2_SESSION, cap: number): number;
+    ssh2_session_memory_reset_peak(session: LIBSSH2_SESSION): void;
 
     // Debugging and tracing
     ssh2_trace(session: LIBSSH2_SESSION, bitmask: number): void;
@@ -315,3 +869,83 @@ declare module '@verdigris/libssh2.js' {
   const createLibSSH2Module: LibSSH2ModuleFactory;
   export default createLibSSH2Module;
 }
+
+// Picks dist/libssh2-simd.js in browsers with WebAssembly SIMD, else the baseline build for the runtime
+declare module '@verdigris/libssh2.js/loader' {
+  import type { LibSSH2ModuleFactory, ModuleOptions, SSH2WASMModule } from '@verdigris/libssh2.js';
+
+  export function hasSimd(): boolean;
+  export function detectEnvironment(): 'web' | 'worker' | 'node';
+  export function loadFactory(options?: {
+    simd?: boolean;
+    environment?: 'web' | 'worker' | 'node';
+  }): Promise<LibSSH2ModuleFactory>;
+
+  const createLibSSH2Module: (options?: ModuleOptions) => Promise<SSH2WASMModule>;
+  export default createLibSSH2Module;
+}
+
+declare module '@verdigris/libssh2.js/pool' {
+  export interface PoolOptions {
+    // Number of workers (default: one per core)
+    size?: number;
+    wasmUrl?: string | URL;
+    glueUrl?: string | URL;
+    workerUrl?: string | URL;
+  }
+
+  export interface PoolCallOptions {
+    // The function returns a pointer; NULL plus EAGAIN is retried
+    pointer?: boolean;
+  }
+
+  export interface PoolChannel {
+    readonly id: number;
+    readonly closed: boolean;
+    // stream 0 is stdout, 1 is stderr
+    ondata: ((bytes: Uint8Array, stream: number) => void) | null;
+    oneof: (() => void) | null;
+    onclose: ((exitStatus: number | null) => void) | null;
+    // A read error is followed by onclose(null): the worker has freed the channel
+    onerror: ((error: Error) => void) | null;
+    // The underlying buffer is transferred to the worker when possible
+    write(bytes: Uint8Array | ArrayBuffer): void;
+    // Window change for channels opened with a PTY
+    resize(width: number, height: number): Promise<number>;
+    eof(): void;
+  }
+
+  export interface PoolPtyOptions {
+    term?: string;
+    width?: number;
+    height?: number;
+  }
+
+  export interface PoolSession {
+    readonly id: number;
+    receive(bytes: Uint8Array | ArrayBuffer): void;
+    closeTransport(): void;
+    handshake(): Promise<number>;
+    authPassword(username: string, password: string): Promise<number>;
+    authKey(username: string, privateKey: string, passphrase?: string): Promise<number>;
+    // pty.term defaults to "xterm", the size to 80x24
+    exec(command: string, options?: { pty?: PoolPtyOptions }): Promise<PoolChannel>;
+    shell(options?: { pty?: PoolPtyOptions }): Promise<PoolChannel>;
+    subsystem(name: string): Promise<PoolChannel>;
+    call(ident: string, returnType: 'number' | 'string' | null, argTypes?: string[], args?: unknown[],
+      options?: PoolCallOptions): Promise<unknown>;
+    disconnect(description?: string): Promise<number>;
+    free(): Promise<void>;
+  }
+
+  export interface SessionPool {
+    readonly module: WebAssembly.Module;
+    // send receives the bytes to write to the server's socket
+    createSession(send: (bytes: Uint8Array) => void): Promise<PoolSession>;
+    load(): number[];
+    terminate(): Promise<void>;
+  }
+
+  export function createSessionPool(options?: PoolOptions): Promise<SessionPool>;
+  export default createSessionPool;
+}
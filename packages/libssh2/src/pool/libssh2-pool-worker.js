@@ -0,0 +1,446 @@
+// Worker side of the session pool (see libssh2-pool.js). Instantiates the
+// shared WebAssembly.Module, runs ring sessions in non-blocking mode and
+// services them whenever the main thread delivers bytes or a request.
+// Everything crossing the thread boundary is a transferred ArrayBuffer.
+
+const isNode = typeof process === "object" && !!process.versions?.node;
+const port = isNode ? (await import("node:worker_threads")).parentPort : self;
+
+const LIBSSH2_ERROR_EAGAIN = -37;
+const SSH2_TRANSPORT_RING = 1;
+const SSH2_EVENT_WRITABLE = 0x04;
+const SSH2_EVENT_EOF = 0x08;
+const SSH2_EVENT_CLOSED = 0x10;
+const SSH2_EVENT_EXIT_STATUS = 0x20;
+const SSH2_EVENT_SIZE = 16;
+
+const MAX_EVENTS = 64;
+// Service passes per turn before yielding to the port, while work remains
+const MAX_PASSES = 16;
+const ARENA_SIZE = 256 * 1024;
+const RING_SIZE = 256 * 1024;
+
+// Returned by a request step that has to wait for the network
+const PENDING = Symbol("pending");
+
+let SSH2;
+let events = 0;
+let arena = 0;
+let scratch = 0;
+const sessions = new Map();
+
+function post(message, transfer = []) {
+  port.postMessage(message, transfer);
+}
+
+// Copy a HEAPU8 view into its own ArrayBuffer so it can be transferred
+function detach(view) {
+  return view.slice().buffer;
+}
+
+function call(ident, ret, argTypes, args) {
+  return SSH2.ccall(ident, ret, argTypes, args);
+}
+
+function lastError(session) {
+  const errno = call("ssh2_session_last_errno", "number", ["number"], [session.ptr]);
+  const message = call("ssh2_session_last_error", "string", ["number"], [session.ptr]);
+  return { errno, message };
+}
+
+// Step for calls returning an int: EAGAIN keeps the request queued
+function retry(fn) {
+  return () => {
+    const rc = fn();
+    return rc === LIBSSH2_ERROR_EAGAIN ? PENDING : rc;
+  };
+}
+
+// Step for calls returning a pointer: NULL plus EAGAIN keeps it queued
+function retryPointer(session, fn) {
+  return () => {
+    const ptr = fn();
+    if (ptr) return ptr;
+    const { errno, message } = lastError(session);
+    if (errno === LIBSSH2_ERROR_EAGAIN) return PENDING;
+    throw new Error(`libssh2 error ${errno}: ${message}`);
+  };
+}
+
+// Run steps in order, feeding each the previous result; fails on rc < 0
+function sequence(steps) {
+  let index = 0;
+  let value;
+  return () => {
+    while (index < steps.length) {
+      const result = steps[index](value);
+      if (result === PENDING) return PENDING;
+      if (typeof result === "number" && result < 0) {
+        throw new Error(`libssh2 error ${result}`);
+      }
+      if (result !== undefined) value = result;
+      index++;
+    }
+    return value;
+  };
+}
+
+// =====================================
+// Sessions
+// =====================================
+
+function createSession(id) {
+  const session = {
+    id, ptr: 0, handle: 0, rx: 0, pending: [], requests: [], channels: new Map(), flushing: false, scheduled: false,
+  };
+
+  session.handle = SSH2.registerTransport({
+    transmit: (ptr, tx) => {
+      if (session.flushing) return;
+      session.flushing = true;
+      // Drain once everything written during this turn has accumulated
+      queueMicrotask(() => {
+        session.flushing = false;
+        // The ring went with the session if it was freed in the meantime
+        if (!sessions.has(id)) return;
+        const chunks = [];
+        SSH2.ringDrain(tx, (view) => chunks.push(view.slice()));
+        for (const chunk of chunks) {
+          post({ type: "transmit", session: id, bytes: chunk.buffer }, [chunk.buffer]);
+        }
+        // Writers that hit a full TX ring returned EAGAIN; let them retry
+        if (chunks.length) service(session);
+      });
+    },
+  });
+
+  session.ptr = call("ssh2_session_create", "number", ["number", "number", "number", "number"],
+    [session.handle, SSH2_TRANSPORT_RING, RING_SIZE, RING_SIZE]);
+  if (!session.ptr) {
+    SSH2.unregisterTransport(session.handle);
+    throw new Error("ssh2_session_create failed");
+  }
+  session.rx = call("ssh2_session_rx_ring", "number", ["number"], [session.ptr]);
+  sessions.set(id, session);
+  return 0;
+}
+
+// Requests still queued never run; fail them so their callers settle
+function freeSession(session) {
+  for (const request of session.requests) {
+    post({ type: "result", id: request.id, error: "Session freed" });
+  }
+  session.requests = [];
+
+  for (const channel of session.channels.values()) {
+    call("ssh2_channel_unregister", null, ["number", "number"], [session.ptr, channel.id]);
+    call("ssh2_channel_free", null, ["number"], [channel.ptr]);
+  }
+  // Also releases the transport handle
+  call("ssh2_session_free", null, ["number"], [session.ptr]);
+  sessions.delete(session.id);
+  return 0;
+}
+
+// Move bytes from the main thread into the RX ring as space allows and
+// return how many moved
+function feed(session) {
+  let fed = 0;
+  while (session.pending.length) {
+    const chunk = session.pending[0];
+    const written = SSH2.ringWrite(session.rx, chunk);
+    fed += written;
+    if (written === chunk.length) {
+      session.pending.shift();
+    } else {
+      session.pending[0] = chunk.subarray(written);
+      if (written === 0) break;
+    }
+  }
+  return fed;
+}
+
+// =====================================
+// Channels
+// =====================================
+
+function openChannel(session, { command, subsystem, pty }) {
+  const channel = { id: -1, ptr: 0, writes: [], eof: false };
+  const steps = [
+    retryPointer(session, () => call("ssh2_channel_open_session", "number", ["number"], [session.ptr])),
+    (ptr) => {
+      channel.ptr = ptr;
+      return 0;
+    },
+  ];
+
+  if (pty) {
+    // pty-req carries the initial size; resize() sends window-change later
+    steps.push(retry(() => call("ssh2_channel_request_pty_ex", "number",
+      ["number", "string", "number", "number"],
+      [channel.ptr, pty.term || "xterm", pty.width || 80, pty.height || 24])));
+  }
+  if (subsystem) {
+    steps.push(retry(() => call("ssh2_channel_subsystem", "number", ["number", "string"], [channel.ptr, subsystem])));
+  } else if (command) {
+    steps.push(retry(() => call("ssh2_channel_exec", "number", ["number", "string"], [channel.ptr, command])));
+  } else {
+    steps.push(retry(() => call("ssh2_channel_shell", "number", ["number"], [channel.ptr])));
+  }
+
+  steps.push(() => {
+    channel.id = call("ssh2_channel_register", "number", ["number", "number"], [session.ptr, channel.ptr]);
+    if (channel.id < 0) return channel.id;
+    session.channels.set(channel.id, channel);
+    return channel.id;
+  });
+  return sequence(steps);
+}
+
+// Returns whether anything was handed to libssh2
+function flushWrites(session, channel) {
+  let progress = false;
+  while (channel.writes.length) {
+    const chunk = channel.writes[0];
+    const length = Math.min(chunk.length, ARENA_SIZE);
+    SSH2.HEAPU8.set(chunk.subarray(0, length), scratch);
+
+    const rc = call("ssh2_channel_write", "number", ["number", "number", "number"], [channel.ptr, scratch, length]);
+    if (rc === LIBSSH2_ERROR_EAGAIN) return progress;
+    if (rc < 0) {
+      channel.writes = [];
+      post({ type: "channel-error", session: session.id, channel: channel.id, error: lastError(session).message });
+      return true;
+    }
+    if (rc > 0) progress = true;
+
+    if (rc === chunk.length) {
+      channel.writes.shift();
+    } else {
+      channel.writes[0] = chunk.subarray(rc);
+    }
+  }
+
+  if (channel.eof && !channel.eofSent) {
+    const rc = call("ssh2_channel_send_eof", "number", ["number"], [channel.ptr]);
+    if (rc !== LIBSSH2_ERROR_EAGAIN) {
+      channel.eofSent = true;
+      progress = true;
+    }
+  }
+  return progress;
+}
+
+// Deliver channel data and events, then free channels the server closed.
+// Returns whether anything moved.
+function serviceChannels(session) {
+  if (!session.channels.size) return false;
+
+  const used = call("ssh2_channel_read_batch", "number", ["number", "number", "number"], [session.ptr, arena, ARENA_SIZE]);
+  if (used > 0) {
+    SSH2.decodeReadBatch(arena, used, (id, stream, view) => {
+      const bytes = detach(view);
+      post({ type: "channel-data", session: session.id, channel: id, stream, bytes }, [bytes]);
+    }, (id, error) => {
+      // The channel is unusable; report it and free it so the proxy closes
+      const channel = session.channels.get(id);
+      post({ type: "channel-error", session: session.id, channel: id, error: `libssh2 error ${error}`, closed: true });
+      if (!channel) return;
+      call("ssh2_channel_unregister", null, ["number", "number"], [session.ptr, id]);
+      call("ssh2_channel_free", null, ["number"], [channel.ptr]);
+      session.channels.delete(id);
+    });
+  }
+
+  let progress = used > 0;
+  const count = call("ssh2_session_pump", "number", ["number", "number", "number"], [session.ptr, events, MAX_EVENTS]);
+  for (let i = 0; i < count; i++) {
+    const base = (events + i * SSH2_EVENT_SIZE) >> 2;
+    const id = SSH2.HEAPU32[base];
+    const flags = SSH2.HEAPU32[base + 1];
+    const exitStatus = SSH2.HEAP32[base + 2];
+    const channel = session.channels.get(id);
+    if (!channel) continue;
+
+    if (flags & SSH2_EVENT_WRITABLE && flushWrites(session, channel)) progress = true;
+    if (flags & (SSH2_EVENT_EOF | SSH2_EVENT_CLOSED)) {
+      progress = true;
+      post({
+        type: "channel-event",
+        session: session.id,
+        channel: id,
+        flags,
+        exitStatus: flags & SSH2_EVENT_EXIT_STATUS ? exitStatus : null,
+      });
+    }
+    if (flags & SSH2_EVENT_CLOSED) {
+      call("ssh2_channel_unregister", null, ["number", "number"], [session.ptr, id]);
+      call("ssh2_channel_free", null, ["number"], [channel.ptr]);
+      session.channels.delete(id);
+    }
+  }
+
+  for (const channel of session.channels.values()) {
+    if ((channel.writes.length || (channel.eof && !channel.eofSent)) && flushWrites(session, channel)) {
+      progress = true;
+    }
+  }
+  return progress;
+}
+
+// One pass over queued requests in order, then the channels. Returns
+// whether anything moved.
+function servicePass(session) {
+  let progress = feed(session) > 0;
+
+  while (session.requests.length) {
+    const request = session.requests[0];
+    let result;
+    try {
+      result = request.step();
+      if (result === PENDING) break;
+      post({ type: "result", id: request.id, value: result });
+    } catch (error) {
+      post({ type: "result", id: request.id, error: error.message });
+    }
+    session.requests.shift();
+    progress = true;
+  }
+
+  if (serviceChannels(session)) progress = true;
+  return feed(session) > 0 || progress;
+}
+
+// Service until a pass moves nothing, i.e. everything left waits on the
+// network, the TX ring draining (transmit services again) or the main
+// thread. Pending bytes, a full arena or writes libssh2 could not take yet
+// are retried in the same turn. After MAX_PASSES the rest is picked up on a
+// later task so port messages still get through.
+function service(session) {
+  for (let pass = 0; pass < MAX_PASSES; pass++) {
+    if (!servicePass(session)) return;
+  }
+  if (session.scheduled) return;
+  session.scheduled = true;
+  setTimeout(() => {
+    session.scheduled = false;
+    if (sessions.has(session.id)) service(session);
+  }, 0);
+}
+
+// =====================================
+// Requests
+// =====================================
+
+function requestStep(session, op, args) {
+  switch (op) {
+    case "handshake":
+      return retry(() => call("ssh2_session_handshake_custom", "number", ["number"], [session.ptr]));
+    case "authPassword":
+      return retry(() => call("ssh2_userauth_password", "number", ["number", "string", "string"],
+        [session.ptr, args.username, args.password]));
+    case "authKey":
+      return retry(() => call("ssh2_userauth_publickey_frommemory", "number",
+        ["number", "string", "string", "number", "string", "number", "string"],
+        [session.ptr, args.username, null, 0, args.privateKey, new TextEncoder().encode(args.privateKey).length,
+          args.passphrase || ""]));
+    case "openChannel":
+      return openChannel(session, args);
+    case "resize": {
+      const channel = session.channels.get(args.channel);
+      if (!channel) throw new Error("Unknown channel");
+      return retry(() => call("ssh2_channel_request_pty_size", "number",
+        ["number", "number", "number", "number", "number"],
+        [channel.ptr, args.width, args.height, 0, 0]));
+    }
+    case "disconnect":
+      return retry(() => call("ssh2_session_disconnect", "number", ["number", "string"],
+        [session.ptr, args.description || "Goodbye"]));
+    case "call": {
+      // Any other export taking the session pointer first
+      const argTypes = ["number", ...args.argTypes];
+      const values = () => [session.ptr, ...args.args];
+      return args.pointer
+        ? retryPointer(session, () => call(args.ident, "number", argTypes, values()))
+        : retry(() => call(args.ident, args.returnType, argTypes, values()));
+    }
+    default:
+      throw new Error(`Unknown request ${op}`);
+  }
+}
+
+async function init({ module, glueUrl }) {
+  const { default: factory } = await import(glueUrl);
+  SSH2 = await factory({
+    instantiateWasm(imports, receiveInstance) {
+      WebAssembly.instantiate(module, imports).then((instance) => receiveInstance(instance, module));
+      return {};
+    },
+  });
+  call("ssh2_init", "number", [], []);
+  events = SSH2._malloc(MAX_EVENTS * SSH2_EVENT_SIZE);
+  arena = SSH2._malloc(ARENA_SIZE);
+  scratch = SSH2._malloc(ARENA_SIZE);
+}
+
+function onMessage(message) {
+  if (message.type === "init") {
+    init(message).then(
+      () => post({ type: "ready" }),
+      (error) => post({ type: "ready", error: error.message }),
+    );
+    return;
+  }
+
+  if (message.type === "create") {
+    try {
+      post({ type: "result", id: message.id, value: createSession(message.session) });
+    } catch (error) {
+      post({ type: "result", id: message.id, error: error.message });
+    }
+    return;
+  }
+
+  const session = sessions.get(message.session);
+  if (!session) {
+    if (message.id) post({ type: "result", id: message.id, error: "Unknown session" });
+    return;
+  }
+
+  switch (message.type) {
+    case "data":
+      session.pending.push(new Uint8Array(message.bytes));
+      break;
+    case "close-transport":
+      SSH2.ringClose(session.rx);
+      break;
+    case "write": {
+      const channel = session.channels.get(message.channel);
+      if (channel) channel.writes.push(new Uint8Array(message.bytes));
+      break;
+    }
+    case "eof": {
+      const channel = session.channels.get(message.channel);
+      if (channel) channel.eof = true;
+      break;
+    }
+    case "free":
+      post({ type: "result", id: message.id, value: freeSession(session) });
+      return;
+    case "request":
+      try {
+        session.requests.push({ id: message.id, step: requestStep(session, message.op, message.args) });
+      } catch (error) {
+        post({ type: "result", id: message.id, error: error.message });
+      }
+      break;
+  }
+
+  service(session);
+}
+
+if (isNode) {
+  port.on("message", onMessage);
+} else {
+  self.onmessage = (event) => onMessage(event.data);
+}
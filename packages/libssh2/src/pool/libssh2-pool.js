@@ -0,0 +1,303 @@
+// Session pool: compile libssh2.wasm once, instantiate it in N Web Workers
+// (or Node worker_threads) and spread sessions across them, so key
+// exchange and cipher work for many connections run in parallel.
+//
+// The main thread keeps a thin proxy per session. Bytes from the network go
+// to the owning worker with receive(), bytes for the network come back
+// through the session's send callback, and channel data travels both ways
+// as transferred ArrayBuffers (never copied through structured clone).
+
+const isNode = typeof process === "object" && !!process.versions?.node;
+
+const SSH2_EVENT_EOF = 0x08;
+const SSH2_EVENT_CLOSED = 0x10;
+
+// Default glue per runtime; both are built by build.sh --matrix
+function defaultUrls() {
+  const name = isNode ? "libssh2-node" : "libssh2-worker";
+  return {
+    wasmUrl: new URL(`./${name}.wasm`, import.meta.url),
+    glueUrl: new URL(`./${name}.js`, import.meta.url),
+    workerUrl: new URL("./libssh2-pool-worker.js", import.meta.url),
+  };
+}
+
+async function compileModule(wasmUrl) {
+  if (isNode) {
+    const { readFile } = await import("node:fs/promises");
+    return WebAssembly.compile(await readFile(wasmUrl));
+  }
+  return WebAssembly.compileStreaming(fetch(wasmUrl));
+}
+
+// Wrap Worker and worker_threads.Worker behind postMessage/onmessage
+async function spawnWorker(workerUrl, onMessage) {
+  if (isNode) {
+    const { Worker } = await import("node:worker_threads");
+    const worker = new Worker(workerUrl);
+    worker.on("message", onMessage);
+    return worker;
+  }
+  const worker = new Worker(workerUrl, { type: "module" });
+  worker.onmessage = (event) => onMessage(event.data);
+  return worker;
+}
+
+// Copy into a standalone ArrayBuffer unless the caller handed one over whole
+function transferable(bytes) {
+  const view = bytes instanceof Uint8Array ? bytes : new Uint8Array(bytes);
+  const whole = view.byteOffset === 0 && view.byteLength === view.buffer.byteLength;
+  if (whole && view.buffer instanceof ArrayBuffer) {
+    return view.buffer;
+  }
+  return view.slice().buffer;
+}
+
+class PoolWorker {
+  constructor(pool, index) {
+    this.pool = pool;
+    this.index = index;
+    this.sessions = 0;
+    this.worker = null;
+  }
+
+  post(message, transfer = []) {
+    this.worker.postMessage(message, transfer);
+  }
+}
+
+export class PoolChannel {
+  constructor(session, id) {
+    this.session = session;
+    this.id = id;
+    this.closed = false;
+    // ondata(bytes: Uint8Array, stream: number), stream 1 is stderr
+    this.ondata = null;
+    this.oneof = null;
+    // onclose(exitStatus: number | null)
+    this.onclose = null;
+    this.onerror = null;
+  }
+
+  // Queue bytes for the channel. The buffer is transferred when possible,
+  // so the caller must not reuse it.
+  write(bytes) {
+    const buffer = transferable(bytes);
+    this.session.worker.post({ type: "write", session: this.session.id, channel: this.id, bytes: buffer }, [buffer]);
+  }
+
+  // Change the PTY size of a shell() or exec({ pty }) channel
+  resize(width, height) {
+    return this.session.request("resize", { channel: this.id, width, height });
+  }
+
+  // Send EOF once all queued writes have gone out
+  eof() {
+    this.session.worker.post({ type: "eof", session: this.session.id, channel: this.id });
+  }
+}
+
+export class PoolSession {
+  constructor(pool, worker, id, send) {
+    this.pool = pool;
+    this.worker = worker;
+    this.id = id;
+    // send(bytes: Uint8Array) delivers bytes to the server
+    this.send = send;
+    this.channels = new Map();
+  }
+
+  // Hand bytes read from the network to the worker
+  receive(bytes) {
+    const buffer = transferable(bytes);
+    this.worker.post({ type: "data", session: this.id, bytes: buffer }, [buffer]);
+  }
+
+  // The network connection closed; pending reads see EOF
+  closeTransport() {
+    this.worker.post({ type: "close-transport", session: this.id });
+  }
+
+  handshake() {
+    return this.request("handshake", {});
+  }
+
+  authPassword(username, password) {
+    return this.request("authPassword", { username, password });
+  }
+
+  authKey(username, privateKey, passphrase) {
+    return this.request("authKey", { username, privateKey, passphrase });
+  }
+
+  exec(command, options = {}) {
+    return this.openChannel({ command, pty: options.pty });
+  }
+
+  shell(options = {}) {
+    return this.openChannel({ pty: options.pty ?? {} });
+  }
+
+  subsystem(name) {
+    return this.openChannel({ subsystem: name });
+  }
+
+  async openChannel(args) {
+    const id = await this.request("openChannel", args);
+    const channel = new PoolChannel(this, id);
+    this.channels.set(id, channel);
+    return channel;
+  }
+
+  // Call an exported ssh2_* function taking the session pointer first; it is
+  // prepended in the worker. EAGAIN is retried there too. Set pointer for
+  // functions returning a pointer (NULL plus EAGAIN means "not yet").
+  call(ident, returnType, argTypes = [], args = [], options = {}) {
+    return this.request("call", { ident, returnType, argTypes, args, pointer: !!options.pointer });
+  }
+
+  disconnect(description) {
+    return this.request("disconnect", { description });
+  }
+
+  async free() {
+    await this.pool.call(this.worker, { type: "free", session: this.id });
+    this.pool.sessions.delete(this.id);
+    this.worker.sessions--;
+  }
+
+  request(op, args) {
+    return this.pool.call(this.worker, { type: "request", session: this.id, op, args });
+  }
+
+  dispatch(message) {
+    switch (message.type) {
+      case "transmit":
+        this.send(new Uint8Array(message.bytes));
+        break;
+      case "channel-data": {
+        const channel = this.channels.get(message.channel);
+        if (channel?.ondata) channel.ondata(new Uint8Array(message.bytes), message.stream);
+        break;
+      }
+      case "channel-event": {
+        const channel = this.channels.get(message.channel);
+        if (!channel) break;
+        if (message.flags & SSH2_EVENT_EOF && channel.oneof) channel.oneof();
+        if (message.flags & SSH2_EVENT_CLOSED) {
+          channel.closed = true;
+          this.channels.delete(message.channel);
+          if (channel.onclose) channel.onclose(message.exitStatus);
+        }
+        break;
+      }
+      case "channel-error": {
+        const channel = this.channels.get(message.channel);
+        if (!channel) break;
+        if (channel.onerror) channel.onerror(new Error(message.error));
+        // Read errors free the channel in the worker
+        if (message.closed) {
+          channel.closed = true;
+          this.channels.delete(message.channel);
+          if (channel.onclose) channel.onclose(null);
+        }
+        break;
+      }
+    }
+  }
+}
+
+export class SessionPool {
+  constructor(size) {
+    this.workers = Array.from({ length: size }, (_, index) => new PoolWorker(this, index));
+    this.sessions = new Map();
+    this.pending = new Map();
+    this.nextId = 1;
+    this.module = null;
+  }
+
+  async start(urls) {
+    this.module = await compileModule(urls.wasmUrl);
+    await Promise.all(
+      this.workers.map(async (entry) => {
+        const ready = new Promise((resolve, reject) => {
+          entry.ready = { resolve, reject };
+        });
+        entry.worker = await spawnWorker(urls.workerUrl, (message) => this.onMessage(entry, message));
+        // A WebAssembly.Module is structured-cloneable: workers share the
+        // compiled code and only instantiate it
+        entry.post({ type: "init", module: this.module, glueUrl: String(urls.glueUrl) });
+        return ready;
+      }),
+    );
+  }
+
+  // Least-loaded worker gets the session
+  createSession(send) {
+    const worker = this.workers.reduce((best, entry) => (entry.sessions < best.sessions ? entry : best));
+    const id = this.nextId++;
+    const session = new PoolSession(this, worker, id, send);
+    this.sessions.set(id, session);
+    worker.sessions++;
+    return this.call(worker, { type: "create", session: id }).then(
+      () => session,
+      (error) => {
+        this.sessions.delete(id);
+        worker.sessions--;
+        throw error;
+      },
+    );
+  }
+
+  call(worker, message) {
+    const id = this.nextId++;
+    return new Promise((resolve, reject) => {
+      this.pending.set(id, { resolve, reject });
+      worker.post({ ...message, id });
+    });
+  }
+
+  onMessage(worker, message) {
+    if (message.type === "ready") {
+      if (message.error) worker.ready.reject(new Error(message.error));
+      else worker.ready.resolve();
+      return;
+    }
+
+    if (message.type === "result") {
+      const pending = this.pending.get(message.id);
+      if (!pending) return;
+      this.pending.delete(message.id);
+      if (message.error !== undefined) pending.reject(new Error(message.error));
+      else pending.resolve(message.value);
+      return;
+    }
+
+    this.sessions.get(message.session)?.dispatch(message);
+  }
+
+  // Per-worker session counts, for checking the spread
+  load() {
+    return this.workers.map((entry) => entry.sessions);
+  }
+
+  async terminate() {
+    await Promise.all(this.workers.map((entry) => entry.worker?.terminate()));
+    for (const pending of this.pending.values()) {
+      pending.reject(new Error("Session pool terminated"));
+    }
+    this.pending.clear();
+    this.sessions.clear();
+  }
+}
+
+// Compile the module and start `size` workers (default: one per core)
+export async function createSessionPool(options = {}) {
+  const size =
+    options.size ?? (isNode ? (await import("node:os")).availableParallelism() : navigator.hardwareConcurrency || 4);
+  const pool = new SessionPool(size);
+  await pool.start({ ...defaultUrls(), ...options });
+  return pool;
+}
+
+export default createSessionPool;
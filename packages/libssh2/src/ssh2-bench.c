@@ -0,0 +1,259 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Algorithm Benchmark
+// =====================================
+
+// Relative cipher speed in WebAssembly is nothing like native: there is no
+// AES-NI or CLMUL, so table-driven AES-GCM can lose to ChaCha20-Poly1305 or
+// AES-CTR depending on the engine. This times the OpenSSL primitive behind
+// each SSH algorithm the way the transport drives it, one 32 KiB packet at a
+// time with per-packet IV/MAC setup, so preference lists can be ordered by
+// what is fastest in the current runtime.
+//
+// libssh2 ships its own portable chacha20-poly1305, which is timed here
+// through OpenSSL's equivalent C implementation.
+//
+// Only algorithms in bench_table are ranked. Everything else libssh2
+// supports (CBC modes, 3DES, MD5, SHA-1 MACs, ...) keeps its default order
+// after them, so benchmarking never promotes a weaker algorithm.
+//
+// AEAD ciphers authenticate as well as encrypt, while AES-CTR still needs a
+// MAC, so the CRYPT lists rank cipher suites rather than bare ciphers: each
+// CTR cipher is costed together with the fastest benchmarked MAC libssh2
+// supports, the pair it would actually run with.
+
+#define BENCH_PACKET 32768
+#define BENCH_DEFAULT_BYTES (1 << 20)
+
+typedef enum {
+    BENCH_AEAD,    // Cipher and MAC in one, re-keyed with a fresh IV per packet
+    BENCH_CIPHER,  // Stream mode, one context for the whole run
+    BENCH_HMAC
+} bench_kind;
+
+typedef struct bench_entry {
+    const char* name;
+    bench_kind kind;
+    const EVP_CIPHER* (*cipher)(void);
+    const EVP_MD* (*digest)(void);
+    double mb_per_s;   // Cached result, 0 until measured
+} bench_entry;
+
+static bench_entry bench_table[] = {
+    { "aes256-gcm@openssh.com", BENCH_AEAD, EVP_aes_256_gcm, NULL, 0 },
+    { "aes128-gcm@openssh.com", BENCH_AEAD, EVP_aes_128_gcm, NULL, 0 },
+    { "chacha20-poly1305@openssh.com", BENCH_AEAD, EVP_chacha20_poly1305, NULL, 0 },
+    { "aes256-ctr", BENCH_CIPHER, EVP_aes_256_ctr, NULL, 0 },
+    { "aes192-ctr", BENCH_CIPHER, EVP_aes_192_ctr, NULL, 0 },
+    { "aes128-ctr", BENCH_CIPHER, EVP_aes_128_ctr, NULL, 0 },
+    // -etm variants cost the same as the plain MAC and share its entry
+    { "hmac-sha2-256", BENCH_HMAC, NULL, EVP_sha256, 0 },
+    { "hmac-sha2-512", BENCH_HMAC, NULL, EVP_sha512, 0 },
+};
+
+#define BENCH_ENTRIES (sizeof(bench_table) / sizeof(bench_table[0]))
+
+static bench_entry* bench_find(const char* name) {
+    for (size_t i = 0; i < BENCH_ENTRIES; i++) {
+        const char* base = bench_table[i].name;
+        size_t length = strlen(base);
+        if (strncmp(name, base, length) != 0) continue;
+        if (name[length] == '\0' || strcmp(name + length, "-etm@openssh.com") == 0) {
+            return &bench_table[i];
+        }
+    }
+    return NULL;
+}
+
+static int bench_cipher(const EVP_CIPHER* cipher, int aead, uint8_t* buffer, size_t bytes) {
+    static const uint8_t key[32] = { 1 };
+    uint8_t iv[16] = { 2 };
+    uint8_t tag[16];
+    int length = 0;
+    int ok = 0;
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx || !EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv)) goto out;
+
+    for (size_t done = 0; done < bytes; done += BENCH_PACKET) {
+        if (aead) {
+            // Packet length is authenticated but not encrypted
+            iv[11]++;
+            if (!EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv)
+                || !EVP_EncryptUpdate(ctx, NULL, &length, buffer, 4)) goto out;
+        }
+        if (!EVP_EncryptUpdate(ctx, buffer, &length, buffer, BENCH_PACKET)) goto out;
+        if (aead && (!EVP_EncryptFinal_ex(ctx, tag, &length)
+                     || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, sizeof(tag), tag))) goto out;
+    }
+    ok = 1;
+
+out:
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+static int bench_hmac(const EVP_MD* digest, uint8_t* buffer, size_t bytes) {
+    static const uint8_t key[64] = { 3 };
+    uint8_t mac[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+
+    for (size_t done = 0; done < bytes; done += BENCH_PACKET) {
+        if (!HMAC(digest, key, EVP_MD_get_size(digest), buffer, BENCH_PACKET, mac, &length)) return 0;
+    }
+    return 1;
+}
+
+static double bench_run(bench_entry* entry, size_t bytes) {
+    uint8_t* buffer = calloc(1, BENCH_PACKET);
+    if (!buffer) return LIBSSH2_ERROR_ALLOC;
+
+    double start = emscripten_get_now();
+    int ok = entry->kind == BENCH_HMAC
+        ? bench_hmac(entry->digest(), buffer, bytes)
+        : bench_cipher(entry->cipher(), entry->kind == BENCH_AEAD, buffer, bytes);
+    double elapsed = emscripten_get_now() - start;
+    free(buffer);
+
+    if (!ok) return LIBSSH2_ERROR_METHOD_NOT_SUPPORTED;
+    // Clamp so a coarse clock never reports an infinite rate
+    if (elapsed < 0.001) elapsed = 0.001;
+    return (double)bytes / (1 << 20) / (elapsed / 1000);
+}
+
+// Throughput in MiB/s of one SSH cipher or MAC name in this runtime, measured
+// over `bytes` (0 for 1 MiB) and cached for the life of the module. Returns
+// LIBSSH2_ERROR_METHOD_NOT_SUPPORTED for algorithms without a benchmark.
+EMSCRIPTEN_KEEPALIVE
+double ssh2_bench_algorithm(const char* name, size_t bytes) {
+    bench_entry* entry = name ? bench_find(name) : NULL;
+    if (!entry) return LIBSSH2_ERROR_METHOD_NOT_SUPPORTED;
+
+    if (!entry->mb_per_s) {
+        double rate = bench_run(entry, bytes ? bytes : BENCH_DEFAULT_BYTES);
+        if (rate < 0) return rate;
+        entry->mb_per_s = rate;
+    }
+    return entry->mb_per_s;
+}
+
+// =====================================
+// Preference Ordering
+// =====================================
+
+typedef struct bench_rank {
+    const char* name;
+    double rate;      // -1 for algorithms that are not ranked
+    int order;        // Position in libssh2's list, breaks ties
+} bench_rank;
+
+static int rank_compare(const void* a, const void* b) {
+    const bench_rank* x = a;
+    const bench_rank* y = b;
+    if (x->rate != y->rate) return x->rate > y->rate ? -1 : 1;
+    return x->order - y->order;
+}
+
+// Fastest benchmarked MAC this session supports, 0 if there is none
+static double fastest_mac(LIBSSH2_SESSION* session, size_t bytes) {
+    const char** algs = NULL;
+    int count = libssh2_session_supported_algs(session, LIBSSH2_METHOD_MAC_CS, &algs);
+    double best = 0;
+
+    for (int i = 0; i < count; i++) {
+        double rate = ssh2_bench_algorithm(algs[i], bytes);
+        if (rate > best) best = rate;
+    }
+    if (count > 0) libssh2_free(session, algs);
+    return best;
+}
+
+// End-to-end rate of a cipher suite: AEAD ciphers as measured, CTR ciphers
+// combined with `mac_rate` (the MAC handles every byte the cipher does).
+// Returns -1 for ciphers that cannot be ranked.
+static double suite_rate(const char* name, size_t bytes, double mac_rate) {
+    bench_entry* entry = bench_find(name);
+    if (!entry || entry->kind == BENCH_HMAC) return -1;
+
+    double rate = ssh2_bench_algorithm(name, bytes);
+    if (rate <= 0) return -1;
+    if (entry->kind == BENCH_CIPHER) {
+        if (mac_rate <= 0) return -1;
+        rate = 1 / (1 / rate + 1 / mac_rate);
+    }
+    return rate;
+}
+
+// Throughput in MiB/s of a CRYPT algorithm as a suite, i.e. including the
+// fastest supported MAC for non-AEAD ciphers, as ranked by
+// ssh2_session_prefer_fastest. Returns LIBSSH2_ERROR_METHOD_NOT_SUPPORTED
+// for ciphers that are not ranked.
+EMSCRIPTEN_KEEPALIVE
+double ssh2_bench_suite(LIBSSH2_SESSION* session, const char* name, size_t bytes) {
+    if (!session || !name) return LIBSSH2_ERROR_METHOD_NOT_SUPPORTED;
+    double rate = suite_rate(name, bytes, fastest_mac(session, bytes));
+    return rate > 0 ? rate : LIBSSH2_ERROR_METHOD_NOT_SUPPORTED;
+}
+
+static int prefer_fastest(LIBSSH2_SESSION* session, int method_type, size_t bytes, double mac_rate) {
+    const char** algs = NULL;
+    int count = libssh2_session_supported_algs(session, method_type, &algs);
+    if (count <= 0) return count;
+
+    int rc = LIBSSH2_ERROR_ALLOC;
+    bench_rank* ranks = calloc((size_t)count, sizeof(bench_rank));
+    size_t length = 1;
+    if (!ranks) goto out;
+
+    int crypt = method_type == LIBSSH2_METHOD_CRYPT_CS || method_type == LIBSSH2_METHOD_CRYPT_SC;
+    for (int i = 0; i < count; i++) {
+        double rate = crypt ? suite_rate(algs[i], bytes, mac_rate) : ssh2_bench_algorithm(algs[i], bytes);
+        ranks[i].name = algs[i];
+        ranks[i].rate = rate > 0 ? rate : -1;
+        ranks[i].order = i;
+        length += strlen(algs[i]) + 1;
+    }
+    qsort(ranks, (size_t)count, sizeof(bench_rank), rank_compare);
+
+    char* prefs = malloc(length);
+    if (!prefs) goto out;
+    prefs[0] = '\0';
+    for (int i = 0; i < count; i++) {
+        if (i) strcat(prefs, ",");
+        strcat(prefs, ranks[i].name);
+    }
+    rc = libssh2_session_method_pref(session, method_type, prefs);
+    free(prefs);
+
+out:
+    free(ranks);
+    libssh2_free(session, algs);
+    return rc;
+}
+
+// Benchmark the ciphers and MACs libssh2 supports (once per module) and set
+// the session's CRYPT and MAC preferences fastest first. Ciphers are ranked
+// as suites (see suite_rate), MACs on their own. Call before the handshake.
+// Returns 0 or a libssh2 error.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_prefer_fastest(LIBSSH2_SESSION* session, size_t bytes) {
+    static const int methods[] = {
+        LIBSSH2_METHOD_CRYPT_CS, LIBSSH2_METHOD_CRYPT_SC,
+        LIBSSH2_METHOD_MAC_CS, LIBSSH2_METHOD_MAC_SC
+    };
+
+    double mac_rate = fastest_mac(session, bytes);
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        int rc = prefer_fastest(session, methods[i], bytes, mac_rate);
+        if (rc < 0) return rc;
+    }
+    return 0;
+}
@@ -0,0 +1,438 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Channel Registry
+// =====================================
+
+ssh2_channel_entry* ssh2_channel_entry_get(ssh2_session_ctx* ctx, int id) {
+    if (!ctx || id < 0 || (uint32_t)id >= ctx->channel_count) return NULL;
+    ssh2_channel_entry* entry = &ctx->channels[id];
+    return entry->channel ? entry : NULL;
+}
+
+// Register a channel with its session so the pump services it.
+// Returns the channel id used in events, or a negative libssh2 error.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_register(LIBSSH2_SESSION* session, LIBSSH2_CHANNEL* channel) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || !channel) return LIBSSH2_ERROR_BAD_USE;
+
+    uint32_t id;
+    for (id = 0; id < ctx->channel_count; id++) {
+        if (!ctx->channels[id].channel) break;
+    }
+
+    if (id == ctx->channel_count) {
+        uint32_t count = ctx->channel_count ? ctx->channel_count * 2 : 8;
+        ssh2_channel_entry* channels = realloc(ctx->channels, count * sizeof(ssh2_channel_entry));
+        if (!channels) return LIBSSH2_ERROR_ALLOC;
+        memset(channels + ctx->channel_count, 0, (count - ctx->channel_count) * sizeof(ssh2_channel_entry));
+        ctx->channels = channels;
+        ctx->channel_count = count;
+    }
+
+    memset(&ctx->channels[id], 0, sizeof(ssh2_channel_entry));
+    ctx->channels[id].channel = channel;
+    return (int)id;
+}
+
+// Remove a channel from the registry (call before ssh2_channel_free)
+EMSCRIPTEN_KEEPALIVE
+void ssh2_channel_unregister(LIBSSH2_SESSION* session, int id) {
+    ssh2_channel_entry* entry = ssh2_channel_entry_get(ssh2_session_get_ctx(session), id);
+    if (entry) {
+        memset(entry, 0, sizeof(ssh2_channel_entry));
+    }
+}
+
+// =====================================
+// Window Auto-Tuning
+// =====================================
+
+// A channel's throughput is capped at receive window / RTT, and libssh2 only
+// ever refills the window to the size it was opened with. For channels with
+// auto-tuning on, each pump estimates the receive rate from how far the
+// window fell since the last pump, and the RTT from how long data takes to
+// resume after a window adjust sent while the window was nearly shut. The
+// target window tracks twice rate * RTT, doubles whenever the server nearly
+// exhausts it between pumps, never shrinks, and is capped at tune_max.
+// Windows are only reopened while the application keeps up with reading, so
+// a stalled reader still pushes back on the server.
+
+#define TUNE_SMOOTHING 0.25
+
+static double tune_smooth(double current, double sample) {
+    return current > 0 ? current + (sample - current) * TUNE_SMOOTHING : sample;
+}
+
+static void tune_sample(ssh2_channel_entry* entry, uint32_t window, double now) {
+    double elapsed = now - entry->tune_mark;
+
+    // A larger window means an adjust (ours or libssh2's own refill on read)
+    // landed in between, so the drop no longer measures what arrived
+    if (window < entry->tune_window && elapsed > 0) {
+        entry->tune_rate = tune_smooth(entry->tune_rate, (entry->tune_window - window) / elapsed);
+        if (entry->tune_starved) {
+            entry->tune_rtt = tune_smooth(entry->tune_rtt, now - entry->tune_adjusted);
+            entry->tune_starved = 0;
+        }
+    }
+    entry->tune_mark = now;
+}
+
+static uint32_t tune_target(ssh2_channel_entry* entry, int starved) {
+    double target = entry->tune_target;
+    double bdp = 2 * entry->tune_rate * entry->tune_rtt;
+
+    if (bdp > target) {
+        target = bdp;
+    }
+    if (starved) {
+        target *= 2;
+    }
+    return target > entry->tune_max ? entry->tune_max : (uint32_t)target;
+}
+
+// Returns 0, or a libssh2 error other than EAGAIN
+static int tune_window(ssh2_channel_entry* entry, double now) {
+    unsigned long read_avail = 0;
+    unsigned long initial = 0;
+    uint32_t window = (uint32_t)libssh2_channel_window_read_ex(entry->channel, &read_avail, &initial);
+    uint32_t adjustment = entry->tune_pending;
+    unsigned int granted = 0;
+
+    if (!entry->tune_target) {
+        entry->tune_target = initial < entry->tune_max ? (uint32_t)initial : entry->tune_max;
+        entry->tune_window = window;
+        entry->tune_mark = now;
+        return 0;
+    }
+
+    tune_sample(entry, window, now);
+    int starved = window < entry->tune_target / 4;
+
+    if (!adjustment && read_avail < entry->tune_target / 2) {
+        entry->tune_target = tune_target(entry, starved);
+        if (window < entry->tune_target / 2) {
+            adjustment = entry->tune_target - window;
+        }
+    }
+
+    if (adjustment) {
+        // A resent adjust must carry the same amount, libssh2 credits the
+        // window with the argument of the call that completes it
+        int rc = libssh2_channel_receive_window_adjust2(entry->channel, adjustment, 1, &granted);
+        if (rc == LIBSSH2_ERROR_EAGAIN) {
+            entry->tune_pending = adjustment;
+        } else {
+            entry->tune_pending = 0;
+            if (rc < 0) return rc;
+            if (starved && !entry->tune_starved) {
+                entry->tune_starved = 1;
+                entry->tune_adjusted = now;
+            }
+            window += adjustment;
+        }
+    }
+
+    entry->tune_window = window;
+    return 0;
+}
+
+// Let the pump grow this channel's receive window up to max_window bytes
+// (0 turns auto-tuning off). Pair with ssh2_channel_open_ex to start from a
+// small window and let busy channels earn a larger one.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_autotune(LIBSSH2_SESSION* session, int id, unsigned int max_window) {
+    ssh2_channel_entry* entry = ssh2_channel_entry_get(ssh2_session_get_ctx(session), id);
+    if (!entry) return LIBSSH2_ERROR_BAD_USE;
+
+    entry->tune_max = max_window;
+    entry->tune_target = 0;
+    entry->tune_starved = 0;
+    return 0;
+}
+
+// Write the tuner's target window (bytes), RTT estimate (ms) and receive
+// rate (bytes/s) into out[0..2]
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_autotune_info(LIBSSH2_SESSION* session, int id, double* out) {
+    ssh2_channel_entry* entry = ssh2_channel_entry_get(ssh2_session_get_ctx(session), id);
+    if (!entry || !out) return LIBSSH2_ERROR_BAD_USE;
+
+    out[0] = entry->tune_target;
+    out[1] = entry->tune_rtt;
+    out[2] = entry->tune_rate * 1000;
+    return 0;
+}
+
+// =====================================
+// Write Budget
+// =====================================
+
+// Room for SSH framing (length, padding, MAC) per packet written to the ring
+#define WRITE_PACKET_OVERHEAD 128
+
+// Bytes a write to channel can hand off right now: the remote window,
+// further limited for ring sessions by free space in the TX ring. 0 means
+// wait for a window adjust or for the TX ring to drain rather than retrying.
+EMSCRIPTEN_KEEPALIVE
+uint32_t ssh2_channel_write_budget(LIBSSH2_SESSION* session, LIBSSH2_CHANNEL* channel) {
+    if (!channel) return 0;
+
+    uint32_t budget = (uint32_t)libssh2_channel_window_write_ex(channel, NULL);
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (ctx && ctx->tx) {
+        uint32_t space = ssh2_ring_space(ctx->tx);
+        space = space > WRITE_PACKET_OVERHEAD ? space - WRITE_PACKET_OVERHEAD : 0;
+        if (space < budget) budget = space;
+    }
+    return budget;
+}
+
+// =====================================
+// Non-Waiting Stream I/O
+// =====================================
+
+// Channel streams (src/js/channels.js) read, write and send EOF through
+// these. Each runs with the session non-blocking for the one call, so it
+// returns LIBSSH2_ERROR_EAGAIN instead of waiting on the transport. In
+// async builds that keeps a read with nothing to read from holding the
+// call queue ahead of the writes an interactive shell needs to go out.
+
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_read_nowait(LIBSSH2_SESSION* session, LIBSSH2_CHANNEL* channel, int stream,
+                             char* buffer, size_t length) {
+    if (!session || !channel) return LIBSSH2_ERROR_BAD_USE;
+    int blocking = libssh2_session_get_blocking(session);
+    libssh2_session_set_blocking(session, 0);
+    ssize_t rc = libssh2_channel_read_ex(channel, stream, buffer, length);
+    libssh2_session_set_blocking(session, blocking);
+    return (int)rc;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_write_nowait(LIBSSH2_SESSION* session, LIBSSH2_CHANNEL* channel,
+                              const char* buffer, size_t length) {
+    if (!session || !channel) return LIBSSH2_ERROR_BAD_USE;
+    int blocking = libssh2_session_get_blocking(session);
+    libssh2_session_set_blocking(session, 0);
+    ssize_t rc = libssh2_channel_write_ex(channel, 0, buffer, length);
+    libssh2_session_set_blocking(session, blocking);
+    return (int)rc;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_send_eof_nowait(LIBSSH2_SESSION* session, LIBSSH2_CHANNEL* channel) {
+    if (!session || !channel) return LIBSSH2_ERROR_BAD_USE;
+    int blocking = libssh2_session_get_blocking(session);
+    libssh2_session_set_blocking(session, 0);
+    int rc = libssh2_channel_send_eof(channel);
+    libssh2_session_set_blocking(session, blocking);
+    return rc;
+}
+
+// =====================================
+// Event Pump
+// =====================================
+
+// Move everything the transport has buffered into libssh2's packet queue.
+// libssh2_channel_wait_eof reads until EAGAIN without touching the receive
+// window (a zero-length channel read would reopen it), so any channel that
+// has not seen EOF yet can drive it for the whole session.
+static int pump_transport(ssh2_session_ctx* ctx) {
+    for (uint32_t id = 0; id < ctx->channel_count; id++) {
+        ssh2_channel_entry* entry = &ctx->channels[id];
+        if (!entry->channel || (entry->reported & SSH2_EVENT_EOF)) continue;
+
+        int rc = libssh2_channel_wait_eof(entry->channel);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        if (rc < 0) return rc;
+        // This channel reached EOF mid-drain; let the next one continue
+    }
+    return 0;
+}
+
+// Service every registered channel in one call. Reads the transport once,
+// then fills events with one record per channel that needs attention and
+// returns the number of records, or a negative libssh2 error.
+// READABLE/STDERR are level-triggered; WRITABLE, EOF and CLOSED are
+// reported once per transition. Runs non-blocking regardless of the
+// session's mode, so in async builds it reads only what the transport has
+// already buffered instead of suspending. Records that do not fit are
+// reported by the next pump.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_pump(LIBSSH2_SESSION* session, ssh2_channel_event* events, int max_events) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || !events || max_events < 0) return LIBSSH2_ERROR_BAD_USE;
+
+    int blocking = libssh2_session_get_blocking(session);
+    libssh2_session_set_blocking(session, 0);
+
+    int rc = pump_transport(ctx);
+    int count = 0;
+    double now = 0;
+
+    for (uint32_t id = 0; rc == 0 && id < ctx->channel_count && count < max_events; id++) {
+        ssh2_channel_entry* entry = &ctx->channels[id];
+        LIBSSH2_CHANNEL* channel = entry->channel;
+        if (!channel) continue;
+
+        uint32_t flags = 0;
+        int32_t exit_status = 0;
+
+        if (entry->tune_max && !(entry->reported & SSH2_EVENT_EOF)) {
+            if (!now) now = emscripten_get_now();
+            rc = tune_window(entry, now);
+            if (rc < 0) break;
+        }
+
+        if (libssh2_poll_channel_read(channel, 0) > 0) {
+            flags |= SSH2_EVENT_READABLE;
+        }
+        // libssh2 cannot tell stderr apart once stdout is also queued,
+        // so this may be set when only stdout is pending
+        if (libssh2_poll_channel_read(channel, 1) > 0) {
+            flags |= SSH2_EVENT_STDERR;
+        }
+
+        uint32_t window = (uint32_t)libssh2_channel_window_write_ex(channel, NULL);
+        if (window > 0 && entry->last_window == 0) {
+            flags |= SSH2_EVENT_WRITABLE;
+        } else if (window == 0 && entry->last_window > 0) {
+            entry->window_stalls++;
+            ctx->stats.window_stalls++;
+            if (ctx->trace) ssh2_trace_record(ctx, SSH2_TRACE_WINDOW_STALL, 0, (int)id, 0, 0);
+        }
+
+        if (!(entry->reported & SSH2_EVENT_EOF) && libssh2_channel_eof(channel) == 1) {
+            flags |= SSH2_EVENT_EOF;
+        }
+
+        if (((entry->reported | flags) & SSH2_EVENT_EOF) && !(entry->reported & SSH2_EVENT_CLOSED)) {
+            int closed = libssh2_channel_wait_closed(channel);
+            if (closed == 0) {
+                flags |= SSH2_EVENT_CLOSED | SSH2_EVENT_EXIT_STATUS;
+                exit_status = libssh2_channel_get_exit_status(channel);
+            } else if (closed != LIBSSH2_ERROR_EAGAIN) {
+                rc = closed;
+                break;
+            }
+        }
+
+        entry->last_window = window;
+        if (!flags) continue;
+
+        entry->reported |= flags & (SSH2_EVENT_EOF | SSH2_EVENT_CLOSED);
+        events[count].id = id;
+        events[count].flags = flags;
+        events[count].exit_status = exit_status;
+        events[count].write_window = window;
+        count++;
+    }
+
+    libssh2_session_set_blocking(session, blocking);
+    return rc < 0 ? rc : count;
+}
+
+// =====================================
+// Batch Read
+// =====================================
+
+#define RECORD_ALIGN(n) (((n) + 3u) & ~3u)
+
+// Append one record for (channel, stream), reading until libssh2 has no more
+// queued data or the arena is full. room is a multiple of 4, so the aligned
+// record always fits. Returns bytes used, 0 or a libssh2 error.
+static int read_record(LIBSSH2_CHANNEL* channel, uint32_t id, int stream,
+                       uint8_t* out, size_t room) {
+    if (room <= sizeof(ssh2_read_record)) return 0;
+
+    uint8_t* payload = out + sizeof(ssh2_read_record);
+    size_t capacity = room - sizeof(ssh2_read_record);
+    size_t length = 0;
+
+    while (length < capacity) {
+        ssize_t rc = libssh2_channel_read_ex(channel, stream, (char*)payload + length, capacity - length);
+        if (rc == 0 || rc == LIBSSH2_ERROR_EAGAIN) break;
+        if (rc < 0) {
+            if (length == 0) return (int)rc;
+            break; // Keep what was read, the error shows up again next call
+        }
+        length += (size_t)rc;
+    }
+
+    if (length == 0) return 0;
+
+    ssh2_read_record* record = (ssh2_read_record*)out;
+    record->id = id;
+    record->stream = (uint32_t)stream;
+    record->length = (uint32_t)length;
+    return (int)RECORD_ALIGN(sizeof(ssh2_read_record) + length);
+}
+
+// Append an SSH2_READ_ERROR record carrying the channel's read error.
+// Returns bytes used, or 0 when it does not fit (the error shows up again
+// next call).
+static int error_record(uint32_t id, int error, uint8_t* out, size_t room) {
+    if (room < sizeof(ssh2_read_record) + sizeof(int32_t)) return 0;
+
+    ssh2_read_record* record = (ssh2_read_record*)out;
+    record->id = id;
+    record->stream = SSH2_READ_ERROR;
+    record->length = sizeof(int32_t);
+    int32_t code = error;
+    memcpy(out + sizeof(ssh2_read_record), &code, sizeof(code));
+    return (int)(sizeof(ssh2_read_record) + sizeof(int32_t));
+}
+
+// Drain stdout and stderr of every registered channel into one arena.
+// Each chunk is written as an ssh2_read_record header (id, stream, length)
+// followed by the payload, 4-byte aligned, so JS can hand out HEAPU8
+// subarray views without copying. A channel whose read fails gets an
+// SSH2_READ_ERROR record and the other channels are still drained. Only
+// whole multiples of 4 bytes of arena_len are used. Returns the number of
+// arena bytes used, or a negative libssh2 error if the transport failed
+// before anything could be read.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_read_batch(LIBSSH2_SESSION* session, uint8_t* arena, size_t arena_len) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || !arena || ((uintptr_t)arena & 3)) return LIBSSH2_ERROR_BAD_USE;
+
+    // Records are padded to 4 bytes, and the result has to fit an int
+    if (arena_len > INT_MAX) arena_len = INT_MAX;
+    arena_len &= ~(size_t)3;
+
+    int blocking = libssh2_session_get_blocking(session);
+    libssh2_session_set_blocking(session, 0);
+
+    int rc = pump_transport(ctx);
+    size_t used = 0;
+
+    for (uint32_t id = 0; rc == 0 && id < ctx->channel_count; id++) {
+        LIBSSH2_CHANNEL* channel = ctx->channels[id].channel;
+        if (!channel) continue;
+
+        // Check the packet queue first so idle channels cost no read call
+        for (int stream = 0; stream <= SSH_EXTENDED_DATA_STDERR; stream++) {
+            if (libssh2_poll_channel_read(channel, stream) <= 0) continue;
+
+            int n = read_record(channel, id, stream, arena + used, arena_len - used);
+            if (n < 0) {
+                used += (size_t)error_record(id, n, arena + used, arena_len - used);
+                break;
+            }
+            used += (size_t)n;
+        }
+    }
+
+    libssh2_session_set_blocking(session, blocking);
+    if (rc < 0 && used == 0) return rc;
+    return (int)used;
+}
@@ -0,0 +1,415 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Exec Pool
+// =====================================
+
+// Runs a queue of commands over at most `channels` session channels at once.
+// Every channel walks open -> exec -> read until EOF -> close on its own, so
+// while one waits for the server the others keep the connection busy, and
+// the whole queue is driven by one call per batch of network input instead
+// of several ccalls per command. libssh2 keeps a single channel-open state
+// per session, so opens are issued one after another; exec requests, output
+// and closes of different channels overlap freely.
+
+#define EXEC_MAX_CHANNELS 64
+#define EXEC_READ_CHUNK 16384
+
+enum {
+    SLOT_IDLE,
+    SLOT_OPEN,
+    SLOT_EXEC,
+    SLOT_READ,
+    SLOT_CLOSE,
+    SLOT_FREE,
+    SLOT_RETIRED   // Server refused another channel, the pool runs without it
+};
+
+enum {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_RELEASED
+};
+
+typedef struct exec_output {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} exec_output;
+
+typedef struct exec_job {
+    char* command;
+    int state;
+    int error;
+    int exit_status;
+    uint32_t flags;
+    exec_output out[2];   // stdout, stderr
+    int next_done;        // Next job in the completion FIFO, -1 at the end
+} exec_job;
+
+typedef struct exec_slot {
+    int state;
+    int job;
+    LIBSSH2_CHANNEL* channel;
+} exec_slot;
+
+typedef struct ssh2_exec_pool {
+    LIBSSH2_SESSION* session;
+    size_t max_output;    // Per stream, 0 for unlimited
+
+    exec_slot* slots;
+    int slot_count;
+    int opening;          // Slot inside libssh2_channel_open_session, -1 if none
+
+    exec_job* jobs;
+    int job_count;
+    int job_capacity;
+    int next_job;         // Lowest job index that may still be queued
+    int pending;          // Jobs submitted and not yet done
+
+    int done_head;        // Completed jobs not yet returned by ssh2_exec_pool_next
+    int done_tail;
+} ssh2_exec_pool;
+
+static int output_append(ssh2_exec_pool* pool, exec_job* job, int stream, const char* data, size_t length) {
+    exec_output* out = &job->out[stream];
+
+    if (pool->max_output && out->length + length > pool->max_output) {
+        length = pool->max_output - out->length;
+        job->flags |= SSH2_EXEC_TRUNCATED;
+    }
+    if (length == 0) return 0;
+
+    if (out->length + length > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity * 2 : 4096;
+        while (capacity < out->length + length) {
+            capacity *= 2;
+        }
+        uint8_t* buffer = realloc(out->data, capacity);
+        if (!buffer) return LIBSSH2_ERROR_ALLOC;
+        out->data = buffer;
+        out->capacity = capacity;
+    }
+
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+    return 0;
+}
+
+static void job_finish(ssh2_exec_pool* pool, int index, int error) {
+    exec_job* job = &pool->jobs[index];
+    if (error && !job->error) {
+        job->error = error;
+    }
+    job->state = JOB_DONE;
+    job->next_done = -1;
+    pool->pending--;
+
+    if (pool->done_tail >= 0) {
+        pool->jobs[pool->done_tail].next_done = index;
+    } else {
+        pool->done_head = index;
+    }
+    pool->done_tail = index;
+}
+
+static int next_queued_job(ssh2_exec_pool* pool) {
+    while (pool->next_job < pool->job_count && pool->jobs[pool->next_job].state != JOB_QUEUED) {
+        pool->next_job++;
+    }
+    return pool->next_job < pool->job_count ? pool->next_job : -1;
+}
+
+static int slots_busy(ssh2_exec_pool* pool, int except) {
+    for (int i = 0; i < pool->slot_count; i++) {
+        int state = pool->slots[i].state;
+        if (i != except && state != SLOT_IDLE && state != SLOT_RETIRED) return 1;
+    }
+    return 0;
+}
+
+// Read whatever the channel has queued on both streams
+static int slot_read(ssh2_exec_pool* pool, exec_slot* slot) {
+    char buffer[EXEC_READ_CHUNK];
+    exec_job* job = &pool->jobs[slot->job];
+    int moved = 0;
+
+    for (int stream = 0; stream <= SSH_EXTENDED_DATA_STDERR; stream++) {
+        for (;;) {
+            ssize_t rc = libssh2_channel_read_ex(slot->channel, stream, buffer, sizeof(buffer));
+            if (rc == LIBSSH2_ERROR_EAGAIN || rc == 0) break;
+            if (rc < 0) return (int)rc;
+
+            int err = output_append(pool, job, stream, buffer, (size_t)rc);
+            if (err < 0) return err;
+            moved = 1;
+        }
+    }
+    return moved;
+}
+
+// Advance one slot. Returns 1 if its state moved, 0 if it is waiting on the
+// network or has nothing to do, or a negative libssh2 error that ends the
+// whole pool. Failures of a single command are recorded on its job.
+static int slot_step(ssh2_exec_pool* pool, int index) {
+    exec_slot* slot = &pool->slots[index];
+
+    switch (slot->state) {
+    case SLOT_IDLE: {
+        int job = next_queued_job(pool);
+        if (job < 0) return 0;
+
+        pool->jobs[job].state = JOB_RUNNING;
+        pool->next_job = job + 1;
+        slot->job = job;
+        slot->state = SLOT_OPEN;
+        return 1;
+    }
+
+    case SLOT_OPEN: {
+        if (pool->opening != -1 && pool->opening != index) return 0;
+
+        slot->channel = libssh2_channel_open_session(pool->session);
+        if (!slot->channel) {
+            int rc = libssh2_session_last_errno(pool->session);
+            if (rc == LIBSSH2_ERROR_EAGAIN) {
+                pool->opening = index;
+                return 0;
+            }
+            pool->opening = -1;
+
+            // Servers cap channels per connection; hand the command back
+            // and carry on with the channels we have
+            if (rc == LIBSSH2_ERROR_CHANNEL_FAILURE && slots_busy(pool, index)) {
+                pool->jobs[slot->job].state = JOB_QUEUED;
+                if (slot->job < pool->next_job) pool->next_job = slot->job;
+                slot->state = SLOT_RETIRED;
+                return 1;
+            }
+            if (rc == LIBSSH2_ERROR_CHANNEL_FAILURE) {
+                job_finish(pool, slot->job, rc);
+                slot->state = SLOT_IDLE;
+                return 1;
+            }
+            return rc;
+        }
+        pool->opening = -1;
+        slot->state = SLOT_EXEC;
+        return 1;
+    }
+
+    case SLOT_EXEC: {
+        int rc = libssh2_channel_exec(slot->channel, pool->jobs[slot->job].command);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        if (rc < 0) {
+            if (rc != LIBSSH2_ERROR_CHANNEL_REQUEST_DENIED) return rc;
+            pool->jobs[slot->job].error = rc;
+            slot->state = SLOT_CLOSE;
+            return 1;
+        }
+        slot->state = SLOT_READ;
+        return 1;
+    }
+
+    case SLOT_READ: {
+        int rc = slot_read(pool, slot);
+        if (rc < 0) return rc;
+        if (!libssh2_channel_eof(slot->channel)) return rc;
+        slot->state = SLOT_CLOSE;
+        return 1;
+    }
+
+    case SLOT_CLOSE: {
+        int rc = libssh2_channel_close(slot->channel);
+        if (rc == 0) rc = libssh2_channel_wait_closed(slot->channel);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        if (rc < 0) return rc;
+
+        exec_job* job = &pool->jobs[slot->job];
+        job->exit_status = libssh2_channel_get_exit_status(slot->channel);
+
+        char* signal = NULL;
+        size_t signal_length = 0;
+        if (libssh2_channel_get_exit_signal(slot->channel, &signal, &signal_length,
+                                            NULL, NULL, NULL, NULL) == 0 && signal) {
+            job->flags |= SSH2_EXEC_SIGNALED;
+            libssh2_free(pool->session, signal);
+        }
+        slot->state = SLOT_FREE;
+        return 1;
+    }
+
+    case SLOT_FREE: {
+        int rc = libssh2_channel_free(slot->channel);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        slot->channel = NULL;
+        job_finish(pool, slot->job, 0);
+        slot->job = -1;
+        slot->state = SLOT_IDLE;
+        return rc < 0 ? rc : 1;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+// =====================================
+// Exec Pool API
+// =====================================
+
+// Create a pool running at most `channels` commands at once on an
+// authenticated session (OpenSSH allows 10 channels per connection by
+// default). max_output caps each command's stdout and stderr (0: no cap);
+// output past it is dropped and the result is flagged truncated.
+EMSCRIPTEN_KEEPALIVE
+ssh2_exec_pool* ssh2_exec_pool_new(LIBSSH2_SESSION* session, int channels, size_t max_output) {
+    if (!session || channels <= 0) return NULL;
+    if (channels > EXEC_MAX_CHANNELS) channels = EXEC_MAX_CHANNELS;
+
+    ssh2_exec_pool* pool = calloc(1, sizeof(ssh2_exec_pool));
+    if (!pool) return NULL;
+
+    pool->slots = calloc((size_t)channels, sizeof(exec_slot));
+    if (!pool->slots) {
+        free(pool);
+        return NULL;
+    }
+    for (int i = 0; i < channels; i++) {
+        pool->slots[i].job = -1;
+    }
+
+    pool->session = session;
+    pool->max_output = max_output;
+    pool->slot_count = channels;
+    pool->opening = -1;
+    pool->done_head = -1;
+    pool->done_tail = -1;
+    return pool;
+}
+
+// Queue a command. Returns its job id (in submission order, from 0) or a
+// negative libssh2 error. Commands start on the next ssh2_exec_pool_step.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_exec_pool_submit(ssh2_exec_pool* pool, const char* command) {
+    if (!pool || !command) return LIBSSH2_ERROR_BAD_USE;
+
+    if (pool->job_count == pool->job_capacity) {
+        int capacity = pool->job_capacity ? pool->job_capacity * 2 : 64;
+        exec_job* jobs = realloc(pool->jobs, (size_t)capacity * sizeof(exec_job));
+        if (!jobs) return LIBSSH2_ERROR_ALLOC;
+        pool->jobs = jobs;
+        pool->job_capacity = capacity;
+    }
+
+    exec_job* job = &pool->jobs[pool->job_count];
+    memset(job, 0, sizeof(exec_job));
+    job->command = strdup(command);
+    if (!job->command) return LIBSSH2_ERROR_ALLOC;
+    job->next_done = -1;
+
+    pool->pending++;
+    return pool->job_count++;
+}
+
+// Advance every channel as far as the transport allows. Returns 1 once all
+// submitted commands have completed, LIBSSH2_ERROR_EAGAIN when waiting on
+// the network, or another libssh2 error (the session is then unusable).
+// Completed commands can be collected with ssh2_exec_pool_next after every
+// call. Runs non-blocking regardless of the session's mode.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_exec_pool_step(ssh2_exec_pool* pool) {
+    if (!pool) return LIBSSH2_ERROR_BAD_USE;
+
+    int blocking = libssh2_session_get_blocking(pool->session);
+    libssh2_session_set_blocking(pool->session, 0);
+
+    int rc;
+    for (;;) {
+        int moved = 0;
+        rc = 0;
+        for (int i = 0; i < pool->slot_count && rc >= 0; i++) {
+            rc = slot_step(pool, i);
+            if (rc > 0) moved = 1;
+        }
+        if (rc < 0) break;
+        if (pool->pending == 0) {
+            rc = 1;
+            break;
+        }
+        if (!moved) {
+            rc = LIBSSH2_ERROR_EAGAIN;
+            break;
+        }
+    }
+
+    libssh2_session_set_blocking(pool->session, blocking);
+    return rc;
+}
+
+// Pop the oldest completed command not returned yet into out and return its
+// job id, or -1 if none is waiting. The output pointers stay valid until
+// ssh2_exec_pool_release for that job or ssh2_exec_pool_free.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_exec_pool_next(ssh2_exec_pool* pool, ssh2_exec_result* out) {
+    if (!pool || !out || pool->done_head < 0) return -1;
+
+    int index = pool->done_head;
+    exec_job* job = &pool->jobs[index];
+    pool->done_head = job->next_done;
+    if (pool->done_head < 0) {
+        pool->done_tail = -1;
+    }
+
+    out->job = index;
+    out->error = job->error;
+    out->exit_status = job->exit_status;
+    out->flags = job->flags;
+    out->out = job->out[0].data;
+    out->out_length = (uint32_t)job->out[0].length;
+    out->err = job->out[1].data;
+    out->err_length = (uint32_t)job->out[1].length;
+    return index;
+}
+
+// Free a completed command's output and command string
+EMSCRIPTEN_KEEPALIVE
+void ssh2_exec_pool_release(ssh2_exec_pool* pool, int id) {
+    if (!pool || id < 0 || id >= pool->job_count || pool->jobs[id].state != JOB_DONE) return;
+
+    exec_job* job = &pool->jobs[id];
+    free(job->command);
+    free(job->out[0].data);
+    free(job->out[1].data);
+    job->command = NULL;
+    memset(job->out, 0, sizeof(job->out));
+    job->state = JOB_RELEASED;
+}
+
+// Number of submitted commands that have not completed
+EMSCRIPTEN_KEEPALIVE
+int ssh2_exec_pool_pending(ssh2_exec_pool* pool) {
+    return pool ? pool->pending : 0;
+}
+
+// Free the pool and every result. Channels still open (the pool did not
+// finish) are left to be released with the session.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_exec_pool_free(ssh2_exec_pool* pool) {
+    if (!pool) return;
+
+    for (int i = 0; i < pool->job_count; i++) {
+        free(pool->jobs[i].command);
+        free(pool->jobs[i].out[0].data);
+        free(pool->jobs[i].out[1].data);
+    }
+    free(pool->jobs);
+    free(pool->slots);
+    free(pool);
+}
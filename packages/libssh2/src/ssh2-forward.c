@@ -0,0 +1,354 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Port Forwarding
+// =====================================
+
+// Forwarded connections (accepted from a remote listener, or opened with
+// ssh2_forward_connect) are serviced entirely in C: ssh2_forward_step reads
+// channel data straight into each connection's out ring and writes its in
+// ring straight to the channel, so JS only moves bytes between rings and
+// sockets and hears about opens, closes, errors and output becoming ready.
+// A channel is only read while its out ring has room, so a slow local
+// socket closes the SSH window instead of growing a buffer.
+
+enum {
+    CONN_FREE,
+    CONN_CONNECTING,   // direct-tcpip open pending
+    CONN_OPEN,
+    CONN_CLOSING,      // channel being freed
+    CONN_ABANDONED     // closed locally while its open was in flight
+};
+
+static void forward_event(ssh2_forwarder* fwd, uint32_t conn, int kind, int a, int b) {
+    EM_ASM({
+        Module.forwarders[$0].event($1, $2, $3, $4);
+    }, fwd->id, (int)conn, kind, a, b);
+}
+
+static void conn_reset_rings(ssh2_forward_conn* conn) {
+    conn->in->head = conn->in->tail = conn->in->flags = 0;
+    conn->out->head = conn->out->tail = conn->out->flags = 0;
+}
+
+static void conn_release(ssh2_forward_conn* conn) {
+    free(conn->host);
+    free(conn->shost);
+    conn->host = NULL;
+    conn->shost = NULL;
+    conn->channel = NULL;
+    conn->eof_sent = 0;
+    conn->state = CONN_FREE;
+}
+
+// Claim a free slot, growing the table and allocating rings on first use.
+// Returns the slot index or a negative libssh2 error.
+static int conn_alloc(ssh2_forwarder* fwd) {
+    uint32_t index;
+    for (index = 0; index < fwd->conn_count; index++) {
+        if (fwd->conns[index].state == CONN_FREE) break;
+    }
+
+    if (index == fwd->conn_count) {
+        uint32_t count = fwd->conn_count ? fwd->conn_count * 2 : 4;
+        ssh2_forward_conn* conns = realloc(fwd->conns, count * sizeof(ssh2_forward_conn));
+        if (!conns) return LIBSSH2_ERROR_ALLOC;
+        memset(conns + fwd->conn_count, 0, (count - fwd->conn_count) * sizeof(ssh2_forward_conn));
+        fwd->conns = conns;
+        fwd->conn_count = count;
+    }
+
+    ssh2_forward_conn* conn = &fwd->conns[index];
+    if (!conn->in) conn->in = ssh2_ring_new(fwd->ring_size);
+    if (!conn->out) conn->out = ssh2_ring_new(fwd->ring_size);
+    if (!conn->in || !conn->out) return LIBSSH2_ERROR_ALLOC;
+
+    conn_reset_rings(conn);
+    return (int)index;
+}
+
+static void conn_opened(ssh2_forwarder* fwd, uint32_t index, LIBSSH2_CHANNEL* channel) {
+    ssh2_forward_conn* conn = &fwd->conns[index];
+    conn->channel = channel;
+    conn->state = CONN_OPEN;
+    forward_event(fwd, index, SSH2_FORWARD_OPEN, (int)conn->in, (int)conn->out);
+}
+
+static void conn_fail(ssh2_forwarder* fwd, uint32_t index, int error) {
+    ssh2_forward_conn* conn = &fwd->conns[index];
+    conn->in->flags |= SSH2_RING_CLOSED;
+    conn->out->flags |= SSH2_RING_CLOSED;
+    forward_event(fwd, index, SSH2_FORWARD_ERROR, error, 0);
+    conn->state = conn->channel ? CONN_CLOSING : CONN_FREE;
+    if (conn->state == CONN_FREE) conn_release(conn);
+}
+
+// Create a forwarder on session. Each connection gets two rings of
+// ring_size bytes; events go to Module.forwarders[id].event.
+EMSCRIPTEN_KEEPALIVE
+ssh2_forwarder* ssh2_forward_new(LIBSSH2_SESSION* session, int id, size_t ring_size) {
+    if (!session) return NULL;
+
+    ssh2_forwarder* fwd = calloc(1, sizeof(ssh2_forwarder));
+    if (!fwd) return NULL;
+
+    fwd->session = session;
+    fwd->id = id;
+    fwd->ring_size = ring_size ? ring_size : 65536;
+    fwd->opening = -1;
+    return fwd;
+}
+
+// Ask the server to listen on host:port (NULL host for all interfaces, port
+// 0 to let it choose) with up to backlog pending connections. Returns the
+// bound port, LIBSSH2_ERROR_EAGAIN (call again) or another libssh2 error.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_forward_listen(ssh2_forwarder* fwd, const char* host, int port, int backlog) {
+    if (!fwd || fwd->listener) return LIBSSH2_ERROR_BAD_USE;
+
+    int bound_port = 0;
+    fwd->listener = libssh2_channel_forward_listen_ex(fwd->session, host, port, &bound_port,
+                                                      backlog > 0 ? backlog : 16);
+    if (!fwd->listener) return libssh2_session_last_errno(fwd->session);
+
+    // Servers only report the port when it was chosen for us
+    fwd->bound_port = bound_port ? bound_port : port;
+    return fwd->bound_port;
+}
+
+// Queue a direct-tcpip connection to host:port, reported as coming from
+// shost:sport. Returns the connection index; SSH2_FORWARD_OPEN or
+// SSH2_FORWARD_ERROR follows from ssh2_forward_step.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_forward_connect(ssh2_forwarder* fwd, const char* host, int port, const char* shost, int sport) {
+    if (!fwd || !host) return LIBSSH2_ERROR_BAD_USE;
+
+    int index = conn_alloc(fwd);
+    if (index < 0) return index;
+
+    ssh2_forward_conn* conn = &fwd->conns[index];
+    conn->host = strdup(host);
+    conn->shost = strdup(shost && *shost ? shost : "127.0.0.1");
+    if (!conn->host || !conn->shost) {
+        conn_release(conn);
+        return LIBSSH2_ERROR_ALLOC;
+    }
+    conn->port = port;
+    conn->sport = sport ? sport : 22;
+    conn->state = CONN_CONNECTING;
+    return index;
+}
+
+// Close a connection from the local side (socket error or reset). Unsent
+// input is dropped; SSH2_FORWARD_CLOSE follows once the channel is freed.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_forward_close(ssh2_forwarder* fwd, int index) {
+    if (!fwd || index < 0 || (uint32_t)index >= fwd->conn_count) return;
+
+    ssh2_forward_conn* conn = &fwd->conns[index];
+    if (conn->state == CONN_CONNECTING) {
+        // An open libssh2 has started must run to completion, or the next
+        // connection would resume it and get this one's channel
+        if (index == fwd->opening) {
+            conn->state = CONN_ABANDONED;
+        } else {
+            conn_release(conn);
+        }
+    } else if (conn->state == CONN_OPEN) {
+        conn->out->flags |= SSH2_RING_CLOSED;
+        conn->state = CONN_CLOSING;
+    }
+}
+
+// Move the in ring to the channel, writing from the ring's memory directly
+static int pump_in(ssh2_forward_conn* conn) {
+    ssh2_ring* ring = conn->in;
+
+    while (ssh2_ring_used(ring)) {
+        uint32_t offset = ring->tail & (ring->capacity - 1);
+        uint32_t length = ssh2_ring_used(ring);
+        if (length > ring->capacity - offset) length = ring->capacity - offset;
+
+        ssize_t rc = libssh2_channel_write(conn->channel, (const char*)ring->data + offset, length);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        if (rc < 0) return (int)rc;
+        ring->tail += (uint32_t)rc;
+    }
+
+    if ((ring->flags & SSH2_RING_CLOSED) && !conn->eof_sent) {
+        int rc = libssh2_channel_send_eof(conn->channel);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        if (rc < 0) return rc;
+        conn->eof_sent = 1;
+    }
+    return 0;
+}
+
+// Move channel data into the out ring while it has room, reading into the
+// ring's memory directly. Returns 1 once the channel reached EOF.
+static int pump_out(ssh2_forwarder* fwd, uint32_t index) {
+    ssh2_forward_conn* conn = &fwd->conns[index];
+    ssh2_ring* ring = conn->out;
+
+    if (ring->flags & SSH2_RING_CLOSED) return 1;
+
+    while (ssh2_ring_space(ring)) {
+        uint32_t offset = ring->head & (ring->capacity - 1);
+        uint32_t length = ssh2_ring_space(ring);
+        if (length > ring->capacity - offset) length = ring->capacity - offset;
+
+        int was_empty = ssh2_ring_used(ring) == 0;
+        ssize_t rc = libssh2_channel_read(conn->channel, (char*)ring->data + offset, length);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        if (rc < 0) return (int)rc;
+        if (rc == 0) {
+            if (!libssh2_channel_eof(conn->channel)) return 0;
+            // JS learns about EOF the same way as about data
+            ring->flags |= SSH2_RING_CLOSED;
+            if (was_empty) {
+                forward_event(fwd, index, SSH2_FORWARD_DATA, (int)ring, 0);
+            }
+            return 1;
+        }
+
+        ring->head += (uint32_t)rc;
+        if (was_empty) {
+            forward_event(fwd, index, SSH2_FORWARD_DATA, (int)ring, 0);
+        }
+    }
+    return 0;
+}
+
+static void service_conn(ssh2_forwarder* fwd, uint32_t index) {
+    ssh2_forward_conn* conn = &fwd->conns[index];
+
+    // JS already forgot this connection, so its channel goes without events
+    if (conn->state == CONN_ABANDONED) {
+        if (conn->channel && libssh2_channel_free(conn->channel) != LIBSSH2_ERROR_EAGAIN) {
+            conn_release(conn);
+        }
+        return;
+    }
+
+    if (conn->state == CONN_OPEN) {
+        int rc = pump_in(conn);
+        int eof = rc < 0 ? rc : pump_out(fwd, index);
+        if (eof < 0) {
+            conn_fail(fwd, index, eof);
+            return;
+        }
+        // Both directions finished; a half-closed connection stays open
+        if (eof && conn->eof_sent) {
+            conn->state = CONN_CLOSING;
+        }
+    }
+
+    if (conn->state == CONN_CLOSING) {
+        if (libssh2_channel_free(conn->channel) == LIBSSH2_ERROR_EAGAIN) return;
+        conn_release(conn);
+        forward_event(fwd, index, SSH2_FORWARD_CLOSE, 0, 0);
+    }
+}
+
+// Accept queued remote connections, open pending direct-tcpip channels and
+// move data for every connection. Runs non-blocking regardless of the
+// session's mode. Returns the number of live connections or a libssh2
+// error from the listener.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_forward_step(ssh2_forwarder* fwd) {
+    if (!fwd) return LIBSSH2_ERROR_BAD_USE;
+
+    int blocking = libssh2_session_get_blocking(fwd->session);
+    libssh2_session_set_blocking(fwd->session, 0);
+    int rc = 0;
+
+    while (fwd->listener) {
+        LIBSSH2_CHANNEL* channel = libssh2_channel_forward_accept(fwd->listener);
+        if (!channel) {
+            int error = libssh2_session_last_errno(fwd->session);
+            if (error != LIBSSH2_ERROR_EAGAIN) rc = error;
+            break;
+        }
+
+        int index = conn_alloc(fwd);
+        if (index < 0) {
+            libssh2_channel_free(channel);
+            rc = index;
+            break;
+        }
+        conn_opened(fwd, (uint32_t)index, channel);
+    }
+
+    // libssh2 tracks one direct-tcpip open per session and resumes it on the
+    // next call whatever the arguments, so the slot it was started for goes
+    // first until it completes
+    for (;;) {
+        int index = fwd->opening;
+        for (uint32_t i = 0; index < 0 && i < fwd->conn_count; i++) {
+            if (fwd->conns[i].state == CONN_CONNECTING) index = (int)i;
+        }
+        if (index < 0) break;
+
+        ssh2_forward_conn* conn = &fwd->conns[index];
+        LIBSSH2_CHANNEL* channel = libssh2_channel_direct_tcpip_ex(fwd->session, conn->host, conn->port,
+                                                                   conn->shost, conn->sport);
+        int error = channel ? 0 : libssh2_session_last_errno(fwd->session);
+        if (error == LIBSSH2_ERROR_EAGAIN) {
+            fwd->opening = index;
+            break;
+        }
+        fwd->opening = -1;
+
+        if (conn->state == CONN_ABANDONED) {
+            // service_conn frees the channel; a failed open has nothing to free
+            conn->channel = channel;
+            if (!channel) conn_release(conn);
+        } else if (channel) {
+            conn_opened(fwd, (uint32_t)index, channel);
+        } else {
+            conn_fail(fwd, (uint32_t)index, error);
+        }
+    }
+
+    int live = 0;
+    for (uint32_t index = 0; index < fwd->conn_count; index++) {
+        service_conn(fwd, index);
+        if (fwd->conns[index].state != CONN_FREE) live++;
+    }
+
+    libssh2_session_set_blocking(fwd->session, blocking);
+    return rc < 0 ? rc : live;
+}
+
+// Port the listener is bound to, 0 without a listener
+EMSCRIPTEN_KEEPALIVE
+int ssh2_forward_bound_port(ssh2_forwarder* fwd) {
+    return fwd ? fwd->bound_port : 0;
+}
+
+// Free every channel, the listener and all rings. Call from a blocking
+// session, or after ssh2_forward_step has closed every connection.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_forward_free(ssh2_forwarder* fwd) {
+    if (!fwd) return;
+
+    for (uint32_t index = 0; index < fwd->conn_count; index++) {
+        ssh2_forward_conn* conn = &fwd->conns[index];
+        if (conn->channel) {
+            libssh2_channel_free(conn->channel);
+        }
+        conn_release(conn);
+        ssh2_ring_free(conn->in);
+        ssh2_ring_free(conn->out);
+    }
+    if (fwd->listener) {
+        libssh2_channel_forward_cancel(fwd->listener);
+    }
+    free(fwd->conns);
+    free(fwd);
+}
@@ -0,0 +1,241 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Session Heap
+// =====================================
+
+// Allocator handed to libssh2_session_init_ex by ssh2_session_create_ex.
+// Requests up to HEAP_SLAB_SIZE bytes are served from per-session size
+// classes carved out of 64 KiB slabs, so a session's packet buffers are
+// recycled within its own slabs instead of interleaving with every other
+// session's in the shared heap. Slabs are only returned when the session
+// is freed; larger requests go straight to malloc. Each block carries an
+// 8-byte header recording its class and requested size, so live bytes are
+// exact and realloc can stay in place while the block still fits.
+//
+// Only memory libssh2 allocates through the session is covered. OpenSSL
+// keeps its own allocations, and the rings and channel table are sized once
+// at creation.
+
+#define HEAP_SLAB_SIZE 65536
+#define HEAP_MIN_SHIFT 5     // Smallest block: 32 bytes including the header
+#define HEAP_CLASSES 12      // 32 B ... 64 KiB
+#define HEAP_LARGE 0xffffffffu
+
+typedef struct heap_block {
+    uint32_t size_class;     // Index into free lists, HEAP_LARGE for malloc'd blocks
+    uint32_t length;         // Bytes requested by libssh2
+} heap_block;
+
+typedef struct heap_free {
+    struct heap_free* next;
+} heap_free;
+
+// Padded to 8 bytes so blocks after it keep malloc's alignment
+typedef struct heap_slab {
+    struct heap_slab* next;
+    uint32_t padding;
+} heap_slab;
+
+struct ssh2_heap {
+    heap_free* free_lists[HEAP_CLASSES];
+    heap_slab* slabs;
+    ssh2_heap_stats stats;
+};
+
+static uint32_t class_size(uint32_t size_class) {
+    return 1u << (size_class + HEAP_MIN_SHIFT);
+}
+
+static uint32_t class_for(size_t total) {
+    uint32_t size_class = 0;
+    while (class_size(size_class) < total) {
+        size_class++;
+    }
+    return size_class;
+}
+
+// Carve a new slab into blocks of one class. Classes at the slab size get
+// a slab per block.
+static int heap_refill(ssh2_heap* heap, uint32_t size_class) {
+    size_t block_size = class_size(size_class);
+    size_t slab_size = sizeof(heap_slab) + (block_size > HEAP_SLAB_SIZE ? block_size : HEAP_SLAB_SIZE);
+
+    heap_slab* slab = malloc(slab_size);
+    if (!slab) return -1;
+    slab->next = heap->slabs;
+    heap->slabs = slab;
+    heap->stats.reserved += (uint32_t)slab_size;
+
+    for (size_t offset = sizeof(heap_slab); offset + block_size <= slab_size; offset += block_size) {
+        heap_free* block = (heap_free*)((uint8_t*)slab + offset);
+        block->next = heap->free_lists[size_class];
+        heap->free_lists[size_class] = block;
+    }
+    return 0;
+}
+
+static void heap_account(ssh2_heap* heap, size_t freed, size_t added) {
+    heap->stats.live = heap->stats.live - (uint32_t)freed + (uint32_t)added;
+    if (heap->stats.live > heap->stats.high_water) {
+        heap->stats.high_water = heap->stats.live;
+    }
+}
+
+static int heap_over_cap(ssh2_heap* heap, size_t freed, size_t added) {
+    if (!heap->stats.cap || added <= freed) return 0;
+    if ((size_t)heap->stats.live - freed + added <= heap->stats.cap) return 0;
+    heap->stats.cap_failures++;
+    return 1;
+}
+
+static void* heap_alloc(ssh2_heap* heap, size_t length) {
+    if (length > UINT32_MAX - sizeof(heap_block) || heap_over_cap(heap, 0, length)) return NULL;
+
+    size_t total = length + sizeof(heap_block);
+    heap_block* block;
+    if (total > HEAP_SLAB_SIZE) {
+        block = malloc(total);
+        if (!block) return NULL;
+        block->size_class = HEAP_LARGE;
+        heap->stats.reserved += (uint32_t)total;
+    } else {
+        uint32_t size_class = class_for(total);
+        if (!heap->free_lists[size_class] && heap_refill(heap, size_class) < 0) return NULL;
+        block = (heap_block*)heap->free_lists[size_class];
+        heap->free_lists[size_class] = ((heap_free*)block)->next;
+        block->size_class = size_class;
+    }
+
+    block->length = (uint32_t)length;
+    heap_account(heap, 0, length);
+    return block + 1;
+}
+
+static void heap_release(ssh2_heap* heap, void* ptr) {
+    if (!ptr) return;
+
+    heap_block* block = (heap_block*)ptr - 1;
+    heap_account(heap, block->length, 0);
+    if (block->size_class == HEAP_LARGE) {
+        heap->stats.reserved -= block->length + (uint32_t)sizeof(heap_block);
+        free(block);
+        return;
+    }
+
+    uint32_t size_class = block->size_class;
+    heap_free* entry = (heap_free*)block;
+    entry->next = heap->free_lists[size_class];
+    heap->free_lists[size_class] = entry;
+}
+
+static void* heap_resize(ssh2_heap* heap, void* ptr, size_t length) {
+    if (!ptr) return heap_alloc(heap, length);
+
+    heap_block* block = (heap_block*)ptr - 1;
+    size_t old_length = block->length;
+
+    // Shrinking, or growing within the block's class, stays in place
+    if (block->size_class != HEAP_LARGE && length + sizeof(heap_block) <= class_size(block->size_class)) {
+        if (heap_over_cap(heap, old_length, length)) return NULL;
+        block->length = (uint32_t)length;
+        heap_account(heap, old_length, length);
+        return ptr;
+    }
+
+    if (heap_over_cap(heap, old_length, length)) return NULL;
+    void* moved = heap_alloc(heap, length);
+    if (!moved) return NULL;
+    memcpy(moved, ptr, old_length < length ? old_length : length);
+    heap_release(heap, ptr);
+    return moved;
+}
+
+// =====================================
+// libssh2 Allocator Callbacks
+// =====================================
+
+// abstract is the session's abstract pointer, which holds its ssh2_session_ctx
+static LIBSSH2_ALLOC_FUNC(session_alloc) {
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    return heap_alloc(ctx->heap, count);
+}
+
+static LIBSSH2_REALLOC_FUNC(session_realloc) {
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    return heap_resize(ctx->heap, ptr, count);
+}
+
+static LIBSSH2_FREE_FUNC(session_free) {
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    heap_release(ctx->heap, ptr);
+}
+
+ssh2_heap* ssh2_heap_new(size_t cap) {
+    ssh2_heap* heap = calloc(1, sizeof(ssh2_heap));
+    if (heap) {
+        heap->stats.cap = (uint32_t)cap;
+    }
+    return heap;
+}
+
+// Release every slab. Only call once libssh2 has freed the session.
+void ssh2_heap_free(ssh2_heap* heap) {
+    if (!heap) return;
+
+    heap_slab* slab = heap->slabs;
+    while (slab) {
+        heap_slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(heap);
+}
+
+LIBSSH2_SESSION* ssh2_heap_session_init(ssh2_session_ctx* ctx) {
+    return libssh2_session_init_ex(session_alloc, session_free, session_realloc, ctx);
+}
+
+// Allocate a buffer that libssh2 will free itself (e.g. a signature handed
+// back from a sign callback), from the session's heap when it has one
+void* ssh2_session_alloc(ssh2_session_ctx* ctx, size_t length) {
+    return ctx && ctx->heap ? heap_alloc(ctx->heap, length) : malloc(length);
+}
+
+// =====================================
+// Session Heap API
+// =====================================
+
+// Copy the session's memory counters into out. Returns LIBSSH2_ERROR_BAD_USE
+// for sessions created without a heap (ssh2_session_create/init).
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_memory(LIBSSH2_SESSION* session, ssh2_heap_stats* out) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || !ctx->heap || !out) return LIBSSH2_ERROR_BAD_USE;
+    memcpy(out, &ctx->heap->stats, sizeof(ssh2_heap_stats));
+    return 0;
+}
+
+// Change the cap on live bytes (0 removes it). Memory already allocated is
+// kept; allocations that would exceed the cap fail with LIBSSH2_ERROR_ALLOC.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_memory_cap(LIBSSH2_SESSION* session, size_t cap) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || !ctx->heap) return LIBSSH2_ERROR_BAD_USE;
+    ctx->heap->stats.cap = (uint32_t)cap;
+    return 0;
+}
+
+// Reset the high-water mark to the current live bytes
+EMSCRIPTEN_KEEPALIVE
+void ssh2_session_memory_reset_peak(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (ctx && ctx->heap) {
+        ctx->heap->stats.high_water = ctx->heap->stats.live;
+    }
+}
@@ -0,0 +1,471 @@
+#ifndef SSH2_INTERNAL_H
+#define SSH2_INTERNAL_H
+
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// =====================================
+// Transport
+// =====================================
+
+// Transport modes
+#define SSH2_TRANSPORT_CALLBACK 0 // Module.customSend/customRecv per call
+#define SSH2_TRANSPORT_RING     1 // TX/RX rings in linear memory
+
+// Ring flags
+#define SSH2_RING_CLOSED 0x1 // Producer is gone, reader sees EOF once drained
+
+// Single-producer/single-consumer byte ring living in WASM linear memory.
+// JS reads and writes these fields directly through HEAPU32, so the layout
+// is part of the public contract (see src/js/transport.js):
+//   [0] data  [1] capacity  [2] head  [3] tail  [4] flags
+// head and tail are free-running byte counters; capacity is a power of two.
+typedef struct ssh2_ring {
+    uint8_t* data;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t flags;
+} ssh2_ring;
+
+// =====================================
+// Channel Registry
+// =====================================
+
+// Channel event flags reported by ssh2_session_pump
+#define SSH2_EVENT_READABLE    0x01 // stdout data queued
+#define SSH2_EVENT_STDERR      0x02 // extended data may be queued
+#define SSH2_EVENT_WRITABLE    0x04 // remote window reopened
+#define SSH2_EVENT_EOF         0x08 // remote sent EOF and all data was read
+#define SSH2_EVENT_CLOSED      0x10 // remote closed the channel
+#define SSH2_EVENT_EXIT_STATUS 0x20 // exit_status field is valid
+
+// One pump event, read by JS through HEAP32 (16 bytes)
+typedef struct ssh2_channel_event {
+    uint32_t id;
+    uint32_t flags;
+    int32_t exit_status;
+    uint32_t write_window;
+} ssh2_channel_event;
+
+// Header of one ssh2_channel_read_batch record, followed by length payload
+// bytes and padding up to the next 4-byte boundary (12 bytes)
+typedef struct ssh2_read_record {
+    uint32_t id;
+    uint32_t stream;
+    uint32_t length;
+} ssh2_read_record;
+
+// ssh2_read_record stream of a channel whose read failed; the payload is the
+// libssh2 error as an int32
+#define SSH2_READ_ERROR 0xffffffffu
+
+// A channel registered with its session; id is the index in the table
+typedef struct ssh2_channel_entry {
+    LIBSSH2_CHANNEL* channel;
+    uint32_t reported;     // Edge events already delivered (EOF/CLOSED)
+    uint32_t last_window;  // Remote window at the previous pump
+    uint32_t window_stalls; // Times the remote window was seen to close
+    uint32_t tune_max;     // Receive window ceiling, 0 when auto-tuning is off
+    uint32_t tune_target;  // Receive window the pump keeps open
+    uint32_t tune_window;  // Receive window after the previous tune step
+    uint32_t tune_pending; // Adjust that returned EAGAIN and must be resent
+    int tune_starved;      // An adjust went out while the window was nearly shut
+    double tune_rate;      // Smoothed receive rate, bytes/ms
+    double tune_rtt;       // Smoothed adjust-to-data delay, ms
+    double tune_mark;      // Time of the previous tune step
+    double tune_adjusted;  // Time the starved adjust was sent
+} ssh2_channel_entry;
+
+// =====================================
+// Exec Pool
+// =====================================
+
+// Exec result flags
+#define SSH2_EXEC_TRUNCATED 0x1 // Output past the pool's max_output was dropped
+#define SSH2_EXEC_SIGNALED  0x2 // Command was killed by a signal
+
+// One completed command from ssh2_exec_pool_next, read by JS (32 bytes).
+// out/err point at the captured stdout/stderr, owned by the pool.
+typedef struct ssh2_exec_result {
+    int32_t job;
+    int32_t error;        // libssh2 error that ended the command, or 0
+    int32_t exit_status;
+    uint32_t flags;
+    uint8_t* out;
+    uint32_t out_length;
+    uint8_t* err;
+    uint32_t err_length;
+} ssh2_exec_result;
+
+// =====================================
+// Session Stats
+// =====================================
+
+// Per-session counters, read by JS as a Float64Array (16 doubles) so byte
+// counts stay exact past 4 GiB. Times are milliseconds and only advance
+// while timing is enabled with ssh2_session_stats_timing. codec_ms is time
+// inside libssh2's packet layer (cipher, MAC, compression) minus the JS
+// callbacks it made; kex_ms overlaps it. The coalesced_writes and flush_*
+// counters only move while transmit coalescing is on; send_calls then
+// counts the frames the flushes produced.
+typedef struct ssh2_stats {
+    double bytes_in;
+    double bytes_out;
+    double packets_in;
+    double packets_out;
+    double recv_calls;
+    double send_calls;
+    double recv_eagain;
+    double send_eagain;
+    double kex_count;
+    double kex_ms;
+    double codec_ms;
+    double callback_ms;
+    double window_stalls;
+    double coalesced_writes;  // libssh2 send callbacks absorbed by the buffer
+    double flushes;           // Flushes that wrote at least one byte
+    double flush_bytes;
+} ssh2_stats;
+
+// =====================================
+// Session Heap
+// =====================================
+
+// Memory counters of a session created with ssh2_session_create_ex, read by
+// JS through HEAPU32 (20 bytes). live and high_water count bytes requested
+// by libssh2; reserved is what the heap holds from malloc (slabs plus large
+// blocks); cap_failures counts allocations refused by the cap.
+typedef struct ssh2_heap_stats {
+    uint32_t live;
+    uint32_t high_water;
+    uint32_t reserved;
+    uint32_t cap;             // 0 for no cap
+    uint32_t cap_failures;
+} ssh2_heap_stats;
+
+typedef struct ssh2_heap ssh2_heap;
+
+// =====================================
+// Session Trace
+// =====================================
+
+#define SSH2_TRACE_PACKET_IN     1  // detail: message type, bytes: transport bytes read
+#define SSH2_TRACE_PACKET_OUT    2  // detail: message type, bytes: payload length
+#define SSH2_TRACE_KEX_BEGIN     3  // detail: 1 for a re-key
+#define SSH2_TRACE_KEX_END       4  // code: result of the exchange
+#define SSH2_TRACE_WINDOW_ADJUST 5  // channel: recipient, bytes: window added
+#define SSH2_TRACE_WINDOW_STALL  6  // channel: registered id
+#define SSH2_TRACE_RECV_EAGAIN   7
+#define SSH2_TRACE_SEND_EAGAIN   8
+#define SSH2_TRACE_ERROR         9  // detail: message type, code: libssh2 error
+
+// One fixed-size event, decoded by JS at 24-byte strides. channel is -1
+// for events not tied to a channel; for channel messages it is the
+// recipient channel number carried in the packet.
+typedef struct ssh2_trace_event {
+    double time;              // emscripten_get_now(), ms
+    uint16_t type;
+    uint16_t detail;
+    int32_t channel;
+    uint32_t bytes;
+    int32_t code;
+} ssh2_trace_event;
+
+// Ring of the most recent events. capacity is a power of two; once full
+// the oldest event is overwritten. recorded counts every event since the
+// ring was enabled or cleared, so recorded - capacity were dropped.
+typedef struct ssh2_trace {
+    uint32_t capacity;
+    uint32_t next;            // Slot of the next event
+    uint32_t in_kex;          // A KEX_BEGIN awaits its KEX_END
+    uint32_t reserved;
+    double recorded;
+    ssh2_trace_event events[];
+} ssh2_trace;
+
+// =====================================
+// Session Context
+// =====================================
+
+// Transmit coalescing for callback transports (ssh2_session_coalesce):
+// send callback output collects here and goes to the JS transport as one
+// call when the buffer fills, when the oldest byte is older than delay_ms,
+// before every receive, and from a microtask once the current JS task's
+// libssh2 calls have returned.
+typedef struct ssh2_coalesce {
+    uint8_t* data;
+    uint32_t length;
+    uint32_t capacity;        // Flush threshold in bytes
+    double delay_ms;          // 0 to rely on the other flush points
+    double first_ms;          // Arrival of the oldest buffered byte
+    int scheduled;            // Module.scheduleFlush already queued
+    int error;                // Send error hit by a deferred flush
+} ssh2_coalesce;
+
+// Per-session state, stored in libssh2's session abstract pointer.
+// handle is the session's slot in Module.transports; 0 means the legacy
+// module-wide Module.customSend/customRecv/onTransmit hooks.
+typedef struct ssh2_session_ctx {
+    LIBSSH2_SESSION* session;
+    int transport;
+    int handle;
+    ssh2_ring* rx;
+    ssh2_ring* tx;
+    ssh2_channel_entry* channels;
+    uint32_t channel_count;
+    ssh2_stats stats;
+    int timing;             // Sample emscripten_get_now for the *_ms stats
+    int codec_depth;        // Nesting of wrapped transport calls
+    double codec_start;
+    double codec_callback_mark;
+    ssh2_heap* heap;        // Pooled allocator, NULL for the default malloc
+    ssh2_trace* trace;      // Binary event ring, NULL while tracing is off
+    ssh2_coalesce* coalesce; // Transmit buffer, NULL while coalescing is off
+} ssh2_session_ctx;
+
+ssh2_ring* ssh2_ring_new(size_t capacity);
+void ssh2_ring_free(ssh2_ring* ring);
+uint32_t ssh2_ring_used(const ssh2_ring* ring);
+uint32_t ssh2_ring_space(const ssh2_ring* ring);
+size_t ssh2_ring_write(ssh2_ring* ring, const void* src, size_t len);
+size_t ssh2_ring_read(ssh2_ring* ring, void* dst, size_t len);
+
+// Send through the coalescing buffer of a callback transport session, and
+// write out whatever it holds: 0 once empty, -EAGAIN if bytes remain
+ssize_t ssh2_coalesce_write(ssh2_session_ctx* ctx, const void* buffer, size_t length);
+int ssh2_coalesce_flush(ssh2_session_ctx* ctx);
+
+// Transport callbacks for Module.customSend/customRecv (src/libssh2-bindings.c)
+int custom_send(libssh2_socket_t socket, const void* buffer, size_t length, int flags, void** abstract);
+int custom_recv(libssh2_socket_t socket, void* buffer, size_t length, int flags, void** abstract);
+
+#ifdef SSH2_ASYNC
+// Async builds: receive through the JS transport behind handle (0 for
+// Module.customRecv), suspending until data arrives only while the session
+// is blocking
+ssize_t ssh2_async_recv(ssh2_session_ctx* ctx, int handle, void* buffer, size_t length);
+#endif
+
+// =====================================
+// Port Forwarding
+// =====================================
+
+// Forwarder events, delivered to Module.forwarders[id].event(conn, kind, a, b)
+#define SSH2_FORWARD_OPEN     1 // Channel is up: a = in ring, b = out ring
+#define SSH2_FORWARD_DATA     2 // Out ring went from empty to non-empty, or closed while empty
+#define SSH2_FORWARD_CLOSE    3 // Channel freed; drain the out ring, then drop the endpoint
+#define SSH2_FORWARD_ERROR    4 // a = libssh2 error; the connection is closed
+
+// One forwarded connection. Its endpoint is a ring pair: JS writes socket
+// data into `in` and closes it at socket EOF; the forwarder writes channel
+// data into `out` and closes it at channel EOF. Rings stay with the slot
+// and are reused by the next connection.
+typedef struct ssh2_forward_conn {
+    LIBSSH2_CHANNEL* channel;
+    ssh2_ring* in;
+    ssh2_ring* out;
+    int state;
+    int eof_sent;           // in ring finished and EOF sent on the channel
+    char* host;             // Pending direct-tcpip open
+    int port;
+    char* shost;
+    int sport;
+} ssh2_forward_conn;
+
+typedef struct ssh2_forwarder {
+    LIBSSH2_SESSION* session;
+    LIBSSH2_LISTENER* listener;
+    int id;                 // Slot in Module.forwarders
+    int bound_port;
+    size_t ring_size;
+    ssh2_forward_conn* conns;
+    uint32_t conn_count;
+    int opening;            // Slot whose direct-tcpip open is in flight, -1 if none
+} ssh2_forwarder;
+
+// =====================================
+// SFTP
+// =====================================
+
+// Fixed-width SFTP attributes as packed for JS (32 bytes)
+typedef struct ssh2_packed_attrs {
+    uint32_t flags;
+    uint32_t permissions;
+    uint64_t filesize;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t atime;
+    uint32_t mtime;
+} ssh2_packed_attrs;
+
+// Header of one ssh2_sftp_readdir_batch record (40 bytes), followed by the
+// name and longentry bytes (not NUL-terminated) and padding to 8 bytes
+typedef struct ssh2_dirent {
+    uint32_t length;          // Whole record, including padding
+    uint16_t name_length;
+    uint16_t longentry_length;
+    ssh2_packed_attrs attrs;
+} ssh2_dirent;
+
+// One ssh2_sftp_batch_stat result (40 bytes): status is 0 or the server's
+// SSH_FX_* code, attrs are only filled in for 0
+typedef struct ssh2_stat_result {
+    int32_t status;
+    uint32_t reserved;
+    ssh2_packed_attrs attrs;
+} ssh2_stat_result;
+
+// Metadata cache lookups (src/ssh2-sftp-cache.c)
+#define SSH2_CACHE_STAT     0 // LIBSSH2_SFTP_STAT
+#define SSH2_CACHE_LSTAT    1 // LIBSSH2_SFTP_LSTAT
+#define SSH2_CACHE_READLINK 2
+#define SSH2_CACHE_REALPATH 3
+
+// Tree walk delta kinds
+#define SSH2_DELTA_NEW     1 // Remote entry missing from the manifest
+#define SSH2_DELTA_CHANGED 2 // Size or mtime differs from the manifest
+#define SSH2_DELTA_DELETED 3 // Manifest entry not found remotely
+#define SSH2_DELTA_UNKNOWN 4 // Manifest entry under a directory that could not be fully listed
+
+// ssh2_sftp_walk_delta_status of a delta that was not (or not yet)
+// downloaded; 0 means downloaded in full, a negative libssh2 error that the
+// download failed and the sink may hold part of the file
+#define SSH2_WALK_NOT_DOWNLOADED 1
+
+// Header of one tree walk delta record (24 bytes), followed by the path
+// relative to the walk root (not NUL-terminated) and padding to 8 bytes
+typedef struct ssh2_walk_delta {
+    uint32_t length;          // Whole record, including padding
+    uint8_t kind;
+    uint8_t is_dir;
+    uint16_t path_length;
+    uint32_t permissions;
+    uint32_t mtime;
+    uint64_t filesize;
+} ssh2_walk_delta;
+
+#define SSH2_TRANSFER_GET 0
+#define SSH2_TRANSFER_PUT 1
+
+// Streaming get/put over one SFTP handle (see src/ssh2-sftp-transfer.c)
+typedef struct ssh2_sftp_transfer {
+    LIBSSH2_SFTP_HANDLE* handle;
+    int direction;
+    int id;                   // Slot in Module.sftpTransfers
+    int tag;                  // Passed through to the sink, -1 if unused
+    libssh2_uint64_t offset;  // GET: next byte for the sink, PUT: next byte acked
+    libssh2_uint64_t end;     // GET: stop here (0 = until EOF)
+    uint8_t* buffer;
+    size_t capacity;
+    size_t staged;            // PUT: bytes from the source not yet acked
+    int source_done;          // PUT: source returned end of input
+    int done;
+} ssh2_sftp_transfer;
+
+typedef struct ssh2_sftp_cache ssh2_sftp_cache;
+
+// The cache attached to sftp by ssh2_sftp_cache_enable, or NULL
+ssh2_sftp_cache* ssh2_sftp_cache_get(LIBSSH2_SFTP* sftp);
+int ssh2_sftp_cache_attrs(ssh2_sftp_cache* cache, int kind, const char* path, LIBSSH2_SFTP_ATTRIBUTES* attrs);
+void ssh2_sftp_cache_put_attrs(ssh2_sftp_cache* cache, int kind, const char* path,
+                               const LIBSSH2_SFTP_ATTRIBUTES* attrs);
+
+// Cached stat/lstat and readlink/realpath, with libssh2's return values
+int ssh2_sftp_cached_stat(LIBSSH2_SFTP* sftp, const char* path, int type, LIBSSH2_SFTP_ATTRIBUTES* attrs);
+int ssh2_sftp_cached_link(LIBSSH2_SFTP* sftp, const char* path, char* target, unsigned int maxlen, int type);
+
+// Forget what is cached for path, its descendants and its parent
+void ssh2_sftp_cache_invalidate(LIBSSH2_SFTP* sftp, const char* path);
+void ssh2_sftp_cache_drop(LIBSSH2_SFTP* sftp);
+
+ssh2_sftp_transfer* ssh2_sftp_get_file(LIBSSH2_SFTP_HANDLE* handle, int id,
+                                       libssh2_uint64_t offset, libssh2_uint64_t length,
+                                       size_t buffer_size);
+int ssh2_sftp_transfer_step(ssh2_sftp_transfer* transfer);
+void ssh2_sftp_transfer_free(ssh2_sftp_transfer* transfer);
+
+void ssh2_sftp_pack_attrs(ssh2_packed_attrs* out, const LIBSSH2_SFTP_ATTRIBUTES* attrs);
+
+// Drop the entry ssh2_sftp_readdir_batch held back for handle (on close)
+void ssh2_sftp_dir_forget(LIBSSH2_SFTP_HANDLE* handle);
+
+// =====================================
+// SCP
+// =====================================
+
+// Fixed set of equal-sized heap buffers for streaming transfers. A chunk
+// handed to a JS sink stays out of the pool until ssh2_chunk_release.
+typedef struct ssh2_chunk_pool {
+    uint8_t* data;
+    uint32_t chunk_size;
+    uint32_t count;
+    uint32_t free_count;
+    uint32_t* free;           // Stack of free chunk indices
+} ssh2_chunk_pool;
+
+// Streaming SCP download/upload over one channel (see src/ssh2-scp.c)
+typedef struct ssh2_scp_transfer {
+    LIBSSH2_SESSION* session;
+    LIBSSH2_CHANNEL* channel;
+    ssh2_chunk_pool* pool;
+    char* path;
+    int direction;            // SSH2_TRANSFER_GET or SSH2_TRANSFER_PUT
+    int id;                   // Slot in Module.scpTransfers
+    int state;
+    int mode;
+    libssh2_uint64_t size;    // File size from (GET) or for (PUT) the SCP header
+    libssh2_uint64_t offset;  // GET: bytes passed to the sink, PUT: bytes written
+    time_t mtime;
+    time_t atime;
+    uint8_t* chunk;           // Chunk being filled (GET) or written (PUT)
+    size_t chunk_length;      // Bytes read into / staged in the chunk
+    size_t chunk_sent;        // PUT: bytes of the chunk already written
+    int source_done;          // PUT: source returned end of input
+} ssh2_scp_transfer;
+
+// =====================================
+// Private Keys
+// =====================================
+
+// A private key parsed (and decrypted) once, for ssh2_userauth_publickey_key
+// to sign with from any number of sessions. pkey is an OpenSSL EVP_PKEY;
+// public_blob is the key in SSH wire format, as sent in auth requests.
+// Encrypted openssh-key-v1 keys have no pkey: OpenSSL lacks bcrypt_pbkdf, so
+// pem and passphrase are kept for libssh2 to decrypt at authentication.
+typedef struct ssh2_key {
+    void* pkey;
+    const char* algorithm;    // ssh-rsa, ssh-ed25519, ecdsa-sha2-nistp256, ...
+    const void* digest;       // EVP_MD for ECDSA, chosen per request for RSA
+    unsigned char* public_blob;
+    size_t public_length;
+    char* pem;
+    size_t pem_length;
+    char* passphrase;
+} ssh2_key;
+
+uint8_t* ssh2_chunk_acquire(ssh2_chunk_pool* pool);
+void ssh2_chunk_release(ssh2_chunk_pool* pool, uint8_t* chunk);
+
+// Record one transport callback; start is 0 unless timing was sampled
+void ssh2_stats_send(ssh2_session_ctx* ctx, ssize_t rc, double start);
+void ssh2_stats_recv(ssh2_session_ctx* ctx, ssize_t rc, double start);
+
+// Append one event to ctx->trace; callers check ctx->trace first so a
+// session without a ring pays a single branch
+void ssh2_trace_record(ssh2_session_ctx* ctx, int type, int detail, int channel, uint32_t bytes, int code);
+
+ssh2_channel_entry* ssh2_channel_entry_get(ssh2_session_ctx* ctx, int id);
+
+ssh2_heap* ssh2_heap_new(size_t cap);
+void ssh2_heap_free(ssh2_heap* heap);
+LIBSSH2_SESSION* ssh2_heap_session_init(ssh2_session_ctx* ctx);
+void* ssh2_session_alloc(ssh2_session_ctx* ctx, size_t length);
+
+ssh2_session_ctx* ssh2_session_ctx_new(int handle, int transport, size_t rx_size, size_t tx_size);
+ssh2_session_ctx* ssh2_session_get_ctx(LIBSSH2_SESSION* session);
+void ssh2_session_ctx_free(ssh2_session_ctx* ctx);
+
+#endif // SSH2_INTERNAL_H
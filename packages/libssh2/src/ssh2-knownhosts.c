@@ -0,0 +1,682 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Known Hosts Store
+// =====================================
+
+// In-memory replacement for libssh2's knownhost list, which scans every
+// entry on each check and only loads through the filesystem. Entries are
+// indexed by exact host name and key type, so checking a host is one hash
+// lookup regardless of how many hosts are known.
+//
+// Hashed entries (|1|salt|hash, HashKnownHosts) cannot be indexed by name
+// up front: matching one means computing HMAC-SHA1(salt, host). They are
+// grouped by salt, so a host costs one HMAC per distinct salt the first
+// time it is checked; the entries it matched are then added to the name
+// index and later checks are a single lookup again. Entries are never
+// removed, so adding a hashed entry leaves those results valid: a host
+// checked again afterwards is only matched against the salts of the entries
+// added since its last check. Wildcard and negated
+// patterns, and @revoked lines, are kept in short lists matched linearly.
+
+#define KNOWNHOST_SHA1_LENGTH 20
+#define KNOWNHOST_SALT_MAX 64
+#define KNOWNHOST_NAME_MAX 1100  // "[" + 1024-byte host + "]:" + port
+
+typedef struct knownhost_key {
+    uint8_t* blob;          // Public key as sent by the server
+    size_t blob_length;
+    const char* type;       // Key type name, points into type_buffer
+    char type_buffer[64];
+} knownhost_key;
+
+typedef struct knownhost_entry {
+    struct knownhost_entry* next;   // In its pattern, revoked or salt list
+    knownhost_key key;
+    char* patterns;                 // Host field, only for pattern and revoked entries
+    uint8_t hash[KNOWNHOST_SHA1_LENGTH]; // Hashed entries only
+    uint32_t sequence;              // Hashed entries: position in the order added, from 1
+} knownhost_entry;
+
+// Exact (host, key type) index node. entry is NULL for the marker recording
+// that hashed entries were already resolved for this host.
+typedef struct knownhost_node {
+    struct knownhost_node* next;
+    uint32_t hash;
+    knownhost_entry* entry;
+    uint32_t resolved;              // Markers: hashed entries already matched, by sequence
+    uint16_t name_length;
+    char name[];                    // "host\0keytype"
+} knownhost_node;
+
+typedef struct knownhost_salt {
+    struct knownhost_salt* next;
+    uint8_t salt[KNOWNHOST_SALT_MAX];
+    size_t salt_length;
+    knownhost_entry* entries;       // Newest first
+} knownhost_salt;
+
+typedef struct ssh2_knownhosts {
+    knownhost_node** buckets;
+    uint32_t bucket_count;          // Power of two
+    uint32_t node_count;
+
+    knownhost_entry* patterns;      // Wildcard or negated host patterns
+    knownhost_entry* revoked;       // @revoked lines
+    knownhost_salt* salts;          // Hashed entries grouped by salt
+    knownhost_entry* owned;         // Entries only reachable through the index
+    uint32_t hashed_count;          // Hashed entries added, the newest one's sequence
+    uint32_t entry_count;
+
+    // Every line loaded or added, written back verbatim by writefile
+    char** lines;
+    size_t line_count;
+    size_t line_capacity;
+} ssh2_knownhosts;
+
+static uint32_t knownhost_hash(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Glob match with * and ? (OpenSSH match_pattern)
+static int pattern_match(const char* s, const char* pattern, size_t pattern_length) {
+    for (size_t i = 0; i < pattern_length; i++) {
+        if (pattern[i] == '*') {
+            for (const char* p = s; ; p++) {
+                if (pattern_match(p, pattern + i + 1, pattern_length - i - 1)) return 1;
+                if (!*p) return 0;
+            }
+        }
+        if (!*s) return 0;
+        if (pattern[i] != '?' && tolower((unsigned char)pattern[i]) != *s) return 0;
+        s++;
+    }
+    return *s == '\0';
+}
+
+// Match a comma-separated pattern list: any positive match and no negated one
+static int pattern_list_match(const char* host, const char* list) {
+    int matched = 0;
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        int negated = *list == '!';
+        if (pattern_match(host, list + negated, length - negated)) {
+            if (negated) return 0;
+            matched = 1;
+        }
+        list += length + (list[length] == ',');
+    }
+    return matched;
+}
+
+static int has_wildcards(const char* pattern, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '!') return 1;
+    }
+    return 0;
+}
+
+// Lookup name for host and port: "host" for port 22 (or 0), "[host]:port" otherwise
+static int knownhost_name(char* out, size_t out_len, const char* host, int port) {
+    int length = port > 0 && port != 22
+        ? snprintf(out, out_len, "[%s]:%d", host, port)
+        : snprintf(out, out_len, "%s", host);
+    if (length < 0 || (size_t)length >= out_len) return -1;
+    for (int i = 0; i < length; i++) {
+        out[i] = (char)tolower((unsigned char)out[i]);
+    }
+    return length;
+}
+
+// Read the key type string at the start of an SSH public key blob
+static int key_parse(knownhost_key* key, const uint8_t* blob, size_t blob_length) {
+    if (blob_length < 4) return -1;
+    uint32_t length = ((uint32_t)blob[0] << 24) | ((uint32_t)blob[1] << 16)
+        | ((uint32_t)blob[2] << 8) | blob[3];
+    if (length == 0 || length >= sizeof(key->type_buffer) || length > blob_length - 4) return -1;
+
+    memcpy(key->type_buffer, blob + 4, length);
+    key->type_buffer[length] = '\0';
+    key->type = key->type_buffer;
+    return 0;
+}
+
+static int key_equal(const knownhost_key* key, const uint8_t* blob, size_t blob_length) {
+    return key->blob_length == blob_length && memcmp(key->blob, blob, blob_length) == 0;
+}
+
+// =====================================
+// Index
+// =====================================
+
+static knownhost_node** index_slot(ssh2_knownhosts* hosts, uint32_t hash) {
+    return &hosts->buckets[hash & (hosts->bucket_count - 1)];
+}
+
+static int index_grow(ssh2_knownhosts* hosts) {
+    uint32_t count = hosts->bucket_count * 2;
+    knownhost_node** buckets = calloc(count, sizeof(knownhost_node*));
+    if (!buckets) return LIBSSH2_ERROR_ALLOC;
+
+    for (uint32_t i = 0; i < hosts->bucket_count; i++) {
+        knownhost_node* node = hosts->buckets[i];
+        while (node) {
+            knownhost_node* next = node->next;
+            knownhost_node** slot = &buckets[node->hash & (count - 1)];
+            node->next = *slot;
+            *slot = node;
+            node = next;
+        }
+    }
+    free(hosts->buckets);
+    hosts->buckets = buckets;
+    hosts->bucket_count = count;
+    return 0;
+}
+
+// Key for (name, type): the name, a NUL, then the key type ("" for markers)
+static size_t index_key(char* out, const char* name, size_t name_length, const char* type) {
+    size_t type_length = strlen(type);
+    memcpy(out, name, name_length);
+    out[name_length] = '\0';
+    memcpy(out + name_length + 1, type, type_length);
+    return name_length + 1 + type_length;
+}
+
+static int index_insert(ssh2_knownhosts* hosts, const char* name, size_t name_length,
+                        const char* type, knownhost_entry* entry, uint32_t resolved) {
+    if (name_length >= KNOWNHOST_NAME_MAX) return LIBSSH2_ERROR_INVAL;
+    if (hosts->node_count >= hosts->bucket_count && index_grow(hosts) < 0) return LIBSSH2_ERROR_ALLOC;
+
+    char key[KNOWNHOST_NAME_MAX + 64];
+    size_t length = index_key(key, name, name_length, type);
+
+    knownhost_node* node = malloc(sizeof(knownhost_node) + length);
+    if (!node) return LIBSSH2_ERROR_ALLOC;
+    node->hash = knownhost_hash(key, length);
+    node->entry = entry;
+    node->resolved = resolved;
+    node->name_length = (uint16_t)length;
+    memcpy(node->name, key, length);
+
+    knownhost_node** slot = index_slot(hosts, node->hash);
+    node->next = *slot;
+    *slot = node;
+    hosts->node_count++;
+    return 0;
+}
+
+// Next index node for (name, type) after `after` (NULL to start), or NULL
+static knownhost_node* index_find(ssh2_knownhosts* hosts, const char* name, size_t name_length,
+                                  const char* type, knownhost_node* after) {
+    char key[KNOWNHOST_NAME_MAX + 64];
+    size_t length = index_key(key, name, name_length, type);
+    uint32_t hash = knownhost_hash(key, length);
+
+    knownhost_node* node = after ? after->next : *index_slot(hosts, hash);
+    for (; node; node = node->next) {
+        if (node->hash == hash && node->name_length == length && memcmp(node->name, key, length) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+// =====================================
+// Hashed Entries
+// =====================================
+
+static int salt_add(ssh2_knownhosts* hosts, const uint8_t* salt, size_t salt_length, knownhost_entry* entry) {
+    knownhost_salt* group = hosts->salts;
+    for (; group; group = group->next) {
+        if (group->salt_length == salt_length && memcmp(group->salt, salt, salt_length) == 0) break;
+    }
+    if (!group) {
+        group = calloc(1, sizeof(knownhost_salt));
+        if (!group) return LIBSSH2_ERROR_ALLOC;
+        memcpy(group->salt, salt, salt_length);
+        group->salt_length = salt_length;
+        group->next = hosts->salts;
+        hosts->salts = group;
+    }
+    entry->sequence = ++hosts->hashed_count;
+    entry->next = group->entries;
+    group->entries = entry;
+    return 0;
+}
+
+// Index the hashed entries matching name. Each entry is matched against a
+// name once: a name checked before only needs the entries added since, and
+// a salt group with none of those costs no HMAC.
+static int hashed_resolve(ssh2_knownhosts* hosts, const char* name, size_t name_length) {
+    knownhost_node* marker = index_find(hosts, name, name_length, "", NULL);
+    uint32_t resolved = marker ? marker->resolved : 0;
+    if (resolved == hosts->hashed_count) return 0;
+
+    for (knownhost_salt* group = hosts->salts; group; group = group->next) {
+        if (group->entries->sequence <= resolved) continue;
+
+        uint8_t digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        if (!HMAC(EVP_sha1(), group->salt, (int)group->salt_length,
+                  (const unsigned char*)name, name_length, digest, &digest_length)) {
+            return LIBSSH2_ERROR_HOSTKEY_INIT;
+        }
+
+        for (knownhost_entry* entry = group->entries; entry && entry->sequence > resolved; entry = entry->next) {
+            if (memcmp(entry->hash, digest, KNOWNHOST_SHA1_LENGTH) != 0) continue;
+            int rc = index_insert(hosts, name, name_length, entry->key.type, entry, 0);
+            if (rc < 0) return rc;
+        }
+    }
+
+    if (marker) {
+        marker->resolved = hosts->hashed_count;
+        return 0;
+    }
+    return index_insert(hosts, name, name_length, "", NULL, hosts->hashed_count);
+}
+
+// =====================================
+// Parsing
+// =====================================
+
+static int base64_decode(const char* in, size_t length, uint8_t** out, size_t* out_length) {
+    if (length == 0 || length % 4) return -1;
+
+    uint8_t* buffer = malloc(length / 4 * 3 + 1);
+    if (!buffer) return -1;
+    int decoded = EVP_DecodeBlock(buffer, (const unsigned char*)in, (int)length);
+    if (decoded < 0) {
+        free(buffer);
+        return -1;
+    }
+    // EVP_DecodeBlock counts the bytes encoded by '=' padding
+    if (in[length - 1] == '=') decoded--;
+    if (in[length - 2] == '=') decoded--;
+
+    *out = buffer;
+    *out_length = (size_t)decoded;
+    return 0;
+}
+
+static int line_store(ssh2_knownhosts* hosts, const char* line, size_t length) {
+    if (hosts->line_count == hosts->line_capacity) {
+        size_t capacity = hosts->line_capacity ? hosts->line_capacity * 2 : 256;
+        char** lines = realloc(hosts->lines, capacity * sizeof(char*));
+        if (!lines) return LIBSSH2_ERROR_ALLOC;
+        hosts->lines = lines;
+        hosts->line_capacity = capacity;
+    }
+
+    char* copy = malloc(length + 1);
+    if (!copy) return LIBSSH2_ERROR_ALLOC;
+    memcpy(copy, line, length);
+    copy[length] = '\0';
+    hosts->lines[hosts->line_count++] = copy;
+    return 0;
+}
+
+// Next whitespace-separated field of [*cursor, end)
+static const char* next_field(const char** cursor, const char* end, size_t* length) {
+    const char* p = *cursor;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    const char* start = p;
+    while (p < end && *p != ' ' && *p != '\t') p++;
+    *cursor = p;
+    *length = (size_t)(p - start);
+    return *length ? start : NULL;
+}
+
+static void entry_free(knownhost_entry* entry) {
+    if (!entry) return;
+    free(entry->key.blob);
+    free(entry->patterns);
+    free(entry);
+}
+
+static int entry_index_names(ssh2_knownhosts* hosts, knownhost_entry* entry, const char* field, size_t length) {
+    const char* end = field + length;
+    while (field < end) {
+        const char* comma = memchr(field, ',', (size_t)(end - field));
+        size_t name_length = (size_t)((comma ? comma : end) - field);
+
+        char name[KNOWNHOST_NAME_MAX];
+        if (name_length && name_length < sizeof(name)) {
+            for (size_t i = 0; i < name_length; i++) {
+                name[i] = (char)tolower((unsigned char)field[i]);
+            }
+            int rc = index_insert(hosts, name, name_length, entry->key.type, entry, 0);
+            if (rc < 0) return rc;
+        }
+        field += name_length + 1;
+    }
+    return 0;
+}
+
+// Parse one known_hosts line. Returns 1 if an entry was added, 0 for lines
+// that are kept but not checked (comments, @cert-authority, unparsable
+// lines), or a negative libssh2 error.
+static int knownhost_parse(ssh2_knownhosts* hosts, const char* line, size_t line_length) {
+    const char* cursor = line;
+    const char* end = line + line_length;
+    size_t length;
+
+    const char* hostfield = next_field(&cursor, end, &length);
+    if (!hostfield || *hostfield == '#') return 0;
+
+    int revoked = 0;
+    if (*hostfield == '@') {
+        if (length != 8 || memcmp(hostfield, "@revoked", 8) != 0) return 0;
+        revoked = 1;
+        hostfield = next_field(&cursor, end, &length);
+        if (!hostfield) return 0;
+    }
+    size_t host_length = length;
+
+    size_t type_length;
+    const char* type = next_field(&cursor, end, &type_length);
+    size_t key_length;
+    const char* key = next_field(&cursor, end, &key_length);
+    if (!type || !key) return 0;
+
+    knownhost_entry* entry = calloc(1, sizeof(knownhost_entry));
+    if (!entry) return LIBSSH2_ERROR_ALLOC;
+    if (base64_decode(key, key_length, &entry->key.blob, &entry->key.blob_length) < 0
+        || key_parse(&entry->key, entry->key.blob, entry->key.blob_length) < 0
+        || strlen(entry->key.type) != type_length || memcmp(entry->key.type, type, type_length) != 0) {
+        entry_free(entry);
+        return 0;
+    }
+
+    int rc;
+    if (revoked || has_wildcards(hostfield, host_length)) {
+        entry->patterns = malloc(host_length + 1);
+        if (!entry->patterns) {
+            entry_free(entry);
+            return LIBSSH2_ERROR_ALLOC;
+        }
+        for (size_t i = 0; i < host_length; i++) {
+            entry->patterns[i] = (char)tolower((unsigned char)hostfield[i]);
+        }
+        entry->patterns[host_length] = '\0';
+
+        knownhost_entry** list = revoked ? &hosts->revoked : &hosts->patterns;
+        entry->next = *list;
+        *list = entry;
+        rc = 0;
+    } else if (host_length > 3 && memcmp(hostfield, "|1|", 3) == 0) {
+        // |1|base64(salt)|base64(HMAC-SHA1(salt, host))
+        const char* salt64 = hostfield + 3;
+        const char* bar = memchr(salt64, '|', host_length - 3);
+        uint8_t* salt = NULL;
+        uint8_t* hash = NULL;
+        size_t salt_length = 0;
+        size_t hash_length = 0;
+        if (!bar
+            || base64_decode(salt64, (size_t)(bar - salt64), &salt, &salt_length) < 0
+            || base64_decode(bar + 1, (size_t)(hostfield + host_length - bar - 1), &hash, &hash_length) < 0
+            || salt_length > KNOWNHOST_SALT_MAX || hash_length != KNOWNHOST_SHA1_LENGTH) {
+            free(salt);
+            free(hash);
+            entry_free(entry);
+            return 0;
+        }
+        memcpy(entry->hash, hash, KNOWNHOST_SHA1_LENGTH);
+        rc = salt_add(hosts, salt, salt_length, entry);
+        free(salt);
+        free(hash);
+    } else {
+        entry->next = hosts->owned;
+        hosts->owned = entry;
+        rc = entry_index_names(hosts, entry, hostfield, host_length);
+    }
+
+    if (rc < 0) return rc;
+    hosts->entry_count++;
+    return 1;
+}
+
+// =====================================
+// Known Hosts API
+// =====================================
+
+// Create an empty store. The session is accepted for API compatibility
+// with libssh2_knownhost_init and not used.
+EMSCRIPTEN_KEEPALIVE
+ssh2_knownhosts* ssh2_knownhost_init(LIBSSH2_SESSION* session) {
+    ssh2_knownhosts* hosts = calloc(1, sizeof(ssh2_knownhosts));
+    if (!hosts) return NULL;
+
+    hosts->bucket_count = 64;
+    hosts->buckets = calloc(hosts->bucket_count, sizeof(knownhost_node*));
+    if (!hosts->buckets) {
+        free(hosts);
+        return NULL;
+    }
+    return hosts;
+}
+
+// Load OpenSSH known_hosts text from memory. Returns the number of host
+// entries added, or a negative libssh2 error. Comments, @cert-authority
+// and unparsable lines are skipped but kept for ssh2_knownhost_writefile.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_knownhost_load(ssh2_knownhosts* hosts, const char* data, size_t length) {
+    if (!hosts || (!data && length)) return LIBSSH2_ERROR_BAD_USE;
+
+    int count = 0;
+    const char* end = data + length;
+    while (data < end) {
+        const char* newline = memchr(data, '\n', (size_t)(end - data));
+        size_t raw_length = (size_t)((newline ? newline : end) - data);
+        size_t line_length = raw_length;
+        if (line_length && data[line_length - 1] == '\r') line_length--;
+
+        if (line_length) {
+            int rc = line_store(hosts, data, line_length);
+            if (rc == 0) rc = knownhost_parse(hosts, data, line_length);
+            if (rc < 0) return rc;
+            count += rc;
+        }
+        data += raw_length + 1;
+    }
+    return count;
+}
+
+// Load a known_hosts file from the Emscripten filesystem
+EMSCRIPTEN_KEEPALIVE
+int ssh2_knownhost_readfile(ssh2_knownhosts* hosts, const char* filename) {
+    if (!hosts || !filename) return LIBSSH2_ERROR_BAD_USE;
+
+    FILE* file = fopen(filename, "rb");
+    if (!file) return LIBSSH2_ERROR_FILE;
+
+    char* data = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    for (;;) {
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : 65536;
+            char* grown = realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                fclose(file);
+                return LIBSSH2_ERROR_ALLOC;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + length, 1, capacity - length, file);
+        if (n == 0) break;
+        length += n;
+    }
+    fclose(file);
+
+    int rc = ssh2_knownhost_load(hosts, data, length);
+    free(data);
+    return rc;
+}
+
+// Write every loaded or added line back out in OpenSSH format
+EMSCRIPTEN_KEEPALIVE
+int ssh2_knownhost_writefile(ssh2_knownhosts* hosts, const char* filename, int type) {
+    if (!hosts || !filename) return LIBSSH2_ERROR_BAD_USE;
+    if (type != LIBSSH2_KNOWNHOST_FILE_OPENSSH) return LIBSSH2_ERROR_METHOD_NOT_SUPPORTED;
+
+    FILE* file = fopen(filename, "wb");
+    if (!file) return LIBSSH2_ERROR_FILE;
+    for (size_t i = 0; i < hosts->line_count; i++) {
+        if (fputs(hosts->lines[i], file) < 0 || fputc('\n', file) < 0) {
+            fclose(file);
+            return LIBSSH2_ERROR_FILE;
+        }
+    }
+    return fclose(file) == 0 ? 0 : LIBSSH2_ERROR_FILE;
+}
+
+// Add a host key (the blob from ssh2_session_hostkey). With hashed set the
+// line is written as |1|salt|hash like HashKnownHosts does.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_knownhost_add(ssh2_knownhosts* hosts, const char* host, int port,
+                       const uint8_t* key, size_t key_length, int hashed) {
+    if (!hosts || !host || !key || !key_length) return LIBSSH2_ERROR_BAD_USE;
+
+    char name[KNOWNHOST_NAME_MAX];
+    int name_length = knownhost_name(name, sizeof(name), host, port);
+    if (name_length < 0) return LIBSSH2_ERROR_INVAL;
+
+    knownhost_key parsed;
+    if (key_parse(&parsed, key, key_length) < 0) return LIBSSH2_ERROR_INVAL;
+
+    char hostfield[128 + KNOWNHOST_NAME_MAX];
+    if (hashed) {
+        uint8_t salt[KNOWNHOST_SHA1_LENGTH];
+        uint8_t digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        if (RAND_bytes(salt, sizeof(salt)) != 1
+            || !HMAC(EVP_sha1(), salt, sizeof(salt), (const unsigned char*)name, (size_t)name_length,
+                     digest, &digest_length)) {
+            return LIBSSH2_ERROR_HOSTKEY_INIT;
+        }
+        memcpy(hostfield, "|1|", 3);
+        int n = EVP_EncodeBlock((unsigned char*)hostfield + 3, salt, sizeof(salt));
+        hostfield[3 + n] = '|';
+        n = 4 + n + EVP_EncodeBlock((unsigned char*)hostfield + 4 + n, digest, KNOWNHOST_SHA1_LENGTH);
+        hostfield[n] = '\0';
+    } else {
+        memcpy(hostfield, name, (size_t)name_length + 1);
+    }
+
+    size_t encoded_length = 4 * ((key_length + 2) / 3);
+    size_t line_length = strlen(hostfield) + strlen(parsed.type) + encoded_length + 2;
+    char* line = malloc(line_length + 1);
+    if (!line) return LIBSSH2_ERROR_ALLOC;
+    int offset = snprintf(line, line_length + 1, "%s %s ", hostfield, parsed.type);
+    EVP_EncodeBlock((unsigned char*)line + offset, key, (int)key_length);
+
+    int rc = line_store(hosts, line, line_length);
+    if (rc == 0) rc = knownhost_parse(hosts, line, line_length);
+    free(line);
+    return rc < 0 ? rc : 0;
+}
+
+// Check the server's key (the blob from ssh2_session_hostkey) for host and
+// port (0 or 22 for the default). Returns LIBSSH2_KNOWNHOST_CHECK_MATCH,
+// _MISMATCH (another key of the same type is known, or the key is
+// revoked), _NOTFOUND or _FAILURE.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_knownhost_check(ssh2_knownhosts* hosts, const char* host, int port,
+                         const uint8_t* key, size_t key_length) {
+    if (!hosts || !host || !key) return LIBSSH2_KNOWNHOST_CHECK_FAILURE;
+
+    char name[KNOWNHOST_NAME_MAX];
+    int name_length = knownhost_name(name, sizeof(name), host, port);
+    knownhost_key parsed;
+    if (name_length < 0 || key_parse(&parsed, key, key_length) < 0) return LIBSSH2_KNOWNHOST_CHECK_FAILURE;
+
+    for (knownhost_entry* entry = hosts->revoked; entry; entry = entry->next) {
+        if (key_equal(&entry->key, key, key_length) && pattern_list_match(name, entry->patterns)) {
+            return LIBSSH2_KNOWNHOST_CHECK_MISMATCH;
+        }
+    }
+
+    if (hashed_resolve(hosts, name, (size_t)name_length) < 0) return LIBSSH2_KNOWNHOST_CHECK_FAILURE;
+
+    int found = 0;
+    knownhost_node* node = NULL;
+    while ((node = index_find(hosts, name, (size_t)name_length, parsed.type, node))) {
+        if (key_equal(&node->entry->key, key, key_length)) return LIBSSH2_KNOWNHOST_CHECK_MATCH;
+        found = 1;
+    }
+
+    for (knownhost_entry* entry = hosts->patterns; entry; entry = entry->next) {
+        if (strcmp(entry->key.type, parsed.type) != 0 || !pattern_list_match(name, entry->patterns)) continue;
+        if (key_equal(&entry->key, key, key_length)) return LIBSSH2_KNOWNHOST_CHECK_MATCH;
+        found = 1;
+    }
+
+    return found ? LIBSSH2_KNOWNHOST_CHECK_MISMATCH : LIBSSH2_KNOWNHOST_CHECK_NOTFOUND;
+}
+
+// Number of host entries (lines with a key, including @revoked)
+EMSCRIPTEN_KEEPALIVE
+int ssh2_knownhost_count(ssh2_knownhosts* hosts) {
+    return hosts ? (int)hosts->entry_count : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void ssh2_knownhost_free(ssh2_knownhosts* hosts) {
+    if (!hosts) return;
+
+    for (uint32_t i = 0; i < hosts->bucket_count; i++) {
+        knownhost_node* node = hosts->buckets[i];
+        while (node) {
+            knownhost_node* next = node->next;
+            free(node);
+            node = next;
+        }
+    }
+
+    knownhost_entry* lists[] = { hosts->patterns, hosts->revoked, hosts->owned };
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        knownhost_entry* entry = lists[i];
+        while (entry) {
+            knownhost_entry* next = entry->next;
+            entry_free(entry);
+            entry = next;
+        }
+    }
+
+    knownhost_salt* group = hosts->salts;
+    while (group) {
+        knownhost_salt* next_group = group->next;
+        knownhost_entry* entry = group->entries;
+        while (entry) {
+            knownhost_entry* next = entry->next;
+            entry_free(entry);
+            entry = next;
+        }
+        free(group);
+        group = next_group;
+    }
+
+    for (size_t i = 0; i < hosts->line_count; i++) {
+        free(hosts->lines[i]);
+    }
+    free(hosts->lines);
+    free(hosts->buckets);
+    free(hosts);
+}
@@ -0,0 +1,349 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Chunk Pool
+// =====================================
+
+// One allocation holding `count` chunks of `chunk_size` bytes. Streaming
+// transfers read straight into a chunk and hand it to JS, which copies it
+// out (into a BYOB view, for example) and releases it. When every chunk is
+// held, transfers stop reading, the channel window stays shut and the
+// server waits, so memory stays at count * chunk_size however large the
+// file is.
+EMSCRIPTEN_KEEPALIVE
+ssh2_chunk_pool* ssh2_chunk_pool_new(uint32_t count, uint32_t chunk_size) {
+    if (count == 0 || chunk_size == 0 || (size_t)count * chunk_size > UINT32_MAX) return NULL;
+
+    ssh2_chunk_pool* pool = calloc(1, sizeof(ssh2_chunk_pool));
+    if (!pool) return NULL;
+
+    pool->data = malloc((size_t)count * chunk_size);
+    pool->free = malloc(count * sizeof(uint32_t));
+    if (!pool->data || !pool->free) {
+        free(pool->data);
+        free(pool->free);
+        free(pool);
+        return NULL;
+    }
+
+    pool->chunk_size = chunk_size;
+    pool->count = count;
+    pool->free_count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        pool->free[i] = count - 1 - i;
+    }
+    return pool;
+}
+
+// Free the pool. Every chunk must have been released.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_chunk_pool_free(ssh2_chunk_pool* pool) {
+    if (pool) {
+        free(pool->data);
+        free(pool->free);
+        free(pool);
+    }
+}
+
+uint8_t* ssh2_chunk_acquire(ssh2_chunk_pool* pool) {
+    if (!pool->free_count) return NULL;
+    return pool->data + (size_t)pool->free[--pool->free_count] * pool->chunk_size;
+}
+
+// Return a chunk handed out by a transfer sink
+EMSCRIPTEN_KEEPALIVE
+void ssh2_chunk_release(ssh2_chunk_pool* pool, uint8_t* chunk) {
+    if (!pool || !chunk || pool->free_count == pool->count) return;
+    pool->free[pool->free_count++] = (uint32_t)((chunk - pool->data) / pool->chunk_size);
+}
+
+// Chunks currently free
+EMSCRIPTEN_KEEPALIVE
+uint32_t ssh2_chunk_pool_available(ssh2_chunk_pool* pool) {
+    return pool ? pool->free_count : 0;
+}
+
+// =====================================
+// SCP Streams
+// =====================================
+
+// After the file data, the sending side writes a single NUL and the
+// receiving side acknowledges with another. libssh2 only handles the header
+// exchange, so the engine does the rest: a download reads exactly `size`
+// bytes, consumes the trailing NUL and acknowledges it; an upload writes
+// `size` bytes, then the NUL, and reads the server's acknowledgement.
+// Either way it then sends EOF and frees the channel.
+
+enum {
+    SCP_OPEN,
+    SCP_DATA,
+    SCP_TRAILER,     // GET: read the NUL after the data, PUT: write it
+    SCP_ACK,         // GET: acknowledge the file, PUT: read the acknowledgement
+    SCP_EOF,
+    SCP_FREE,
+    SCP_DONE
+};
+
+static ssh2_scp_transfer* scp_new(LIBSSH2_SESSION* session, const char* path,
+                                  ssh2_chunk_pool* pool, int id, int direction) {
+    if (!session || !path || !pool) return NULL;
+
+    ssh2_scp_transfer* transfer = calloc(1, sizeof(ssh2_scp_transfer));
+    if (!transfer) return NULL;
+
+    transfer->path = strdup(path);
+    if (!transfer->path) {
+        free(transfer);
+        return NULL;
+    }
+
+    transfer->session = session;
+    transfer->pool = pool;
+    transfer->id = id;
+    transfer->direction = direction;
+    transfer->state = SCP_OPEN;
+    return transfer;
+}
+
+// Start downloading path. Once the SCP header arrives,
+// Module.scpTransfers[id].open(size, mode, mtime) is called; data then goes
+// to sink(ptr, length, offset) in pool chunks, which the sink owns until it
+// passes them to ssh2_chunk_release.
+EMSCRIPTEN_KEEPALIVE
+ssh2_scp_transfer* ssh2_scp_get(LIBSSH2_SESSION* session, const char* path, ssh2_chunk_pool* pool, int id) {
+    return scp_new(session, path, pool, id, SSH2_TRANSFER_GET);
+}
+
+// Start uploading `size` bytes to path. Data is pulled from
+// Module.scpTransfers[id].source(ptr, maxLength, offset), which returns the
+// number of bytes written, 0 at end of input, or -1 if nothing is ready yet.
+EMSCRIPTEN_KEEPALIVE
+ssh2_scp_transfer* ssh2_scp_put(LIBSSH2_SESSION* session, const char* path, ssh2_chunk_pool* pool, int id,
+                                int mode, double size, double mtime, double atime) {
+    ssh2_scp_transfer* transfer = scp_new(session, path, pool, id, SSH2_TRANSFER_PUT);
+    if (transfer) {
+        transfer->mode = mode;
+        transfer->size = (libssh2_uint64_t)size;
+        transfer->mtime = (time_t)mtime;
+        transfer->atime = (time_t)atime;
+    }
+    return transfer;
+}
+
+static int scp_open(ssh2_scp_transfer* transfer) {
+    if (transfer->direction == SSH2_TRANSFER_GET) {
+        libssh2_struct_stat sb;
+        memset(&sb, 0, sizeof(sb));
+        transfer->channel = libssh2_scp_recv2(transfer->session, transfer->path, &sb);
+        if (transfer->channel) {
+            transfer->size = (libssh2_uint64_t)sb.st_size;
+            transfer->mode = (int)sb.st_mode;
+            transfer->mtime = sb.st_mtime;
+            EM_ASM({
+                var transfer = Module.scpTransfers[$0];
+                if (transfer.open) transfer.open($1, $2, $3);
+            }, transfer->id, (double)transfer->size, transfer->mode, (double)transfer->mtime);
+        }
+    } else {
+        transfer->channel = libssh2_scp_send64(transfer->session, transfer->path, transfer->mode & 0777,
+                                               transfer->size, transfer->mtime, transfer->atime);
+    }
+
+    if (!transfer->channel) return libssh2_session_last_errno(transfer->session);
+    transfer->state = SCP_DATA;
+    return 0;
+}
+
+// Hand the current chunk to the sink, which now owns it
+static void scp_deliver(ssh2_scp_transfer* transfer) {
+    EM_ASM({
+        Module.scpTransfers[$0].sink($1, $2, $3);
+    }, transfer->id, (int)transfer->chunk, (int)transfer->chunk_length, (double)transfer->offset);
+    transfer->offset += transfer->chunk_length;
+    transfer->chunk = NULL;
+    transfer->chunk_length = 0;
+}
+
+static int scp_get_data(ssh2_scp_transfer* transfer) {
+    size_t chunk_size = transfer->pool->chunk_size;
+
+    for (;;) {
+        libssh2_uint64_t remaining = transfer->size - transfer->offset - transfer->chunk_length;
+        if (remaining == 0) {
+            if (transfer->chunk_length) scp_deliver(transfer);
+            transfer->state = SCP_TRAILER;
+            return 0;
+        }
+
+        if (!transfer->chunk) {
+            // Every chunk is held by a reader: leave the data in the window
+            transfer->chunk = ssh2_chunk_acquire(transfer->pool);
+            if (!transfer->chunk) return LIBSSH2_ERROR_EAGAIN;
+        }
+
+        size_t room = chunk_size - transfer->chunk_length;
+        if (remaining < room) room = (size_t)remaining;
+
+        ssize_t rc = libssh2_channel_read(transfer->channel, (char*)transfer->chunk + transfer->chunk_length, room);
+        if (rc == LIBSSH2_ERROR_EAGAIN) {
+            // Pass on what arrived rather than holding it until the chunk fills
+            if (transfer->chunk_length) scp_deliver(transfer);
+            return LIBSSH2_ERROR_EAGAIN;
+        }
+        if (rc < 0) return (int)rc;
+        if (rc == 0) return LIBSSH2_ERROR_SCP_PROTOCOL; // EOF before size bytes
+
+        transfer->chunk_length += (size_t)rc;
+        if (transfer->chunk_length == chunk_size) scp_deliver(transfer);
+    }
+}
+
+static int scp_put_data(ssh2_scp_transfer* transfer) {
+    size_t chunk_size = transfer->pool->chunk_size;
+
+    for (;;) {
+        if (!transfer->chunk) {
+            if (transfer->offset == transfer->size) {
+                transfer->state = SCP_TRAILER;
+                return 0;
+            }
+            transfer->chunk = ssh2_chunk_acquire(transfer->pool);
+            if (!transfer->chunk) return LIBSSH2_ERROR_EAGAIN;
+            transfer->chunk_length = 0;
+            transfer->chunk_sent = 0;
+        }
+
+        // Top up the chunk from the source, never past the announced size
+        libssh2_uint64_t wanted = transfer->size - transfer->offset - (transfer->chunk_length - transfer->chunk_sent);
+        while (!transfer->source_done && transfer->chunk_length < chunk_size && wanted > 0) {
+            size_t room = chunk_size - transfer->chunk_length;
+            if (wanted < room) room = (size_t)wanted;
+
+            int n = EM_ASM_INT({
+                return Module.scpTransfers[$0].source($1, $2, $3);
+            }, transfer->id, (int)(transfer->chunk + transfer->chunk_length), (int)room,
+               (double)(transfer->offset + transfer->chunk_length - transfer->chunk_sent));
+            if (n < 0) break;
+            if (n == 0) {
+                transfer->source_done = 1;
+                break;
+            }
+            transfer->chunk_length += (size_t)n;
+            wanted -= (size_t)n;
+        }
+
+        if (transfer->chunk_sent == transfer->chunk_length) {
+            if (transfer->offset + transfer->chunk_length - transfer->chunk_sent < transfer->size
+                && transfer->source_done) {
+                return LIBSSH2_ERROR_SCP_PROTOCOL; // Input ended before size bytes
+            }
+            return LIBSSH2_ERROR_EAGAIN; // Waiting on the source
+        }
+
+        ssize_t rc = libssh2_channel_write(transfer->channel, (const char*)transfer->chunk + transfer->chunk_sent,
+                                           transfer->chunk_length - transfer->chunk_sent);
+        if (rc < 0) return (int)rc;
+
+        transfer->chunk_sent += (size_t)rc;
+        transfer->offset += (size_t)rc;
+        if (transfer->chunk_sent == transfer->chunk_length) {
+            ssh2_chunk_release(transfer->pool, transfer->chunk);
+            transfer->chunk = NULL;
+        }
+    }
+}
+
+// Read one SCP status byte: 0 is success, anything else (1 warning,
+// 2 fatal, followed by a message) fails the transfer
+static int scp_read_status(ssh2_scp_transfer* transfer) {
+    char status;
+    ssize_t rc = libssh2_channel_read(transfer->channel, &status, 1);
+    if (rc < 0) return (int)rc;
+    if (rc == 0 || status != 0) return LIBSSH2_ERROR_SCP_PROTOCOL;
+    return 0;
+}
+
+static int scp_write_status(ssh2_scp_transfer* transfer) {
+    ssize_t rc = libssh2_channel_write(transfer->channel, "", 1);
+    if (rc < 0) return (int)rc;
+    return rc == 1 ? 0 : LIBSSH2_ERROR_EAGAIN;
+}
+
+// Advance a transfer as far as the transport allows. Returns 1 when the
+// transfer is complete, LIBSSH2_ERROR_EAGAIN when it is waiting on the
+// network, the source or a free chunk (call again later), or another
+// libssh2 error.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_scp_transfer_step(ssh2_scp_transfer* transfer) {
+    if (!transfer) return LIBSSH2_ERROR_BAD_USE;
+
+    int get = transfer->direction == SSH2_TRANSFER_GET;
+    int rc = 0;
+
+    while (rc == 0) {
+        switch (transfer->state) {
+        case SCP_OPEN:
+            rc = scp_open(transfer);
+            break;
+        case SCP_DATA:
+            rc = get ? scp_get_data(transfer) : scp_put_data(transfer);
+            break;
+        case SCP_TRAILER:
+            rc = get ? scp_read_status(transfer) : scp_write_status(transfer);
+            if (rc == 0) transfer->state = SCP_ACK;
+            break;
+        case SCP_ACK:
+            rc = get ? scp_write_status(transfer) : scp_read_status(transfer);
+            if (rc == 0) transfer->state = SCP_EOF;
+            break;
+        case SCP_EOF:
+            rc = libssh2_channel_send_eof(transfer->channel);
+            if (rc == 0) transfer->state = SCP_FREE;
+            break;
+        case SCP_FREE:
+            rc = libssh2_channel_free(transfer->channel);
+            if (rc == 0) {
+                transfer->channel = NULL;
+                transfer->state = SCP_DONE;
+            }
+            break;
+        default:
+            return 1;
+        }
+    }
+    return rc;
+}
+
+// Progress: bytes delivered to the sink (GET) or written to the channel (PUT)
+EMSCRIPTEN_KEEPALIVE
+double ssh2_scp_transfer_offset(ssh2_scp_transfer* transfer) {
+    return transfer ? (double)transfer->offset : 0;
+}
+
+// File size from the SCP header once a download has opened, or the size
+// given to ssh2_scp_put
+EMSCRIPTEN_KEEPALIVE
+double ssh2_scp_transfer_size(ssh2_scp_transfer* transfer) {
+    return transfer ? (double)transfer->size : 0;
+}
+
+// Free a transfer. An unfinished transfer's channel is freed as well,
+// which may not complete in non-blocking mode.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_scp_transfer_free(ssh2_scp_transfer* transfer) {
+    if (!transfer) return;
+
+    if (transfer->chunk) {
+        ssh2_chunk_release(transfer->pool, transfer->chunk);
+    }
+    if (transfer->channel) {
+        libssh2_channel_free(transfer->channel);
+    }
+    free(transfer->path);
+    free(transfer);
+}
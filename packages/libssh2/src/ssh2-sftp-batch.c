@@ -0,0 +1,361 @@
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Pipelined Batch Stat
+// =====================================
+
+// libssh2 allows one stat in flight per SFTP instance, so statting the 500
+// entries of a folder costs 500 round trips. A batch owns a separate SFTP
+// channel and speaks the protocol itself for the two requests it needs
+// (SSH_FXP_STAT and SSH_FXP_LSTAT): every request of a batch goes out at
+// once and the replies are matched by id, so the whole batch costs about
+// one round trip. The channel counts against the server's sessions per
+// connection (MaxSessions) and is reused by every batch.
+
+#define FXP_INIT    1
+#define FXP_VERSION 2
+#define FXP_LSTAT   7
+#define FXP_STAT    17
+#define FXP_STATUS  101
+#define FXP_ATTRS   105
+
+#define BATCH_PACKET_MAX (256 * 1024)
+#define BATCH_READ_CHUNK (32 * 1024)
+
+enum {
+    BATCH_OPEN,       // Waiting for the channel
+    BATCH_SUBSYSTEM,  // Waiting for the sftp subsystem
+    BATCH_HELLO,      // INIT sent, waiting for VERSION
+    BATCH_READY,
+    BATCH_RUNNING,
+    BATCH_FAILED
+};
+
+typedef struct ssh2_sftp_batch {
+    LIBSSH2_SESSION* session;
+    LIBSSH2_SFTP* cache_sftp;  // Results are served from and added to its cache
+    LIBSSH2_CHANNEL* channel;
+    int state;
+    int error;                 // Error that failed the batch channel
+
+    uint8_t* out;              // Requests not yet written to the channel
+    size_t out_length;
+    size_t out_sent;
+    size_t out_capacity;
+    uint8_t* in;               // Reply bytes not yet parsed
+    size_t in_length;
+    size_t in_capacity;
+
+    // Batch in progress; paths point into the caller's buffer
+    const char** paths;
+    ssh2_stat_result* results;
+    uint32_t count;
+    uint32_t pending;          // Replies still outstanding
+    uint32_t base_id;          // Request id of paths[0]
+    uint32_t next_id;
+    int kind;                  // SSH2_CACHE_STAT or SSH2_CACHE_LSTAT
+} ssh2_sftp_batch;
+
+static uint32_t get_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+// Append one packet (type, optional id, optional string) to the out buffer
+static int queue_packet(ssh2_sftp_batch* batch, int type, uint32_t id_or_version,
+                        const char* string, size_t string_length) {
+    size_t payload = 1 + 4 + (string ? 4 + string_length : 0);
+    size_t need = batch->out_length + 4 + payload;
+    if (need > batch->out_capacity) {
+        size_t capacity = batch->out_capacity ? batch->out_capacity : 4096;
+        while (capacity < need) capacity *= 2;
+        uint8_t* out = realloc(batch->out, capacity);
+        if (!out) return LIBSSH2_ERROR_ALLOC;
+        batch->out = out;
+        batch->out_capacity = capacity;
+    }
+
+    uint8_t* p = batch->out + batch->out_length;
+    put_u32(p, (uint32_t)payload);
+    p[4] = (uint8_t)type;
+    put_u32(p + 5, id_or_version);
+    if (string) {
+        put_u32(p + 9, (uint32_t)string_length);
+        memcpy(p + 13, string, string_length);
+    }
+    batch->out_length = need;
+    return 0;
+}
+
+// SFTP v3 attributes; extended pairs are skipped
+static int parse_attrs(const uint8_t* p, size_t length, LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    memset(attrs, 0, sizeof(*attrs));
+    if (length < 4) return -1;
+    uint32_t flags = get_u32(p);
+    size_t need = 4;
+    if (flags & LIBSSH2_SFTP_ATTR_SIZE) need += 8;
+    if (flags & LIBSSH2_SFTP_ATTR_UIDGID) need += 8;
+    if (flags & LIBSSH2_SFTP_ATTR_PERMISSIONS) need += 4;
+    if (flags & LIBSSH2_SFTP_ATTR_ACMODTIME) need += 8;
+    if (length < need) return -1;
+
+    p += 4;
+    if (flags & LIBSSH2_SFTP_ATTR_SIZE) {
+        attrs->filesize = ((libssh2_uint64_t)get_u32(p) << 32) | get_u32(p + 4);
+        p += 8;
+    }
+    if (flags & LIBSSH2_SFTP_ATTR_UIDGID) {
+        attrs->uid = get_u32(p);
+        attrs->gid = get_u32(p + 4);
+        p += 8;
+    }
+    if (flags & LIBSSH2_SFTP_ATTR_PERMISSIONS) {
+        attrs->permissions = get_u32(p);
+        p += 4;
+    }
+    if (flags & LIBSSH2_SFTP_ATTR_ACMODTIME) {
+        attrs->atime = get_u32(p);
+        attrs->mtime = get_u32(p + 4);
+    }
+    attrs->flags = flags & (LIBSSH2_SFTP_ATTR_SIZE | LIBSSH2_SFTP_ATTR_UIDGID |
+                            LIBSSH2_SFTP_ATTR_PERMISSIONS | LIBSSH2_SFTP_ATTR_ACMODTIME);
+    return 0;
+}
+
+static int handle_packet(ssh2_sftp_batch* batch, const uint8_t* data, size_t length) {
+    int type = data[0];
+    if (batch->state == BATCH_HELLO) {
+        if (type != FXP_VERSION) return LIBSSH2_ERROR_SFTP_PROTOCOL;
+        batch->state = BATCH_READY;
+        return 0;
+    }
+
+    if (length < 5 || batch->state != BATCH_RUNNING || !batch->pending) return LIBSSH2_ERROR_SFTP_PROTOCOL;
+    uint32_t index = get_u32(data + 1) - batch->base_id;
+    if (index >= batch->count) return LIBSSH2_ERROR_SFTP_PROTOCOL;
+    ssh2_stat_result* result = &batch->results[index];
+
+    if (type == FXP_STATUS) {
+        uint32_t code = length >= 9 ? get_u32(data + 5) : LIBSSH2_FX_FAILURE;
+        result->status = (int32_t)(code ? code : LIBSSH2_FX_FAILURE);
+    } else if (type == FXP_ATTRS) {
+        LIBSSH2_SFTP_ATTRIBUTES attrs;
+        if (parse_attrs(data + 5, length - 5, &attrs) < 0) return LIBSSH2_ERROR_SFTP_PROTOCOL;
+        ssh2_sftp_pack_attrs(&result->attrs, &attrs);
+        result->status = 0;
+
+        ssh2_sftp_cache* cache = batch->cache_sftp ? ssh2_sftp_cache_get(batch->cache_sftp) : NULL;
+        if (cache) {
+            ssh2_sftp_cache_put_attrs(cache, batch->kind, batch->paths[index], &attrs);
+        }
+    } else {
+        return LIBSSH2_ERROR_SFTP_PROTOCOL;
+    }
+    batch->pending--;
+    return 0;
+}
+
+// Handle every complete packet in the in buffer
+static int parse_replies(ssh2_sftp_batch* batch) {
+    size_t offset = 0;
+    int rc = 0;
+    while (batch->in_length - offset >= 4) {
+        uint32_t length = get_u32(batch->in + offset);
+        if (length < 1 || length > BATCH_PACKET_MAX) {
+            rc = LIBSSH2_ERROR_SFTP_PROTOCOL;
+            break;
+        }
+        if (batch->in_length - offset - 4 < length) break;
+        rc = handle_packet(batch, batch->in + offset + 4, length);
+        if (rc < 0) break;
+        offset += 4 + (size_t)length;
+    }
+    memmove(batch->in, batch->in + offset, batch->in_length - offset);
+    batch->in_length -= offset;
+    return rc;
+}
+
+// Write queued requests and read replies until nothing is outstanding (0),
+// the channel would block (LIBSSH2_ERROR_EAGAIN) or it fails
+static int pump(ssh2_sftp_batch* batch) {
+    for (;;) {
+        int moved = 0;
+
+        while (batch->out_sent < batch->out_length) {
+            ssize_t n = libssh2_channel_write(batch->channel, (const char*)batch->out + batch->out_sent,
+                                              batch->out_length - batch->out_sent);
+            if (n == LIBSSH2_ERROR_EAGAIN) break;
+            if (n < 0) return (int)n;
+            batch->out_sent += (size_t)n;
+            moved = 1;
+        }
+        if (batch->out_sent == batch->out_length) {
+            batch->out_sent = batch->out_length = 0;
+        }
+
+        if (batch->in_capacity - batch->in_length < BATCH_READ_CHUNK) {
+            size_t capacity = batch->in_capacity ? batch->in_capacity * 2 : 2 * BATCH_READ_CHUNK;
+            uint8_t* in = realloc(batch->in, capacity);
+            if (!in) return LIBSSH2_ERROR_ALLOC;
+            batch->in = in;
+            batch->in_capacity = capacity;
+        }
+        ssize_t n = libssh2_channel_read(batch->channel, (char*)batch->in + batch->in_length,
+                                         batch->in_capacity - batch->in_length);
+        if (n < 0 && n != LIBSSH2_ERROR_EAGAIN) return (int)n;
+        if (n == 0 && libssh2_channel_eof(batch->channel)) return LIBSSH2_ERROR_CHANNEL_CLOSED;
+        if (n > 0) {
+            batch->in_length += (size_t)n;
+            moved = 1;
+            int rc = parse_replies(batch);
+            if (rc < 0) return rc;
+        }
+
+        if (batch->state != BATCH_HELLO && !batch->pending) return 0;
+        if (!moved) return LIBSSH2_ERROR_EAGAIN;
+    }
+}
+
+// Open the channel and exchange INIT/VERSION
+static int connect_channel(ssh2_sftp_batch* batch) {
+    switch (batch->state) {
+    case BATCH_OPEN:
+        batch->channel = libssh2_channel_open_session(batch->session);
+        if (!batch->channel) return libssh2_session_last_errno(batch->session);
+        batch->state = BATCH_SUBSYSTEM;
+        // fallthrough
+    case BATCH_SUBSYSTEM: {
+        int rc = libssh2_channel_subsystem(batch->channel, "sftp");
+        if (rc < 0) return rc;
+        rc = queue_packet(batch, FXP_INIT, 3, NULL, 0);
+        if (rc < 0) return rc;
+        batch->state = BATCH_HELLO;
+    }
+        // fallthrough
+    case BATCH_HELLO:
+        return pump(batch);
+    default:
+        return 0;
+    }
+}
+
+// Queue a request for every path the cache cannot answer
+static int begin(ssh2_sftp_batch* batch, const char* paths, uint32_t count, int type,
+                 ssh2_stat_result* results) {
+    const char** list = realloc(batch->paths, (count ? count : 1) * sizeof(char*));
+    if (!list) return LIBSSH2_ERROR_ALLOC;
+    batch->paths = list;
+    batch->results = results;
+    batch->count = count;
+    batch->pending = 0;
+    batch->base_id = batch->next_id;
+    batch->next_id += count;
+    batch->kind = type == LIBSSH2_SFTP_LSTAT ? SSH2_CACHE_LSTAT : SSH2_CACHE_STAT;
+    memset(results, 0, count * sizeof(ssh2_stat_result));
+
+    ssh2_sftp_cache* cache = batch->cache_sftp ? ssh2_sftp_cache_get(batch->cache_sftp) : NULL;
+    const char* path = paths;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t length = strlen(path);
+        list[i] = path;
+
+        LIBSSH2_SFTP_ATTRIBUTES attrs;
+        if (cache && ssh2_sftp_cache_attrs(cache, batch->kind, path, &attrs)) {
+            ssh2_sftp_pack_attrs(&results[i].attrs, &attrs);
+        } else {
+            int rc = queue_packet(batch, type == LIBSSH2_SFTP_LSTAT ? FXP_LSTAT : FXP_STAT,
+                                  batch->base_id + i, path, length);
+            if (rc < 0) return rc;
+            batch->pending++;
+        }
+        path += length + 1;
+    }
+    batch->state = BATCH_RUNNING;
+    return 0;
+}
+
+static int run(ssh2_sftp_batch* batch, const char* paths, uint32_t count, int type,
+               ssh2_stat_result* results) {
+    int rc = connect_channel(batch);
+    if (rc < 0) return rc;
+
+    if (batch->state == BATCH_READY) {
+        rc = begin(batch, paths, count, type, results);
+        if (rc < 0) return rc;
+    }
+    rc = batch->pending ? pump(batch) : 0;
+    if (rc < 0) return rc;
+
+    batch->state = BATCH_READY;
+    return (int)batch->count;
+}
+
+// =====================================
+// Batch API
+// =====================================
+
+// Create a batch stat channel on session. With cache_sftp (may be NULL),
+// paths found in that SFTP instance's metadata cache are answered without a
+// request, and fetched results are added to it. Nothing is sent until the
+// first ssh2_sftp_batch_stat.
+EMSCRIPTEN_KEEPALIVE
+ssh2_sftp_batch* ssh2_sftp_batch_new(LIBSSH2_SESSION* session, LIBSSH2_SFTP* cache_sftp) {
+    if (!session) return NULL;
+    ssh2_sftp_batch* batch = calloc(1, sizeof(ssh2_sftp_batch));
+    if (!batch) return NULL;
+    batch->session = session;
+    batch->cache_sftp = cache_sftp;
+    batch->next_id = 1;
+    return batch;
+}
+
+// stat (type LIBSSH2_SFTP_STAT) or lstat (LIBSSH2_SFTP_LSTAT) `count` paths
+// given back to back as NUL-terminated strings, one ssh2_stat_result each.
+// Returns count once every result is in, or LIBSSH2_ERROR_EAGAIN: call
+// again with the same arguments, the buffers must stay put until then. A
+// channel or protocol error fails this and every later batch. Runs
+// non-blocking regardless of the session's mode.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_batch_stat(ssh2_sftp_batch* batch, const char* paths, uint32_t count, int type,
+                         ssh2_stat_result* results) {
+    if (!batch || (count && (!paths || !results))) return LIBSSH2_ERROR_BAD_USE;
+    if (type != LIBSSH2_SFTP_STAT && type != LIBSSH2_SFTP_LSTAT) return LIBSSH2_ERROR_BAD_USE;
+    if (batch->state == BATCH_FAILED) return batch->error;
+
+    int blocking = libssh2_session_get_blocking(batch->session);
+    libssh2_session_set_blocking(batch->session, 0);
+    int rc = run(batch, paths, count, type, results);
+    libssh2_session_set_blocking(batch->session, blocking);
+
+    if (rc < 0 && rc != LIBSSH2_ERROR_EAGAIN) {
+        batch->state = BATCH_FAILED;
+        batch->error = rc;
+    }
+    return rc;
+}
+
+// Free the batch and close its channel. A channel that cannot be freed
+// without blocking is left to be released with the session.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_sftp_batch_free(ssh2_sftp_batch* batch) {
+    if (!batch) return;
+    if (batch->channel) {
+        libssh2_channel_free(batch->channel);
+    }
+    free(batch->paths);
+    free(batch->out);
+    free(batch->in);
+    free(batch);
+}
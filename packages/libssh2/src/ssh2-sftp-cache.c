@@ -0,0 +1,310 @@
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// SFTP Metadata Cache
+// =====================================
+
+// File browsers stat, readlink and realpath the same paths over and over,
+// and every call is a round trip. Once enabled on an SFTP instance, results
+// are kept for a fixed TTL and served without touching the network. Our own
+// rename/unlink/mkdir/rmdir/setstat/symlink calls drop the affected entries;
+// changes made through file handles, other clients or other path spellings
+// of the same file are only picked up when the TTL runs out.
+
+typedef struct cache_entry {
+    struct cache_entry* next;     // Hash chain
+    struct cache_entry* newer;    // Insertion order, which is also expiry order
+    struct cache_entry* older;
+    double expires;
+    uint32_t hash;
+    int kind;
+    LIBSSH2_SFTP_ATTRIBUTES attrs;
+    char* target;                 // READLINK/REALPATH result
+    unsigned int target_length;
+    size_t path_length;
+    char path[];
+} cache_entry;
+
+struct ssh2_sftp_cache {
+    struct ssh2_sftp_cache* next; // Registry of enabled caches
+    LIBSSH2_SFTP* sftp;
+    double ttl_ms;
+    uint32_t max_entries;
+    uint32_t count;
+    cache_entry** buckets;
+    uint32_t bucket_count;        // Power of two
+    cache_entry* oldest;
+    cache_entry* newest;
+    double hits;
+    double misses;
+};
+
+// LIBSSH2_SFTP has no user pointer, and a session rarely has more than a
+// few SFTP instances, so caches are found by a list walk
+static ssh2_sftp_cache* caches;
+
+// "dir/" and "dir" name the same thing; "/" stays as it is
+static size_t key_length(const char* path) {
+    size_t length = strlen(path);
+    while (length > 1 && path[length - 1] == '/') length--;
+    return length;
+}
+
+static uint32_t cache_hash(int kind, const char* path, size_t length) {
+    uint32_t hash = 2166136261u ^ (uint32_t)kind;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)path[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void cache_remove(ssh2_sftp_cache* cache, cache_entry* entry) {
+    cache_entry** link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+
+    if (entry->older) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+    if (entry->newer) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+
+    cache->count--;
+    free(entry->target);
+    free(entry);
+}
+
+static cache_entry* cache_find(ssh2_sftp_cache* cache, int kind, const char* path, size_t length) {
+    uint32_t hash = cache_hash(kind, path, length);
+    cache_entry* entry = cache->buckets[hash & (cache->bucket_count - 1)];
+    for (; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->kind == kind && entry->path_length == length
+            && memcmp(entry->path, path, length) == 0) {
+            break;
+        }
+    }
+    if (entry && entry->expires <= emscripten_get_now()) {
+        cache_remove(cache, entry);
+        return NULL;
+    }
+    return entry;
+}
+
+static cache_entry* cache_insert(ssh2_sftp_cache* cache, int kind, const char* path) {
+    size_t length = key_length(path);
+    cache_entry* entry = cache_find(cache, kind, path, length);
+    if (entry) cache_remove(cache, entry);
+
+    double now = emscripten_get_now();
+    while (cache->oldest && (cache->count >= cache->max_entries || cache->oldest->expires <= now)) {
+        cache_remove(cache, cache->oldest);
+    }
+
+    entry = calloc(1, sizeof(cache_entry) + length);
+    if (!entry) return NULL;
+    entry->hash = cache_hash(kind, path, length);
+    entry->kind = kind;
+    entry->expires = now + cache->ttl_ms;
+    entry->path_length = length;
+    memcpy(entry->path, path, length);
+
+    cache_entry** bucket = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry;
+    else cache->oldest = entry;
+    cache->newest = entry;
+    cache->count++;
+    cache->misses++;
+    return entry;
+}
+
+static void cache_clear(ssh2_sftp_cache* cache) {
+    while (cache->oldest) {
+        cache_remove(cache, cache->oldest);
+    }
+}
+
+ssh2_sftp_cache* ssh2_sftp_cache_get(LIBSSH2_SFTP* sftp) {
+    for (ssh2_sftp_cache* cache = caches; cache; cache = cache->next) {
+        if (cache->sftp == sftp) return cache;
+    }
+    return NULL;
+}
+
+int ssh2_sftp_cache_attrs(ssh2_sftp_cache* cache, int kind, const char* path, LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    cache_entry* entry = cache_find(cache, kind, path, key_length(path));
+    if (!entry) return 0;
+    *attrs = entry->attrs;
+    cache->hits++;
+    return 1;
+}
+
+void ssh2_sftp_cache_put_attrs(ssh2_sftp_cache* cache, int kind, const char* path,
+                               const LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    cache_entry* entry = cache_insert(cache, kind, path);
+    if (entry) entry->attrs = *attrs;
+}
+
+// Entries for path, anything below it, and its parent directory (whose
+// mtime and link count the change may have moved)
+void ssh2_sftp_cache_invalidate(LIBSSH2_SFTP* sftp, const char* path) {
+    ssh2_sftp_cache* cache = ssh2_sftp_cache_get(sftp);
+    if (!cache || !path) return;
+
+    size_t length = key_length(path);
+    size_t parent = length;
+    while (parent > 0 && path[parent - 1] != '/') parent--;
+    if (parent > 1) parent--; // Drop the separator, but keep "/" itself
+
+    cache_entry* entry = cache->oldest;
+    while (entry) {
+        cache_entry* newer = entry->newer;
+        size_t n = entry->path_length;
+        int match = memcmp(entry->path, path, n < length ? n : length) == 0 &&
+                    (n == length || (n > length && entry->path[length] == '/'));
+        int is_parent = n == parent && memcmp(entry->path, path, n) == 0;
+        // A relative path's parent may be cached as "." (or "")
+        if (!parent && (n == 0 || (n == 1 && entry->path[0] == '.'))) is_parent = 1;
+        if (match || is_parent) {
+            cache_remove(cache, entry);
+        }
+        entry = newer;
+    }
+}
+
+void ssh2_sftp_cache_drop(LIBSSH2_SFTP* sftp) {
+    for (ssh2_sftp_cache** link = &caches; *link; link = &(*link)->next) {
+        ssh2_sftp_cache* cache = *link;
+        if (cache->sftp == sftp) {
+            *link = cache->next;
+            cache_clear(cache);
+            free(cache->buckets);
+            free(cache);
+            return;
+        }
+    }
+}
+
+// =====================================
+// Cached Lookups
+// =====================================
+
+// type is LIBSSH2_SFTP_STAT or LIBSSH2_SFTP_LSTAT
+int ssh2_sftp_cached_stat(LIBSSH2_SFTP* sftp, const char* path, int type, LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    ssh2_sftp_cache* cache = ssh2_sftp_cache_get(sftp);
+    int kind = type == LIBSSH2_SFTP_LSTAT ? SSH2_CACHE_LSTAT : SSH2_CACHE_STAT;
+    if (cache && ssh2_sftp_cache_attrs(cache, kind, path, attrs)) return 0;
+
+    int rc = libssh2_sftp_stat_ex(sftp, path, (unsigned int)strlen(path), type, attrs);
+    if (cache && rc == 0) {
+        ssh2_sftp_cache_put_attrs(cache, kind, path, attrs);
+    }
+    return rc;
+}
+
+// type is LIBSSH2_SFTP_READLINK or LIBSSH2_SFTP_REALPATH. Returns the
+// target length like libssh2_sftp_symlink_ex.
+int ssh2_sftp_cached_link(LIBSSH2_SFTP* sftp, const char* path, char* target, unsigned int maxlen, int type) {
+    ssh2_sftp_cache* cache = ssh2_sftp_cache_get(sftp);
+    int kind = type == LIBSSH2_SFTP_REALPATH ? SSH2_CACHE_REALPATH : SSH2_CACHE_READLINK;
+
+    if (cache) {
+        cache_entry* entry = cache_find(cache, kind, path, key_length(path));
+        // Too small a buffer goes to libssh2 for its usual error
+        if (entry && entry->target_length < maxlen) {
+            memcpy(target, entry->target, entry->target_length);
+            target[entry->target_length] = '\0';
+            cache->hits++;
+            return (int)entry->target_length;
+        }
+    }
+
+    int rc = libssh2_sftp_symlink_ex(sftp, path, (unsigned int)strlen(path), target, maxlen, type);
+    if (cache && rc >= 0) {
+        cache_entry* entry = cache_insert(cache, kind, path);
+        if (entry) {
+            entry->target = malloc((size_t)rc + 1);
+            if (entry->target) {
+                memcpy(entry->target, target, (size_t)rc);
+                entry->target_length = (unsigned int)rc;
+            } else {
+                cache_remove(cache, entry);
+            }
+        }
+    }
+    return rc;
+}
+
+// =====================================
+// Cache API
+// =====================================
+
+// Cache stat, lstat, readlink and realpath results of this SFTP instance for
+// ttl_ms, keeping at most max_entries (oldest dropped first). ttl_ms 0 turns
+// caching off. Re-enabling starts from an empty cache. The cache is freed by
+// ssh2_sftp_shutdown.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_cache_enable(LIBSSH2_SFTP* sftp, double ttl_ms, uint32_t max_entries) {
+    if (!sftp || ttl_ms < 0) return LIBSSH2_ERROR_BAD_USE;
+    ssh2_sftp_cache_drop(sftp);
+    if (ttl_ms == 0 || max_entries == 0) return 0;
+
+    ssh2_sftp_cache* cache = calloc(1, sizeof(ssh2_sftp_cache));
+    if (!cache) return LIBSSH2_ERROR_ALLOC;
+
+    uint32_t bucket_count = 16;
+    while (bucket_count < max_entries && bucket_count < 0x100000u) {
+        bucket_count <<= 1;
+    }
+    cache->buckets = calloc(bucket_count, sizeof(cache_entry*));
+    if (!cache->buckets) {
+        free(cache);
+        return LIBSSH2_ERROR_ALLOC;
+    }
+    cache->bucket_count = bucket_count;
+    cache->sftp = sftp;
+    cache->ttl_ms = ttl_ms;
+    cache->max_entries = max_entries;
+    cache->next = caches;
+    caches = cache;
+    return 0;
+}
+
+// Forget every cached result
+EMSCRIPTEN_KEEPALIVE
+void ssh2_sftp_cache_clear(LIBSSH2_SFTP* sftp) {
+    ssh2_sftp_cache* cache = ssh2_sftp_cache_get(sftp);
+    if (cache) cache_clear(cache);
+}
+
+// out: 3 doubles, entries held, hits, misses (results fetched and cached)
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_cache_info(LIBSSH2_SFTP* sftp, double* out) {
+    ssh2_sftp_cache* cache = ssh2_sftp_cache_get(sftp);
+    if (!cache || !out) return LIBSSH2_ERROR_BAD_USE;
+    out[0] = cache->count;
+    out[1] = cache->hits;
+    out[2] = cache->misses;
+    return 0;
+}
+
+// stat (type LIBSSH2_SFTP_STAT) or lstat (LIBSSH2_SFTP_LSTAT) through the
+// cache, with the result packed for JS (see ssh2_packed_attrs) so it decodes
+// from one reusable buffer
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_stat_packed(LIBSSH2_SFTP* sftp, const char* path, int type, ssh2_packed_attrs* out) {
+    if (!sftp || !path || !out) return LIBSSH2_ERROR_BAD_USE;
+    LIBSSH2_SFTP_ATTRIBUTES attrs;
+    int rc = ssh2_sftp_cached_stat(sftp, path, type, &attrs);
+    if (rc == 0) {
+        ssh2_sftp_pack_attrs(out, &attrs);
+    }
+    return rc;
+}
@@ -0,0 +1,148 @@
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// Longest name and longentry a batch record can carry
+#define SSH2_DIRENT_NAME_MAX 1024
+#define SSH2_DIRENT_LONGENTRY_MAX 1024
+
+#define DIRENT_ALIGN(n) (((n) + 7u) & ~7u)
+
+void ssh2_sftp_pack_attrs(ssh2_packed_attrs* out, const LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    out->flags = (uint32_t)attrs->flags;
+    out->permissions = (uint32_t)attrs->permissions;
+    out->filesize = attrs->filesize;
+    out->uid = (uint32_t)attrs->uid;
+    out->gid = (uint32_t)attrs->gid;
+    out->atime = (uint32_t)attrs->atime;
+    out->mtime = (uint32_t)attrs->mtime;
+}
+
+// =====================================
+// Batch Directory Listing
+// =====================================
+
+// An entry read from libssh2 that did not fit in the caller's buffer.
+// libssh2 cannot put one back, so it is held here and written first on the
+// next call for the same handle. Few directories are listed at once, so held
+// entries are found by a list walk.
+typedef struct held_dirent {
+    LIBSSH2_SFTP_HANDLE* handle;
+    struct held_dirent* next;
+    size_t length;
+    uint8_t* record;
+} held_dirent;
+
+static held_dirent* held_entries;
+
+static held_dirent* held_take(LIBSSH2_SFTP_HANDLE* handle) {
+    for (held_dirent** link = &held_entries; *link; link = &(*link)->next) {
+        held_dirent* held = *link;
+        if (held->handle == handle) {
+            *link = held->next;
+            return held;
+        }
+    }
+    return NULL;
+}
+
+// Write one record at out; returns its length
+static size_t pack_dirent(uint8_t* out, const char* name, size_t name_length,
+                          const char* longentry, size_t longentry_length,
+                          const LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    ssh2_dirent* entry = (ssh2_dirent*)out;
+    entry->name_length = (uint16_t)name_length;
+    entry->longentry_length = (uint16_t)longentry_length;
+    entry->length = DIRENT_ALIGN(sizeof(ssh2_dirent) + name_length + longentry_length);
+    ssh2_sftp_pack_attrs(&entry->attrs, attrs);
+
+    uint8_t* strings = (uint8_t*)(entry + 1);
+    memcpy(strings, name, name_length);
+    memcpy(strings + name_length, longentry, longentry_length);
+    return entry->length;
+}
+
+// Drop the entry held back for a directory handle that is being closed
+void ssh2_sftp_dir_forget(LIBSSH2_SFTP_HANDLE* handle) {
+    held_dirent* held = held_take(handle);
+    if (held) {
+        free(held->record);
+        free(held);
+    }
+}
+
+// Fill buf with as many directory entries as fit, each an ssh2_dirent header
+// followed by its name (and longentry when with_longentry is set). libssh2
+// already fetches names in bulk, so this costs one call per buffer instead of
+// one per entry. buflen must hold one worst-case record: 1064 bytes, or 2088
+// with with_longentry. Returns the number of entries written, 0 at the end
+// of the directory, LIBSSH2_ERROR_BUFFER_TOO_SMALL for a smaller buffer, or
+// a negative libssh2 error if no entry could be read.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_readdir_batch(LIBSSH2_SFTP_HANDLE* handle, uint8_t* buf, size_t buflen,
+                            int with_longentry) {
+    if (!handle || !buf || ((uintptr_t)buf & 7)) return LIBSSH2_ERROR_BAD_USE;
+
+    char name[SSH2_DIRENT_NAME_MAX];
+    char longentry[SSH2_DIRENT_LONGENTRY_MAX];
+    size_t max_record = DIRENT_ALIGN(sizeof(ssh2_dirent) + sizeof(name)
+                                     + (with_longentry ? sizeof(longentry) : 0));
+    size_t used = 0;
+    int count = 0;
+
+    // 0 would read as the end of the directory; this also guarantees that a
+    // held entry fits in an empty buffer
+    if (buflen < max_record) return LIBSSH2_ERROR_BUFFER_TOO_SMALL;
+
+    held_dirent* held = held_take(handle);
+    if (held) {
+        memcpy(buf, held->record, held->length);
+        used = held->length;
+        count = 1;
+        free(held->record);
+        free(held);
+    }
+
+    for (;;) {
+        LIBSSH2_SFTP_ATTRIBUTES attrs;
+        int rc = libssh2_sftp_readdir_ex(handle, name, sizeof(name),
+                                         with_longentry ? longentry : NULL,
+                                         with_longentry ? sizeof(longentry) : 0,
+                                         &attrs);
+        if (rc == 0) break;
+        if (rc < 0) {
+            if (count == 0) return rc;
+            break;
+        }
+
+        size_t longentry_length = with_longentry ? strnlen(longentry, sizeof(longentry)) : 0;
+        size_t length = DIRENT_ALIGN(sizeof(ssh2_dirent) + (size_t)rc + longentry_length);
+        if (length <= buflen - used) {
+            used += pack_dirent(buf + used, name, (size_t)rc, longentry, longentry_length, &attrs);
+            count++;
+            continue;
+        }
+
+        // Already consumed from libssh2: hold it for the next call
+        held = malloc(sizeof(held_dirent));
+        uint8_t* record = malloc(length);
+        if (!held || !record) {
+            free(held);
+            free(record);
+            return LIBSSH2_ERROR_ALLOC;
+        }
+        pack_dirent(record, name, (size_t)rc, longentry, longentry_length, &attrs);
+        held->handle = handle;
+        held->length = length;
+        held->record = record;
+        held->next = held_entries;
+        held_entries = held;
+        break;
+    }
+
+    return count;
+}
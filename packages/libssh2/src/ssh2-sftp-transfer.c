@@ -0,0 +1,156 @@
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <emscripten.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// SFTP Transfer Engine
+// =====================================
+
+// There is no request window here: the handle string and request ids are
+// private to libssh2, so a transfer only sizes the buffer handed to each
+// libssh2_sftp_read / libssh2_sftp_write call. libssh2 splits it into
+// requests of at most 30000 bytes and decides how many are in flight.
+// Writes keep every passed byte on the wire until acknowledged; reads issue
+// read-ahead that grows with the buffer. Larger buffers therefore mean more
+// in flight, but the request size and count are not under our control.
+
+static ssh2_sftp_transfer* transfer_new(LIBSSH2_SFTP_HANDLE* handle, int direction, int id,
+                                        libssh2_uint64_t offset, size_t buffer_size) {
+    if (!handle || buffer_size == 0) return NULL;
+
+    ssh2_sftp_transfer* transfer = calloc(1, sizeof(ssh2_sftp_transfer));
+    if (!transfer) return NULL;
+
+    transfer->capacity = buffer_size;
+    transfer->buffer = malloc(transfer->capacity);
+    if (!transfer->buffer) {
+        free(transfer);
+        return NULL;
+    }
+
+    transfer->handle = handle;
+    transfer->direction = direction;
+    transfer->id = id;
+    transfer->tag = -1;
+    transfer->offset = offset;
+
+    // Resume: position the handle before any request is issued
+    libssh2_sftp_seek64(handle, offset);
+    return transfer;
+}
+
+// Start downloading from an open file handle. Completed ranges are passed
+// in order to Module.sftpTransfers[id].sink(ptr, length, offset, tag),
+// where tag identifies the file for transfers started by a tree walk.
+// length 0 reads until EOF; offset resumes a partial download.
+EMSCRIPTEN_KEEPALIVE
+ssh2_sftp_transfer* ssh2_sftp_get_file(LIBSSH2_SFTP_HANDLE* handle, int id,
+                                       libssh2_uint64_t offset, libssh2_uint64_t length,
+                                       size_t buffer_size) {
+    ssh2_sftp_transfer* transfer = transfer_new(handle, SSH2_TRANSFER_GET, id, offset, buffer_size);
+    if (transfer && length) {
+        transfer->end = offset + length;
+    }
+    return transfer;
+}
+
+// Start uploading to an open file handle. Data is pulled from
+// Module.sftpTransfers[id].source(ptr, maxLength, offset), which returns the
+// number of bytes written, 0 at end of input, or -1 if nothing is ready yet.
+EMSCRIPTEN_KEEPALIVE
+ssh2_sftp_transfer* ssh2_sftp_put_file(LIBSSH2_SFTP_HANDLE* handle, int id,
+                                       libssh2_uint64_t offset, size_t buffer_size) {
+    return transfer_new(handle, SSH2_TRANSFER_PUT, id, offset, buffer_size);
+}
+
+static int transfer_get_step(ssh2_sftp_transfer* transfer) {
+    for (;;) {
+        ssize_t rc = libssh2_sftp_read(transfer->handle, (char*)transfer->buffer, transfer->capacity);
+        if (rc < 0) return (int)rc;
+
+        size_t length = (size_t)rc;
+        if (transfer->end && transfer->offset + length >= transfer->end) {
+            length = (size_t)(transfer->end - transfer->offset);
+            rc = 0;
+        }
+
+        if (length) {
+            EM_ASM({
+                Module.sftpTransfers[$0].sink($1, $2, $3, $4);
+            }, transfer->id, (int)transfer->buffer, (int)length, (double)transfer->offset, transfer->tag);
+            transfer->offset += length;
+        }
+
+        if (rc == 0) {
+            transfer->done = 1;
+            return 1;
+        }
+    }
+}
+
+static int transfer_put_step(ssh2_sftp_transfer* transfer) {
+    for (;;) {
+        // Top up the buffer from the source before handing it to libssh2
+        while (!transfer->source_done && transfer->staged < transfer->capacity) {
+            int n = EM_ASM_INT({
+                return Module.sftpTransfers[$0].source($1, $2, $3);
+            }, transfer->id, (int)(transfer->buffer + transfer->staged),
+               (int)(transfer->capacity - transfer->staged),
+               (double)(transfer->offset + transfer->staged));
+            if (n < 0) break;
+            if (n == 0) {
+                transfer->source_done = 1;
+                break;
+            }
+            transfer->staged += (size_t)n;
+        }
+
+        if (transfer->staged == 0) {
+            if (!transfer->source_done) return LIBSSH2_ERROR_EAGAIN;
+            transfer->done = 1;
+            return 1;
+        }
+
+        // libssh2 remembers what is already on the wire, so the same
+        // unacknowledged bytes are passed again on every call
+        ssize_t rc = libssh2_sftp_write(transfer->handle, (const char*)transfer->buffer, transfer->staged);
+        if (rc < 0) return (int)rc;
+
+        size_t acked = (size_t)rc;
+        memmove(transfer->buffer, transfer->buffer + acked, transfer->staged - acked);
+        transfer->staged -= acked;
+        transfer->offset += acked;
+    }
+}
+
+// Advance a transfer as far as the transport allows. Returns 1 when the
+// transfer is complete, LIBSSH2_ERROR_EAGAIN when it is waiting on the
+// network or the source (call again later), or another libssh2 error.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_transfer_step(ssh2_sftp_transfer* transfer) {
+    if (!transfer) return LIBSSH2_ERROR_BAD_USE;
+    if (transfer->done) return 1;
+
+    return transfer->direction == SSH2_TRANSFER_GET
+        ? transfer_get_step(transfer)
+        : transfer_put_step(transfer);
+}
+
+// Progress: file offset reached (start offset plus bytes transferred)
+EMSCRIPTEN_KEEPALIVE
+libssh2_uint64_t ssh2_sftp_transfer_offset(ssh2_sftp_transfer* transfer) {
+    return transfer ? transfer->offset : 0;
+}
+
+// Free a transfer (the file handle stays open)
+EMSCRIPTEN_KEEPALIVE
+void ssh2_sftp_transfer_free(ssh2_sftp_transfer* transfer) {
+    if (transfer) {
+        free(transfer->buffer);
+        free(transfer);
+    }
+}
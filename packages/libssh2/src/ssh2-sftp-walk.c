@@ -0,0 +1,754 @@
+#include <libssh2.h>
+#include <libssh2_sftp.h>
+#include <emscripten.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// SFTP Tree Walk
+// =====================================
+
+// libssh2 keeps at most one opendir/readdir/open request in flight per SFTP
+// instance, so the walker opens several SFTP channels ("lanes") on the same
+// session and drives them non-blocking side by side. Each lane lists one
+// directory, or downloads one file, at a time; while one lane waits for a
+// reply the others keep the connection busy. Directory entries already carry
+// their attributes, so no separate stat round trip is needed per entry.
+
+#define WALK_MAX_LANES 32
+#define WALK_PATH_MAX 4096
+#define WALK_NAME_MAX 1024
+
+#define WALK_ALIGN(n) (((n) + 7u) & ~7u)
+
+enum {
+    LANE_INIT,     // Waiting for libssh2_sftp_init
+    LANE_IDLE,
+    LANE_OPENDIR,
+    LANE_READDIR,
+    LANE_OPENFILE,
+    LANE_TRANSFER,
+    LANE_CLOSE,
+    LANE_SHUTDOWN,
+    LANE_DONE
+};
+
+enum {
+    PHASE_WALK,
+    PHASE_TRANSFER,
+    PHASE_SHUTDOWN,
+    PHASE_DONE
+};
+
+typedef struct walk_lane {
+    int state;
+    LIBSSH2_SFTP* sftp;
+    LIBSSH2_SFTP_HANDLE* handle;
+    ssh2_sftp_transfer* transfer;
+    char* path;   // Relative path of the directory or file being worked on
+    int delta;    // Delta index being downloaded
+} walk_lane;
+
+// Manifest records as packed by Module.packWalkManifest (16 bytes), followed
+// by the path relative to the walk root and padding to 8 bytes
+typedef struct walk_manifest_record {
+    uint64_t filesize;
+    uint32_t mtime;
+    uint32_t path_length;
+} walk_manifest_record;
+
+typedef struct manifest_entry {
+    struct manifest_entry* next;
+    uint64_t filesize;
+    uint32_t hash;
+    uint32_t mtime;
+    uint32_t path_length;
+    int seen;
+    char path[];
+} manifest_entry;
+
+typedef struct ssh2_sftp_walk {
+    LIBSSH2_SESSION* session;
+    char* root;
+    int phase;
+    int errors;              // Directories or files skipped after SFTP errors
+
+    walk_lane* lanes;
+    int lane_count;
+    int initializing;        // Lane inside libssh2_sftp_init, -1 if none
+
+    // Directories waiting for a lane (relative paths, FIFO)
+    char** queue;
+    size_t queue_head;
+    size_t queue_tail;
+    size_t queue_capacity;
+
+    manifest_entry** buckets;
+    uint32_t bucket_count;   // Power of two, 0 without a manifest
+
+    // Directories (or entries) that could not be fully listed; manifest
+    // entries at or below them are UNKNOWN rather than DELETED
+    char** incomplete;
+    size_t incomplete_count;
+    size_t incomplete_capacity;
+
+    uint8_t* deltas;
+    size_t deltas_used;
+    size_t deltas_capacity;
+    uint32_t delta_count;
+    int32_t* statuses;       // Download status per delta
+    uint32_t statuses_capacity;
+
+    int transfer_id;         // Module.sftpTransfers slot, 0 to only walk
+    size_t buffer_size;
+    uint32_t next_delta;     // Next delta to consider for download
+    size_t next_delta_offset;
+} ssh2_sftp_walk;
+
+static uint32_t walk_hash(const char* path, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)path[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static manifest_entry* manifest_find(ssh2_sftp_walk* walk, const char* path, size_t length) {
+    if (!walk->bucket_count) return NULL;
+
+    uint32_t hash = walk_hash(path, length);
+    manifest_entry* entry = walk->buckets[hash & (walk->bucket_count - 1)];
+    for (; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->path_length == length
+            && memcmp(entry->path, path, length) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static int queue_push(ssh2_sftp_walk* walk, const char* path, size_t length) {
+    if (walk->queue_tail == walk->queue_capacity) {
+        // Reclaim consumed slots before growing
+        size_t pending = walk->queue_tail - walk->queue_head;
+        if (walk->queue_head > pending) {
+            memmove(walk->queue, walk->queue + walk->queue_head, pending * sizeof(char*));
+        } else {
+            size_t capacity = walk->queue_capacity ? walk->queue_capacity * 2 : 64;
+            char** queue = realloc(walk->queue, capacity * sizeof(char*));
+            if (!queue) return LIBSSH2_ERROR_ALLOC;
+            memmove(queue, queue + walk->queue_head, pending * sizeof(char*));
+            walk->queue = queue;
+            walk->queue_capacity = capacity;
+        }
+        walk->queue_head = 0;
+        walk->queue_tail = pending;
+    }
+
+    char* copy = malloc(length + 1);
+    if (!copy) return LIBSSH2_ERROR_ALLOC;
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+
+    walk->queue[walk->queue_tail++] = copy;
+    return 0;
+}
+
+static int delta_append(ssh2_sftp_walk* walk, int kind, int is_dir, const char* path, size_t length,
+                        uint32_t permissions, uint32_t mtime, uint64_t filesize) {
+    size_t record_length = WALK_ALIGN(sizeof(ssh2_walk_delta) + length);
+
+    if (walk->deltas_used + record_length > walk->deltas_capacity) {
+        size_t capacity = walk->deltas_capacity ? walk->deltas_capacity * 2 : 4096;
+        while (capacity < walk->deltas_used + record_length) {
+            capacity *= 2;
+        }
+        uint8_t* deltas = realloc(walk->deltas, capacity);
+        if (!deltas) return LIBSSH2_ERROR_ALLOC;
+        walk->deltas = deltas;
+        walk->deltas_capacity = capacity;
+    }
+
+    if (walk->delta_count == walk->statuses_capacity) {
+        uint32_t capacity = walk->statuses_capacity ? walk->statuses_capacity * 2 : 256;
+        int32_t* statuses = realloc(walk->statuses, capacity * sizeof(int32_t));
+        if (!statuses) return LIBSSH2_ERROR_ALLOC;
+        walk->statuses = statuses;
+        walk->statuses_capacity = capacity;
+    }
+    walk->statuses[walk->delta_count] = SSH2_WALK_NOT_DOWNLOADED;
+
+    ssh2_walk_delta* delta = (ssh2_walk_delta*)(walk->deltas + walk->deltas_used);
+    memset(delta, 0, record_length);
+    delta->length = (uint32_t)record_length;
+    delta->kind = (uint8_t)kind;
+    delta->is_dir = (uint8_t)is_dir;
+    delta->path_length = (uint16_t)length;
+    delta->permissions = permissions;
+    delta->mtime = mtime;
+    delta->filesize = filesize;
+    memcpy(delta + 1, path, length);
+
+    walk->deltas_used += record_length;
+    walk->delta_count++;
+    return 0;
+}
+
+// Remember that the tree at path is only partly known
+static int walk_mark_incomplete(ssh2_sftp_walk* walk, const char* path, size_t length) {
+    if (walk->incomplete_count == walk->incomplete_capacity) {
+        size_t capacity = walk->incomplete_capacity ? walk->incomplete_capacity * 2 : 16;
+        char** incomplete = realloc(walk->incomplete, capacity * sizeof(char*));
+        if (!incomplete) return LIBSSH2_ERROR_ALLOC;
+        walk->incomplete = incomplete;
+        walk->incomplete_capacity = capacity;
+    }
+
+    char* copy = malloc(length + 1);
+    if (!copy) return LIBSSH2_ERROR_ALLOC;
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+    walk->incomplete[walk->incomplete_count++] = copy;
+    return 0;
+}
+
+// True if path is an incomplete directory or lies below one ("" is the root)
+static int walk_is_incomplete(ssh2_sftp_walk* walk, const char* path, size_t length) {
+    for (size_t i = 0; i < walk->incomplete_count; i++) {
+        const char* prefix = walk->incomplete[i];
+        size_t n = strlen(prefix);
+        if (n == 0) return 1;
+        if (length >= n && memcmp(path, prefix, n) == 0 && (length == n || path[n] == '/')) return 1;
+    }
+    return 0;
+}
+
+// Record one directory entry: queue subdirectories and compare against the
+// manifest. Symlinks are reported with their own attributes and not followed.
+static int walk_visit(ssh2_sftp_walk* walk, const char* dir, const char* name, size_t name_length,
+                      const LIBSSH2_SFTP_ATTRIBUTES* attrs) {
+    if ((name_length == 1 && name[0] == '.') || (name_length == 2 && name[0] == '.' && name[1] == '.')) {
+        return 0;
+    }
+
+    char path[WALK_PATH_MAX];
+    int length = *dir
+        ? snprintf(path, sizeof(path), "%s/%.*s", dir, (int)name_length, name)
+        : snprintf(path, sizeof(path), "%.*s", (int)name_length, name);
+    if (length < 0 || (size_t)length >= sizeof(path)) {
+        walk->errors++;
+        return walk_mark_incomplete(walk, path, strnlen(path, sizeof(path) - 1));
+    }
+
+    int is_dir = (attrs->flags & LIBSSH2_SFTP_ATTR_PERMISSIONS)
+        && LIBSSH2_SFTP_S_ISDIR(attrs->permissions);
+    uint32_t permissions = (uint32_t)attrs->permissions;
+    uint32_t mtime = (uint32_t)attrs->mtime;
+    uint64_t filesize = attrs->filesize;
+
+    if (is_dir) {
+        int rc = queue_push(walk, path, (size_t)length);
+        if (rc < 0) return rc;
+    }
+
+    manifest_entry* entry = manifest_find(walk, path, (size_t)length);
+    if (!entry) {
+        return delta_append(walk, SSH2_DELTA_NEW, is_dir, path, (size_t)length, permissions, mtime, filesize);
+    }
+
+    entry->seen = 1;
+    if (is_dir) return 0;
+
+    int changed = ((attrs->flags & LIBSSH2_SFTP_ATTR_SIZE) && filesize != entry->filesize)
+        || ((attrs->flags & LIBSSH2_SFTP_ATTR_ACMODTIME) && mtime != entry->mtime);
+    if (!changed) return 0;
+
+    return delta_append(walk, SSH2_DELTA_CHANGED, 0, path, (size_t)length, permissions, mtime, filesize);
+}
+
+// Report every manifest entry the walk did not find. Entries below a
+// directory that failed to list may still exist, so they are UNKNOWN: a
+// permission error on the server must not read as "delete it locally".
+static int walk_emit_deleted(ssh2_sftp_walk* walk) {
+    for (uint32_t i = 0; i < walk->bucket_count; i++) {
+        for (manifest_entry* entry = walk->buckets[i]; entry; entry = entry->next) {
+            if (entry->seen) continue;
+            int kind = walk_is_incomplete(walk, entry->path, entry->path_length)
+                ? SSH2_DELTA_UNKNOWN : SSH2_DELTA_DELETED;
+            int rc = delta_append(walk, kind, 0, entry->path, entry->path_length,
+                                  0, entry->mtime, entry->filesize);
+            if (rc < 0) return rc;
+        }
+    }
+    return 0;
+}
+
+// Find the next NEW or CHANGED regular file to download
+static ssh2_walk_delta* walk_next_download(ssh2_sftp_walk* walk) {
+    while (walk->next_delta < walk->delta_count) {
+        ssh2_walk_delta* delta = (ssh2_walk_delta*)(walk->deltas + walk->next_delta_offset);
+        walk->next_delta++;
+        walk->next_delta_offset += delta->length;
+
+        if ((delta->kind == SSH2_DELTA_NEW || delta->kind == SSH2_DELTA_CHANGED)
+            && LIBSSH2_SFTP_S_ISREG(delta->permissions)) {
+            return delta;
+        }
+    }
+    return NULL;
+}
+
+static int walk_full_path(ssh2_sftp_walk* walk, const char* path, char* out, size_t out_len) {
+    int length = *path
+        ? snprintf(out, out_len, "%s/%s", walk->root, path)
+        : snprintf(out, out_len, "%s", *walk->root ? walk->root : "/");
+    return length >= 0 && (size_t)length < out_len ? length : -1;
+}
+
+// Record how the lane's download ended and tell the transfer's done(delta,
+// status) callback, so a sink can tell a finished file (including an empty
+// one, which gets no sink call) from a truncated one
+static void walk_finish_delta(ssh2_sftp_walk* walk, walk_lane* lane, int status) {
+    walk->statuses[lane->delta] = status;
+    EM_ASM({
+        var transfer = Module.sftpTransfers[$0];
+        if (transfer && transfer.done) transfer.done($1, $2);
+    }, walk->transfer_id, lane->delta, status);
+}
+
+// Per-entry failures (permission denied, vanished files) are counted and
+// skipped; anything else ends the walk. Directories skipped this way are
+// marked incomplete by the caller.
+static int walk_skip(ssh2_sftp_walk* walk, int rc) {
+    if (rc == LIBSSH2_ERROR_SFTP_PROTOCOL || rc == LIBSSH2_ERROR_BUFFER_TOO_SMALL) {
+        walk->errors++;
+        return 0;
+    }
+    return rc;
+}
+
+// Advance one lane. Returns 1 if its state moved, 0 if it is waiting on the
+// network or has nothing to do, or a negative libssh2 error.
+static int lane_step(ssh2_sftp_walk* walk, int index) {
+    walk_lane* lane = &walk->lanes[index];
+    char full[WALK_PATH_MAX + 256];
+
+    switch (lane->state) {
+    case LANE_INIT: {
+        // The SFTP handshake state lives in the session, so lanes start one at a time
+        if (walk->initializing != -1 && walk->initializing != index) return 0;
+        if (walk->phase != PHASE_WALK && walk->phase != PHASE_TRANSFER && walk->initializing == -1) {
+            lane->state = LANE_DONE;
+            return 1;
+        }
+
+        lane->sftp = libssh2_sftp_init(walk->session);
+        if (!lane->sftp) {
+            int rc = libssh2_session_last_errno(walk->session);
+            if (rc == LIBSSH2_ERROR_EAGAIN) {
+                walk->initializing = index;
+                return 0;
+            }
+            // Servers cap channels per connection; carry on with the lanes we have
+            walk->initializing = -1;
+            for (int i = 0; i < walk->lane_count; i++) {
+                if (walk->lanes[i].sftp) {
+                    lane->state = LANE_DONE;
+                    return 1;
+                }
+            }
+            return rc;
+        }
+        walk->initializing = -1;
+        lane->state = LANE_IDLE;
+        return 1;
+    }
+
+    case LANE_IDLE:
+        if (walk->phase == PHASE_WALK && walk->queue_head < walk->queue_tail) {
+            lane->path = walk->queue[walk->queue_head++];
+            lane->state = LANE_OPENDIR;
+            return 1;
+        }
+        if (walk->phase == PHASE_TRANSFER) {
+            ssh2_walk_delta* delta = walk_next_download(walk);
+            if (!delta) return 0;
+
+            lane->path = malloc(delta->path_length + 1u);
+            if (!lane->path) return LIBSSH2_ERROR_ALLOC;
+            memcpy(lane->path, delta + 1, delta->path_length);
+            lane->path[delta->path_length] = '\0';
+            lane->delta = (int)walk->next_delta - 1;
+            lane->state = LANE_OPENFILE;
+            return 1;
+        }
+        if (walk->phase == PHASE_SHUTDOWN) {
+            lane->state = LANE_SHUTDOWN;
+            return 1;
+        }
+        return 0;
+
+    case LANE_OPENDIR:
+    case LANE_OPENFILE: {
+        int length = walk_full_path(walk, lane->path, full, sizeof(full));
+        if (length < 0) {
+            walk->errors++;
+            if (lane->state == LANE_OPENDIR) {
+                int rc = walk_mark_incomplete(walk, lane->path, strlen(lane->path));
+                if (rc < 0) return rc;
+            } else {
+                walk_finish_delta(walk, lane, LIBSSH2_ERROR_INVAL);
+            }
+            lane->state = LANE_CLOSE;
+            return 1;
+        }
+
+        lane->handle = lane->state == LANE_OPENDIR
+            ? libssh2_sftp_open_ex(lane->sftp, full, (unsigned int)length, 0, 0, LIBSSH2_SFTP_OPENDIR)
+            : libssh2_sftp_open_ex(lane->sftp, full, (unsigned int)length, LIBSSH2_FXF_READ, 0,
+                                   LIBSSH2_SFTP_OPENFILE);
+        if (!lane->handle) {
+            int rc = libssh2_session_last_errno(walk->session);
+            if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+            if (lane->state == LANE_OPENFILE) walk_finish_delta(walk, lane, rc);
+            rc = walk_skip(walk, rc);
+            if (rc == 0 && lane->state == LANE_OPENDIR) {
+                rc = walk_mark_incomplete(walk, lane->path, strlen(lane->path));
+            }
+            if (rc < 0) return rc;
+            lane->state = LANE_CLOSE;
+            return 1;
+        }
+
+        if (lane->state == LANE_OPENDIR) {
+            lane->state = LANE_READDIR;
+            return 1;
+        }
+
+        lane->transfer = ssh2_sftp_get_file(lane->handle, walk->transfer_id, 0, 0,
+                                            walk->buffer_size);
+        if (!lane->transfer) {
+            walk_finish_delta(walk, lane, LIBSSH2_ERROR_ALLOC);
+            return LIBSSH2_ERROR_ALLOC;
+        }
+        lane->transfer->tag = lane->delta;
+        lane->state = LANE_TRANSFER;
+        return 1;
+    }
+
+    case LANE_READDIR: {
+        char name[WALK_NAME_MAX];
+        int moved = 0;
+        for (;;) {
+            LIBSSH2_SFTP_ATTRIBUTES attrs;
+            int rc = libssh2_sftp_readdir_ex(lane->handle, name, sizeof(name), NULL, 0, &attrs);
+            if (rc == LIBSSH2_ERROR_EAGAIN) return moved;
+            if (rc < 0) {
+                // Entries not read yet are unknown, not deleted
+                rc = walk_skip(walk, rc);
+                if (rc == 0) rc = walk_mark_incomplete(walk, lane->path, strlen(lane->path));
+                if (rc < 0) return rc;
+                break;
+            }
+            if (rc == 0) break;
+
+            rc = walk_visit(walk, lane->path, name, (size_t)rc, &attrs);
+            if (rc < 0) return rc;
+            moved = 1;
+        }
+        lane->state = LANE_CLOSE;
+        return 1;
+    }
+
+    case LANE_TRANSFER: {
+        int rc = ssh2_sftp_transfer_step(lane->transfer);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        walk_finish_delta(walk, lane, rc < 0 ? rc : 0);
+        if (rc < 0) {
+            rc = walk_skip(walk, rc);
+            if (rc < 0) return rc;
+        }
+        ssh2_sftp_transfer_free(lane->transfer);
+        lane->transfer = NULL;
+        lane->state = LANE_CLOSE;
+        return 1;
+    }
+
+    case LANE_CLOSE:
+        if (lane->handle) {
+            int rc = libssh2_sftp_close_handle(lane->handle);
+            if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+            lane->handle = NULL;
+            if (rc < 0) {
+                rc = walk_skip(walk, rc);
+                if (rc < 0) return rc;
+            }
+        }
+        free(lane->path);
+        lane->path = NULL;
+        lane->delta = -1;
+        lane->state = LANE_IDLE;
+        return 1;
+
+    case LANE_SHUTDOWN: {
+        int rc = libssh2_sftp_shutdown(lane->sftp);
+        if (rc == LIBSSH2_ERROR_EAGAIN) return 0;
+        lane->sftp = NULL;
+        lane->state = LANE_DONE;
+        return rc < 0 ? rc : 1;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+// True while any lane is working on a directory or file
+static int walk_lanes_busy(ssh2_sftp_walk* walk) {
+    for (int i = 0; i < walk->lane_count; i++) {
+        int state = walk->lanes[i].state;
+        if (state >= LANE_OPENDIR && state <= LANE_CLOSE) return 1;
+    }
+    return 0;
+}
+
+static int walk_advance_phase(ssh2_sftp_walk* walk) {
+    switch (walk->phase) {
+    case PHASE_WALK:
+        if (walk->queue_head < walk->queue_tail || walk_lanes_busy(walk)) return 0;
+        {
+            int rc = walk_emit_deleted(walk);
+            if (rc < 0) return rc;
+        }
+        walk->phase = walk->transfer_id ? PHASE_TRANSFER : PHASE_SHUTDOWN;
+        return 1;
+
+    case PHASE_TRANSFER:
+        if (walk->next_delta < walk->delta_count || walk_lanes_busy(walk)) return 0;
+        walk->phase = PHASE_SHUTDOWN;
+        return 1;
+
+    case PHASE_SHUTDOWN:
+        for (int i = 0; i < walk->lane_count; i++) {
+            if (walk->lanes[i].state != LANE_DONE) return 0;
+        }
+        walk->phase = PHASE_DONE;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+// =====================================
+// Tree Walk API
+// =====================================
+
+void ssh2_sftp_walk_free(ssh2_sftp_walk* walk);
+
+// Start walking the tree under root with up to `lanes` SFTP channels in
+// parallel (OpenSSH allows 10 channels per connection by default). Nothing
+// is sent until the first ssh2_sftp_walk_step.
+EMSCRIPTEN_KEEPALIVE
+ssh2_sftp_walk* ssh2_sftp_walk_new(LIBSSH2_SESSION* session, const char* root, int lanes) {
+    if (!session || !root || lanes <= 0) return NULL;
+    if (lanes > WALK_MAX_LANES) lanes = WALK_MAX_LANES;
+
+    ssh2_sftp_walk* walk = calloc(1, sizeof(ssh2_sftp_walk));
+    if (!walk) return NULL;
+
+    walk->session = session;
+    walk->initializing = -1;
+    walk->root = strdup(*root ? root : ".");
+    walk->lanes = calloc((size_t)lanes, sizeof(walk_lane));
+    if (!walk->root || !walk->lanes || queue_push(walk, "", 0) < 0) {
+        ssh2_sftp_walk_free(walk);
+        return NULL;
+    }
+    walk->lane_count = lanes;
+    for (int i = 0; i < lanes; i++) {
+        walk->lanes[i].delta = -1;
+    }
+
+    // Paths are joined with '/', so drop trailing slashes ("/" becomes "")
+    size_t length = strlen(walk->root);
+    while (length > 0 && walk->root[length - 1] == '/') {
+        walk->root[--length] = '\0';
+    }
+    return walk;
+}
+
+// Load the manifest to compare against: records packed by
+// Module.packWalkManifest with paths relative to the walk root. Must be
+// called before the first step. Returns the number of entries loaded.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_walk_manifest(ssh2_sftp_walk* walk, const uint8_t* buf, size_t buflen) {
+    if (!walk || walk->bucket_count || (!buf && buflen) || ((uintptr_t)buf & 7)) {
+        return LIBSSH2_ERROR_BAD_USE;
+    }
+
+    // First pass: validate and count
+    uint32_t count = 0;
+    for (size_t offset = 0; offset < buflen; count++) {
+        if (buflen - offset < sizeof(walk_manifest_record)) return LIBSSH2_ERROR_INVAL;
+        const walk_manifest_record* record = (const walk_manifest_record*)(buf + offset);
+        size_t length = WALK_ALIGN(sizeof(walk_manifest_record) + (size_t)record->path_length);
+        if (record->path_length >= WALK_PATH_MAX || length > buflen - offset) return LIBSSH2_ERROR_INVAL;
+        offset += length;
+    }
+    if (count == 0) return 0;
+
+    uint32_t bucket_count = 16;
+    while (bucket_count < count && bucket_count < 0x40000000u) {
+        bucket_count <<= 1;
+    }
+    walk->buckets = calloc(bucket_count, sizeof(manifest_entry*));
+    if (!walk->buckets) return LIBSSH2_ERROR_ALLOC;
+    walk->bucket_count = bucket_count;
+
+    for (size_t offset = 0; offset < buflen;) {
+        const walk_manifest_record* record = (const walk_manifest_record*)(buf + offset);
+        const char* path = (const char*)(record + 1);
+
+        manifest_entry* entry = malloc(sizeof(manifest_entry) + record->path_length);
+        if (!entry) return LIBSSH2_ERROR_ALLOC;
+        entry->filesize = record->filesize;
+        entry->mtime = record->mtime;
+        entry->path_length = record->path_length;
+        entry->hash = walk_hash(path, record->path_length);
+        entry->seen = 0;
+        memcpy(entry->path, path, record->path_length);
+
+        manifest_entry** bucket = &walk->buckets[entry->hash & (bucket_count - 1)];
+        entry->next = *bucket;
+        *bucket = entry;
+
+        offset += WALK_ALIGN(sizeof(walk_manifest_record) + (size_t)record->path_length);
+    }
+    return (int)count;
+}
+
+// Also download every NEW or CHANGED regular file once the walk is complete,
+// spreading the files over the lanes. Data goes to
+// Module.sftpTransfers[id].sink(ptr, length, offset, delta) where delta is
+// the file's index in the delta list; once a file is finished or has
+// failed, the optional done(delta, status) is called with its
+// ssh2_sftp_walk_delta_status.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_walk_transfer(ssh2_sftp_walk* walk, int id, size_t buffer_size) {
+    if (!walk || id <= 0 || buffer_size == 0) return LIBSSH2_ERROR_BAD_USE;
+    walk->transfer_id = id;
+    walk->buffer_size = buffer_size;
+    return 0;
+}
+
+// Advance every lane as far as the transport allows. Returns 1 when the walk
+// (and any transfers) is complete and all lanes are shut down,
+// LIBSSH2_ERROR_EAGAIN when waiting on the network, or another libssh2 error.
+// Runs non-blocking regardless of the session's mode.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_walk_step(ssh2_sftp_walk* walk) {
+    if (!walk) return LIBSSH2_ERROR_BAD_USE;
+    if (walk->phase == PHASE_DONE) return 1;
+
+    int blocking = libssh2_session_get_blocking(walk->session);
+    libssh2_session_set_blocking(walk->session, 0);
+
+    int rc;
+    for (;;) {
+        int moved = 0;
+        rc = 0;
+        for (int i = 0; i < walk->lane_count && rc >= 0; i++) {
+            rc = lane_step(walk, i);
+            if (rc > 0) moved = 1;
+        }
+        if (rc < 0) break;
+
+        rc = walk_advance_phase(walk);
+        if (rc < 0) break;
+        if (walk->phase == PHASE_DONE) {
+            rc = 1;
+            break;
+        }
+        if (!moved && !rc) {
+            rc = LIBSSH2_ERROR_EAGAIN;
+            break;
+        }
+    }
+
+    libssh2_session_set_blocking(walk->session, blocking);
+    return rc;
+}
+
+// Delta list: delta_count ssh2_walk_delta records. NEW and CHANGED entries
+// appear as directories are listed, DELETED and UNKNOWN ones once the walk
+// completes.
+// The buffer may move while the walk is running.
+EMSCRIPTEN_KEEPALIVE
+uint8_t* ssh2_sftp_walk_deltas(ssh2_sftp_walk* walk) {
+    return walk ? walk->deltas : NULL;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_walk_delta_count(ssh2_sftp_walk* walk) {
+    return walk ? (int)walk->delta_count : 0;
+}
+
+// Download status of delta `index`: 0 once downloaded in full, a negative
+// libssh2 error if its download failed (the sink may have part of the file),
+// or SSH2_WALK_NOT_DOWNLOADED
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_walk_delta_status(ssh2_sftp_walk* walk, uint32_t index) {
+    if (!walk || index >= walk->delta_count) return LIBSSH2_ERROR_BAD_USE;
+    return walk->statuses[index];
+}
+
+// Number of directories and files skipped because of SFTP errors
+EMSCRIPTEN_KEEPALIVE
+int ssh2_sftp_walk_errors(ssh2_sftp_walk* walk) {
+    return walk ? walk->errors : 0;
+}
+
+// Free the walk, closing the handle and SFTP channel of every lane the walk
+// did not shut down itself. On a non-blocking session a close that would
+// have to wait for the server returns EAGAIN; that lane's channel is then
+// released with the session.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_sftp_walk_free(ssh2_sftp_walk* walk) {
+    if (!walk) return;
+
+    for (int i = 0; walk->lanes && i < walk->lane_count; i++) {
+        walk_lane* lane = &walk->lanes[i];
+        ssh2_sftp_transfer_free(lane->transfer);
+        if (lane->sftp) {
+            if (lane->handle) libssh2_sftp_close_handle(lane->handle);
+            libssh2_sftp_shutdown(lane->sftp);
+        }
+        free(lane->path);
+    }
+    for (size_t i = walk->queue_head; i < walk->queue_tail; i++) {
+        free(walk->queue[i]);
+    }
+    for (size_t i = 0; i < walk->incomplete_count; i++) {
+        free(walk->incomplete[i]);
+    }
+    free(walk->incomplete);
+    for (uint32_t i = 0; i < walk->bucket_count; i++) {
+        manifest_entry* entry = walk->buckets[i];
+        while (entry) {
+            manifest_entry* next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(walk->buckets);
+    free(walk->queue);
+    free(walk->deltas);
+    free(walk->statuses);
+    free(walk->lanes);
+    free(walk->root);
+    free(walk);
+}
@@ -0,0 +1,204 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <errno.h>
+#include <string.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Transport Counters
+// =====================================
+
+void ssh2_stats_send(ssh2_session_ctx* ctx, ssize_t rc, double start) {
+    ssh2_stats* stats = &ctx->stats;
+    stats->send_calls++;
+    if (rc > 0) {
+        stats->bytes_out += (double)rc;
+    } else if (rc == -EAGAIN) {
+        stats->send_eagain++;
+        if (ctx->trace) ssh2_trace_record(ctx, SSH2_TRACE_SEND_EAGAIN, 0, -1, 0, (int)rc);
+    }
+    if (start) {
+        stats->callback_ms += emscripten_get_now() - start;
+    }
+}
+
+void ssh2_stats_recv(ssh2_session_ctx* ctx, ssize_t rc, double start) {
+    ssh2_stats* stats = &ctx->stats;
+    stats->recv_calls++;
+    if (rc > 0) {
+        stats->bytes_in += (double)rc;
+    } else if (rc == -EAGAIN) {
+        stats->recv_eagain++;
+        if (ctx->trace) ssh2_trace_record(ctx, SSH2_TRACE_RECV_EAGAIN, 0, -1, 0, (int)rc);
+    }
+    if (start) {
+        stats->callback_ms += emscripten_get_now() - start;
+    }
+}
+
+// =====================================
+// libssh2 Hooks
+// =====================================
+
+// libssh2 has no packet or key exchange callbacks, so build.sh links with
+// -Wl,--wrap for the functions below: each call from inside libssh2.a lands
+// here first. They are internal symbols of libssh2 1.11.1 and need checking
+// on every vendor bump.
+int __real__libssh2_transport_read(LIBSSH2_SESSION* session);
+int __real__libssh2_transport_send(LIBSSH2_SESSION* session,
+                                   const unsigned char* data, size_t data_len,
+                                   const unsigned char* data2, size_t data2_len);
+int __real__libssh2_kex_exchange(LIBSSH2_SESSION* session, int reexchange, void* state);
+
+// Only the outermost packet layer call is timed (key exchange nests them)
+static void codec_enter(ssh2_session_ctx* ctx) {
+    if (ctx->codec_depth++ == 0 && ctx->timing) {
+        ctx->codec_start = emscripten_get_now();
+        ctx->codec_callback_mark = ctx->stats.callback_ms;
+    }
+}
+
+static void codec_leave(ssh2_session_ctx* ctx) {
+    if (--ctx->codec_depth == 0 && ctx->timing && ctx->codec_start) {
+        double elapsed = emscripten_get_now() - ctx->codec_start;
+        ctx->stats.codec_ms += elapsed - (ctx->stats.callback_ms - ctx->codec_callback_mark);
+        ctx->codec_start = 0;
+    }
+}
+
+// Big-endian u32 at offset of an outgoing payload, or -1 when too short
+static int32_t payload_u32(const unsigned char* data, size_t data_len, size_t offset) {
+    if (data_len < offset + 4) return -1;
+    return (int32_t)(((uint32_t)data[offset] << 24) | ((uint32_t)data[offset + 1] << 16) |
+                     ((uint32_t)data[offset + 2] << 8) | data[offset + 3]);
+}
+
+// Channel messages (SSH_MSG_CHANNEL_OPEN_CONFIRMATION = 91 through
+// SSH_MSG_CHANNEL_FAILURE = 100) start with the recipient channel
+static void trace_packet_out(ssh2_session_ctx* ctx, const unsigned char* data, size_t data_len,
+                             size_t data2_len, int rc) {
+    int type = data_len ? data[0] : 0;
+    int channel = type >= 91 && type <= 100 ? payload_u32(data, data_len, 1) : -1;
+
+    if (rc == 0) {
+        ssh2_trace_record(ctx, SSH2_TRACE_PACKET_OUT, type, channel, (uint32_t)(data_len + data2_len), 0);
+        if (type == 93) {
+            ssh2_trace_record(ctx, SSH2_TRACE_WINDOW_ADJUST, 0, channel,
+                              (uint32_t)payload_u32(data, data_len, 5), 0);
+        }
+    } else if (rc != LIBSSH2_ERROR_EAGAIN) {
+        ssh2_trace_record(ctx, SSH2_TRACE_ERROR, type, channel, 0, rc);
+    }
+}
+
+// Returns the packet type once a whole packet has been processed
+int __wrap__libssh2_transport_read(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx) return __real__libssh2_transport_read(session);
+
+    double bytes_in = ctx->stats.bytes_in;
+    codec_enter(ctx);
+    int rc = __real__libssh2_transport_read(session);
+    codec_leave(ctx);
+
+    if (rc > 0) {
+        ctx->stats.packets_in++;
+    }
+    if (ctx->trace && rc != LIBSSH2_ERROR_EAGAIN) {
+        // The payload is already consumed, so bytes is what this call pulled
+        // off the transport rather than the packet length
+        uint32_t bytes = (uint32_t)(ctx->stats.bytes_in - bytes_in);
+        if (rc > 0) {
+            ssh2_trace_record(ctx, SSH2_TRACE_PACKET_IN, rc, -1, bytes, 0);
+        } else if (rc < 0) {
+            ssh2_trace_record(ctx, SSH2_TRACE_ERROR, 0, -1, bytes, rc);
+        }
+    }
+    return rc;
+}
+
+// Returns 0 once the packet is fully written to the transport
+int __wrap__libssh2_transport_send(LIBSSH2_SESSION* session,
+                                   const unsigned char* data, size_t data_len,
+                                   const unsigned char* data2, size_t data2_len) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx) return __real__libssh2_transport_send(session, data, data_len, data2, data2_len);
+
+    codec_enter(ctx);
+    int rc = __real__libssh2_transport_send(session, data, data_len, data2, data2_len);
+    codec_leave(ctx);
+
+    if (rc == 0) {
+        ctx->stats.packets_out++;
+    }
+    if (ctx->trace) {
+        trace_packet_out(ctx, data, data_len, data2_len, rc);
+    }
+    return rc;
+}
+
+// Called for the initial exchange and every re-key, repeatedly while EAGAIN
+int __wrap__libssh2_kex_exchange(LIBSSH2_SESSION* session, int reexchange, void* state) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx) return __real__libssh2_kex_exchange(session, reexchange, state);
+
+    if (ctx->trace && !ctx->trace->in_kex) {
+        ctx->trace->in_kex = 1;
+        ssh2_trace_record(ctx, SSH2_TRACE_KEX_BEGIN, reexchange != 0, -1, 0, 0);
+    }
+
+    double start = ctx->timing ? emscripten_get_now() : 0;
+    int rc = __real__libssh2_kex_exchange(session, reexchange, state);
+    if (ctx->trace && ctx->trace->in_kex && rc != LIBSSH2_ERROR_EAGAIN) {
+        ctx->trace->in_kex = 0;
+        ssh2_trace_record(ctx, SSH2_TRACE_KEX_END, reexchange != 0, -1, 0, rc);
+    }
+    if (start) {
+        ctx->stats.kex_ms += emscripten_get_now() - start;
+    }
+    if (rc == 0) {
+        ctx->stats.kex_count++;
+    }
+    return rc;
+}
+
+// =====================================
+// Stats API
+// =====================================
+
+// Copy the session's counters into out (an ssh2_stats, 16 doubles)
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_stats(LIBSSH2_SESSION* session, ssh2_stats* out) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || !out) return LIBSSH2_ERROR_BAD_USE;
+    memcpy(out, &ctx->stats, sizeof(ssh2_stats));
+    return 0;
+}
+
+// Zero all counters
+EMSCRIPTEN_KEEPALIVE
+void ssh2_session_stats_reset(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (ctx) {
+        memset(&ctx->stats, 0, sizeof(ssh2_stats));
+    }
+}
+
+// Enable the *_ms timers. Off by default: every sample is a call out to
+// performance.now(), while the counters are plain increments.
+EMSCRIPTEN_KEEPALIVE
+void ssh2_session_stats_timing(LIBSSH2_SESSION* session, int enable) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (ctx) {
+        ctx->timing = enable != 0;
+        ctx->codec_start = 0;
+    }
+}
+
+// Number of times a registered channel's remote window was seen to close
+EMSCRIPTEN_KEEPALIVE
+int ssh2_channel_window_stalls(LIBSSH2_SESSION* session, int id) {
+    ssh2_channel_entry* entry = ssh2_channel_entry_get(ssh2_session_get_ctx(session), id);
+    return entry ? (int)entry->window_stalls : LIBSSH2_ERROR_BAD_USE;
+}
@@ -0,0 +1,77 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Trace Ring
+// =====================================
+
+// ssh2_session_trace goes through libssh2's text tracer, which formats every
+// line and writes it through stdio, far too slow to leave on while waiting
+// for a rare stall. This ring keeps fixed-size binary events in WASM memory
+// instead: recording is a timestamp and a struct store, nothing crosses into
+// JS until someone dumps the ring, and a session without one pays a single
+// NULL check per hook.
+
+void ssh2_trace_record(ssh2_session_ctx* ctx, int type, int detail, int channel, uint32_t bytes, int code) {
+    ssh2_trace* trace = ctx->trace;
+    ssh2_trace_event* event = &trace->events[trace->next];
+
+    event->time = emscripten_get_now();
+    event->type = (uint16_t)type;
+    event->detail = (uint16_t)detail;
+    event->channel = channel;
+    event->bytes = bytes;
+    event->code = code;
+
+    trace->next = (trace->next + 1) & (trace->capacity - 1);
+    trace->recorded++;
+}
+
+// =====================================
+// Trace API
+// =====================================
+
+// Keep the last `capacity` events of this session (rounded up to a power of
+// two, 24 bytes each). Replaces any previous ring; 0 turns tracing off.
+// Independent of ssh2_session_trace, which stays the text tracer.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_trace_ring(LIBSSH2_SESSION* session, uint32_t capacity) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || capacity > (1u << 24)) return LIBSSH2_ERROR_BAD_USE;
+
+    free(ctx->trace);
+    ctx->trace = NULL;
+    if (!capacity) return 0;
+
+    uint32_t size = 16;
+    while (size < capacity) size <<= 1;
+
+    ssh2_trace* trace = calloc(1, sizeof(ssh2_trace) + (size_t)size * sizeof(ssh2_trace_event));
+    if (!trace) return LIBSSH2_ERROR_ALLOC;
+    trace->capacity = size;
+    ctx->trace = trace;
+    return (int)size;
+}
+
+// The session's ssh2_trace for JS to decode in place, or 0 while off
+EMSCRIPTEN_KEEPALIVE
+ssh2_trace* ssh2_session_trace_buffer(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    return ctx ? ctx->trace : NULL;
+}
+
+// Drop recorded events, keeping the ring
+EMSCRIPTEN_KEEPALIVE
+void ssh2_session_trace_clear(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (ctx && ctx->trace) {
+        ssh2_trace* trace = ctx->trace;
+        trace->next = 0;
+        trace->recorded = 0;
+        memset(trace->events, 0, (size_t)trace->capacity * sizeof(ssh2_trace_event));
+    }
+}
@@ -0,0 +1,502 @@
+#include <libssh2.h>
+#include <emscripten.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ssh2-internal.h"
+
+// =====================================
+// Ring Buffers
+// =====================================
+
+// Allocate a ring, rounding capacity up to a power of two
+ssh2_ring* ssh2_ring_new(size_t capacity) {
+    uint32_t size = 4096;
+    while (size < capacity && size < 0x40000000u) {
+        size <<= 1;
+    }
+
+    ssh2_ring* ring = calloc(1, sizeof(ssh2_ring));
+    if (!ring) return NULL;
+
+    ring->data = malloc(size);
+    if (!ring->data) {
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = size;
+    return ring;
+}
+
+void ssh2_ring_free(ssh2_ring* ring) {
+    if (ring) {
+        free(ring->data);
+        free(ring);
+    }
+}
+
+uint32_t ssh2_ring_used(const ssh2_ring* ring) {
+    return ring->head - ring->tail;
+}
+
+uint32_t ssh2_ring_space(const ssh2_ring* ring) {
+    return ring->capacity - (ring->head - ring->tail);
+}
+
+// Copy up to len bytes in, returns the number of bytes accepted
+size_t ssh2_ring_write(ssh2_ring* ring, const void* src, size_t len) {
+    uint32_t space = ssh2_ring_space(ring);
+    if (len > space) len = space;
+    if (len == 0) return 0;
+
+    uint32_t offset = ring->head & (ring->capacity - 1);
+    size_t first = ring->capacity - offset;
+    if (first > len) first = len;
+
+    memcpy(ring->data + offset, src, first);
+    memcpy(ring->data, (const uint8_t*)src + first, len - first);
+    ring->head += (uint32_t)len;
+    return len;
+}
+
+// Copy up to len bytes out, returns the number of bytes consumed
+size_t ssh2_ring_read(ssh2_ring* ring, void* dst, size_t len) {
+    uint32_t used = ssh2_ring_used(ring);
+    if (len > used) len = used;
+    if (len == 0) return 0;
+
+    uint32_t offset = ring->tail & (ring->capacity - 1);
+    size_t first = ring->capacity - offset;
+    if (first > len) first = len;
+
+    memcpy(dst, ring->data + offset, first);
+    memcpy((uint8_t*)dst + first, ring->data, len - first);
+    ring->tail += (uint32_t)len;
+    return len;
+}
+
+// =====================================
+// Session Context
+// =====================================
+
+ssh2_session_ctx* ssh2_session_ctx_new(int handle, int transport, size_t rx_size, size_t tx_size) {
+    ssh2_session_ctx* ctx = calloc(1, sizeof(ssh2_session_ctx));
+    if (!ctx) return NULL;
+
+    ctx->transport = transport;
+    if (transport == SSH2_TRANSPORT_RING) {
+        ctx->rx = ssh2_ring_new(rx_size);
+        ctx->tx = ssh2_ring_new(tx_size);
+        if (!ctx->rx || !ctx->tx) {
+            ssh2_session_ctx_free(ctx);
+            return NULL;
+        }
+    }
+    ctx->handle = handle;
+    return ctx;
+}
+
+ssh2_session_ctx* ssh2_session_get_ctx(LIBSSH2_SESSION* session) {
+    void** abstract = libssh2_session_abstract(session);
+    return abstract ? (ssh2_session_ctx*)*abstract : NULL;
+}
+
+// Free the context and release the session's Module.transports slot
+void ssh2_session_ctx_free(ssh2_session_ctx* ctx) {
+    if (ctx) {
+        if (ctx->coalesce) {
+            // Last chance for buffered bytes, e.g. the disconnect message
+            ssh2_coalesce_flush(ctx);
+            EM_ASM({
+                Module.cancelFlush($0);
+            }, (int)ctx->session);
+            free(ctx->coalesce->data);
+            free(ctx->coalesce);
+        }
+        if (ctx->handle > 0) {
+            EM_ASM({
+                Module.unregisterTransport($0);
+            }, ctx->handle);
+        }
+        ssh2_ring_free(ctx->rx);
+        ssh2_ring_free(ctx->tx);
+        free(ctx->channels);
+        ssh2_heap_free(ctx->heap);
+        free(ctx->trace);
+        free(ctx);
+    }
+}
+
+// =====================================
+// Async Transport
+// =====================================
+
+#ifdef SSH2_ASYNC
+// In async builds (build.sh --async/--jspi) a blocking session never sees
+// EAGAIN from the transport. Instead the calling libssh2 function is
+// suspended until the WebSocket has delivered data, so exported calls
+// resolve as Promises and sessions can stay in blocking mode without any
+// poll loop in JS. Non-blocking sessions, including the pump and batch
+// reads which switch to non-blocking for the call, only take what is
+// already buffered and get EAGAIN otherwise.
+EM_ASYNC_JS(int, ssh2_js_recv, (int handle, void* buffer, int length), {
+    var recv = handle ? Module.transports[handle].recv : Module.customRecv;
+    return await recv(buffer, length, true);
+});
+
+// recv(buffer, length, false) must answer synchronously. A Promise here
+// would write into the buffer after libssh2 has moved on, so it is an error.
+#define JS_RECV_PROMISE (-0x7fffffff)
+
+EM_JS(int, ssh2_js_recv_now, (int handle, void* buffer, int length), {
+    var recv = handle ? Module.transports[handle].recv : Module.customRecv;
+    var rc = recv(buffer, length, false);
+    return typeof rc === 'number' ? rc : -0x7fffffff;
+});
+
+// Suspend until JS writes to, drains or closes the ring
+EM_ASYNC_JS(void, ssh2_js_ring_wait, (ssh2_ring* ring), {
+    await Module.ringWait(ring);
+});
+
+static int transport_suspends(ssh2_session_ctx* ctx) {
+    return !ctx || !ctx->session || libssh2_session_get_blocking(ctx->session);
+}
+
+ssize_t ssh2_async_recv(ssh2_session_ctx* ctx, int handle, void* buffer, size_t length) {
+    if (transport_suspends(ctx)) return ssh2_js_recv(handle, buffer, (int)length);
+
+    int rc = ssh2_js_recv_now(handle, buffer, (int)length);
+    return rc == JS_RECV_PROMISE ? -EIO : rc;
+}
+#endif
+
+// =====================================
+// Callback Transport
+// =====================================
+
+// One call into the session's JS transport (Module.customSend for handle 0)
+static ssize_t transport_send(ssh2_session_ctx* ctx, const void* buffer, size_t length) {
+    double start = ctx->timing ? emscripten_get_now() : 0;
+    ssize_t rc = EM_ASM_INT({
+        var send = $0 ? Module.transports[$0].send : Module.customSend;
+        return send($1, $2);
+    }, ctx->handle, (int)buffer, (int)length);
+    ssh2_stats_send(ctx, rc, start);
+    return rc;
+}
+
+// Send callback: hand the buffer to the session's registered transport
+static ssize_t handle_send(libssh2_socket_t socket, const void* buffer, size_t length,
+                           int flags, void** abstract) {
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    if (ctx->coalesce) return ssh2_coalesce_write(ctx, buffer, length);
+    return transport_send(ctx, buffer, length);
+}
+
+// Receive callback: ask the session's registered transport for data
+static ssize_t handle_recv(libssh2_socket_t socket, void* buffer, size_t length,
+                           int flags, void** abstract) {
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    if (ctx->coalesce) {
+        int flushed = ssh2_coalesce_flush(ctx);
+        if (flushed < 0 && flushed != -EAGAIN) return flushed;
+    }
+    double start = ctx->timing ? emscripten_get_now() : 0;
+#ifdef SSH2_ASYNC
+    ssize_t rc = ssh2_async_recv(ctx, ctx->handle, buffer, length);
+#else
+    ssize_t rc = EM_ASM_INT({
+        return Module.transports[$0].recv($1, $2);
+    }, ctx->handle, (int)buffer, (int)length);
+#endif
+    ssh2_stats_recv(ctx, rc, start);
+    return rc;
+}
+
+// =====================================
+// Transmit Coalescing
+// =====================================
+
+// libssh2 calls the send callback at least once per packet and a logical
+// write is often several packets, so each call becoming its own WebSocket
+// frame costs per-frame overhead at the proxy and on the wire. Coalescing
+// sessions return from the send callback once the bytes are buffered; see
+// ssh2_coalesce in src/ssh2-internal.h for when the buffer is written out.
+// Ring sessions already batch, JS drains whatever accumulated per notify.
+
+ssize_t ssh2_coalesce_write(ssh2_session_ctx* ctx, const void* buffer, size_t length) {
+    ssh2_coalesce* c = ctx->coalesce;
+    if (c->error) return c->error;
+
+    if (c->length == c->capacity) {
+        int rc = ssh2_coalesce_flush(ctx);
+        if (c->length == c->capacity) return rc;
+    }
+
+    size_t n = c->capacity - c->length;
+    if (n > length) n = length;
+    if (!c->length) {
+        c->first_ms = c->delay_ms ? emscripten_get_now() : 0;
+        if (!c->scheduled) {
+            c->scheduled = 1;
+            EM_ASM({
+                Module.scheduleFlush($0);
+            }, (int)ctx->session);
+        }
+    }
+    memcpy(c->data + c->length, buffer, n);
+    c->length += (uint32_t)n;
+    ctx->stats.coalesced_writes++;
+
+    if (c->length == c->capacity || (c->first_ms && emscripten_get_now() - c->first_ms >= c->delay_ms)) {
+        int rc = ssh2_coalesce_flush(ctx);
+        if (rc < 0 && rc != -EAGAIN) return rc;
+    }
+    return (ssize_t)n;
+}
+
+// A send error is kept: libssh2 already counted those bytes as sent, so the
+// session cannot continue and every later send or receive reports it
+int ssh2_coalesce_flush(ssh2_session_ctx* ctx) {
+    ssh2_coalesce* c = ctx->coalesce;
+    if (c->error) return c->error;
+
+    uint32_t sent = 0;
+    ssize_t rc = 0;
+    while (sent < c->length) {
+        rc = transport_send(ctx, c->data + sent, c->length - sent);
+        if (rc <= 0) break;
+        sent += (uint32_t)rc;
+    }
+
+    if (sent) {
+        ctx->stats.flushes++;
+        ctx->stats.flush_bytes += sent;
+        memmove(c->data, c->data + sent, c->length - sent);
+        c->length -= sent;
+    }
+    if (rc < 0 && rc != -EAGAIN) {
+        c->error = (int)rc;
+        return c->error;
+    }
+    return c->length ? -EAGAIN : 0;
+}
+
+// Buffer a callback transport session's sends and write them out as one
+// transport call: when max_bytes have collected, when the oldest byte is
+// max_delay_ms old (0 for no deadline), before each receive and once the
+// current JS task's libssh2 calls have returned. max_bytes 0 turns
+// coalescing off. Returns LIBSSH2_ERROR_EAGAIN while buffered bytes cannot
+// be written yet, LIBSSH2_ERROR_BAD_USE for ring sessions.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_coalesce(LIBSSH2_SESSION* session, uint32_t max_bytes, double max_delay_ms) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx || ctx->transport != SSH2_TRANSPORT_CALLBACK || max_bytes > (1u << 24) || max_delay_ms < 0) {
+        return LIBSSH2_ERROR_BAD_USE;
+    }
+
+    if (ctx->coalesce) {
+        int rc = ssh2_coalesce_flush(ctx);
+        if (rc == -EAGAIN) return LIBSSH2_ERROR_EAGAIN;
+        if (rc < 0) return LIBSSH2_ERROR_SOCKET_SEND;
+        free(ctx->coalesce->data);
+        free(ctx->coalesce);
+        ctx->coalesce = NULL;
+    }
+    if (!max_bytes) return 0;
+
+    ssh2_coalesce* c = calloc(1, sizeof(ssh2_coalesce));
+    if (!c) return LIBSSH2_ERROR_ALLOC;
+    c->data = malloc(max_bytes);
+    if (!c->data) {
+        free(c);
+        return LIBSSH2_ERROR_ALLOC;
+    }
+    c->capacity = max_bytes;
+    c->delay_ms = max_delay_ms;
+    ctx->coalesce = c;
+    return 0;
+}
+
+// Write out the session's coalesced bytes now. Returns 0 once the buffer is
+// empty (or coalescing is off), LIBSSH2_ERROR_EAGAIN if the transport took
+// only part of it, or LIBSSH2_ERROR_SOCKET_SEND after a send error.
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_flush(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    if (!ctx) return LIBSSH2_ERROR_BAD_USE;
+    if (!ctx->coalesce) return 0;
+
+    ctx->coalesce->scheduled = 0;
+    int rc = ssh2_coalesce_flush(ctx);
+    if (rc == -EAGAIN) return LIBSSH2_ERROR_EAGAIN;
+    return rc < 0 ? LIBSSH2_ERROR_SOCKET_SEND : 0;
+}
+
+// =====================================
+// Ring Transport
+// =====================================
+
+// Tell JS that the TX ring has data to drain
+static void ring_notify(ssh2_session_ctx* ctx) {
+    double start = ctx->timing ? emscripten_get_now() : 0;
+    EM_ASM({
+        var transmit = $0 ? Module.transports[$0].transmit : Module.onTransmit;
+        if (transmit) {
+            transmit($1, $2);
+        }
+    }, ctx->handle, (int)ctx->session, (int)ctx->tx);
+    if (start) {
+        ctx->stats.callback_ms += emscripten_get_now() - start;
+    }
+}
+
+// Append to the TX ring without leaving WASM. JS is only told when the
+// ring goes from empty to non-empty; it then drains everything that has
+// accumulated by the time it gets around to it.
+static ssize_t ring_write_tx(ssh2_session_ctx* ctx, const void* buffer, size_t length) {
+    ssh2_ring* tx = ctx->tx;
+
+    for (;;) {
+        if (tx->flags & SSH2_RING_CLOSED) {
+            return -EPIPE;
+        }
+
+        int was_empty = ssh2_ring_used(tx) == 0;
+        size_t sent = ssh2_ring_write(tx, buffer, length);
+        if (sent) {
+            if (was_empty) {
+                ring_notify(ctx);
+            }
+            return (ssize_t)sent;
+        }
+#ifdef SSH2_ASYNC
+        if (!transport_suspends(ctx)) return -EAGAIN;
+        ssh2_js_ring_wait(tx);
+#else
+        return -EAGAIN;
+#endif
+    }
+}
+
+// Send callback: write to the TX ring
+static ssize_t ring_send(libssh2_socket_t socket, const void* buffer, size_t length,
+                         int flags, void** abstract) {
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    ssize_t rc = ring_write_tx(ctx, buffer, length);
+    ssh2_stats_send(ctx, rc, 0);
+    return rc;
+}
+
+// Receive callback: serve from the RX ring that JS fills directly
+static ssize_t ring_recv(libssh2_socket_t socket, void* buffer, size_t length,
+                         int flags, void** abstract) {
+    ssh2_session_ctx* ctx = (ssh2_session_ctx*)*abstract;
+    ssh2_ring* rx = ctx->rx;
+
+    ssize_t rc;
+    while ((rc = (ssize_t)ssh2_ring_read(rx, buffer, length)) == 0) {
+        if (rx->flags & SSH2_RING_CLOSED) {
+            break;
+        }
+#ifdef SSH2_ASYNC
+        if (!transport_suspends(ctx)) {
+            rc = -EAGAIN;
+            break;
+        }
+        ssh2_js_ring_wait(rx);
+#else
+        rc = -EAGAIN;
+        break;
+#endif
+    }
+    ssh2_stats_recv(ctx, rc, 0);
+    return rc;
+}
+
+// =====================================
+// Session Creation
+// =====================================
+
+// Create a session bound to a transport handle from Module.registerTransport.
+// Many sessions can share one module instance; the handle travels through
+// libssh2's abstract pointer so the callbacks know which JS transport to use.
+// Handle 0 selects the module-wide customSend/customRecv/onTransmit hooks.
+// Ring sessions are non-blocking: the rings can only be serviced by JS once
+// control returns to it. Async builds suspend instead, so they stay blocking.
+static LIBSSH2_SESSION* session_create(int handle, int transport, size_t rx_size, size_t tx_size,
+                                       int pooled, size_t memory_cap) {
+    ssh2_session_ctx* ctx = ssh2_session_ctx_new(handle, transport, rx_size, tx_size);
+    if (!ctx) return NULL;
+
+    if (pooled) {
+        ctx->heap = ssh2_heap_new(memory_cap);
+        ctx->session = ctx->heap ? ssh2_heap_session_init(ctx) : NULL;
+    } else {
+        ctx->session = libssh2_session_init_ex(NULL, NULL, NULL, ctx);
+    }
+    if (!ctx->session) {
+        ctx->handle = 0; // Slot still belongs to the caller
+        ssh2_session_ctx_free(ctx);
+        return NULL;
+    }
+
+    if (transport == SSH2_TRANSPORT_RING) {
+        libssh2_session_callback_set2(ctx->session, LIBSSH2_CALLBACK_SEND, (libssh2_cb_generic*)ring_send);
+        libssh2_session_callback_set2(ctx->session, LIBSSH2_CALLBACK_RECV, (libssh2_cb_generic*)ring_recv);
+#ifndef SSH2_ASYNC
+        libssh2_session_set_blocking(ctx->session, 0);
+#endif
+    } else if (handle > 0) {
+        libssh2_session_callback_set2(ctx->session, LIBSSH2_CALLBACK_SEND, (libssh2_cb_generic*)handle_send);
+        libssh2_session_callback_set2(ctx->session, LIBSSH2_CALLBACK_RECV, (libssh2_cb_generic*)handle_recv);
+    } else {
+        libssh2_session_callback_set2(ctx->session, LIBSSH2_CALLBACK_SEND, (libssh2_cb_generic*)custom_send);
+        libssh2_session_callback_set2(ctx->session, LIBSSH2_CALLBACK_RECV, (libssh2_cb_generic*)custom_recv);
+    }
+    return ctx->session;
+}
+
+EMSCRIPTEN_KEEPALIVE
+LIBSSH2_SESSION* ssh2_session_create(int handle, int transport, size_t rx_size, size_t tx_size) {
+    return session_create(handle, transport, rx_size, tx_size, 0, 0);
+}
+
+// Like ssh2_session_create, with libssh2's allocations served from a
+// per-session pooled heap (see src/ssh2-heap.c) whose live bytes are
+// counted and capped at memory_cap (0 for no cap). Over the cap, libssh2
+// calls fail with LIBSSH2_ERROR_ALLOC instead of growing the module heap.
+EMSCRIPTEN_KEEPALIVE
+LIBSSH2_SESSION* ssh2_session_create_ex(int handle, int transport, size_t rx_size, size_t tx_size,
+                                        size_t memory_cap) {
+    return session_create(handle, transport, rx_size, tx_size, 1, memory_cap);
+}
+
+// Create a ring session that reports to Module.onTransmit
+EMSCRIPTEN_KEEPALIVE
+LIBSSH2_SESSION* ssh2_session_init_ring(size_t rx_size, size_t tx_size) {
+    return ssh2_session_create(0, SSH2_TRANSPORT_RING, rx_size, tx_size);
+}
+
+// Get the transport handle a session was created with
+EMSCRIPTEN_KEEPALIVE
+int ssh2_session_handle(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    return ctx ? ctx->handle : 0;
+}
+
+// Get the RX ring (JS -> libssh2) of a ring session
+EMSCRIPTEN_KEEPALIVE
+ssh2_ring* ssh2_session_rx_ring(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    return ctx ? ctx->rx : NULL;
+}
+
+// Get the TX ring (libssh2 -> JS) of a ring session
+EMSCRIPTEN_KEEPALIVE
+ssh2_ring* ssh2_session_tx_ring(LIBSSH2_SESSION* session) {
+    ssh2_session_ctx* ctx = ssh2_session_get_ctx(session);
+    return ctx ? ctx->tx : NULL;
+}